@@ -0,0 +1,10 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Drawn over lambert.vert.glsl for Terrain's depth pre-pass, which only
+// writes depth, so there is nothing to compute here. The opaque Chunks
+// are then shaded with depth testing against what this left behind.
+
+void main()
+{
+}
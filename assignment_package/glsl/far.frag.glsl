@@ -0,0 +1,50 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Lit and fogged the same way as lambert.frag.glsl, so that the far
+// terrain blends into the Chunks in front of it
+
+uniform int u_Time;
+uniform vec4 u_Player;
+uniform float u_FogDistance;
+
+uniform sampler2D u_ChunkMask;  // One texel per Chunk, set where a Chunk is drawn
+uniform ivec2 u_MaskOrigin;     // The world position of the mask's first texel
+
+in vec4 fs_Pos;
+in vec4 fs_Nor;
+in vec4 fs_LightVec;
+in vec4 fs_Col;
+
+out vec4 out_Col;
+
+vec4 rotateX(vec4 p, float a) {
+    return vec4(p.x, cos(a) * p.y + -sin(a) * p.z, sin(a) * p.y + cos(a) * p.z, 0.0);
+}
+
+vec4 rotateY(vec4 p, float a) {
+    return vec4(cos(a) * p.x + sin(a) + p.z, p.y, -sin(a) * p.x + cos(a) * p.z, 0.0);
+}
+
+void main()
+{
+    // Give way to the real terrain wherever it has been drawn
+    ivec2 chunk = ivec2(floor((fs_Pos.xz - vec2(u_MaskOrigin)) / 16.0));
+    ivec2 maskSize = textureSize(u_ChunkMask, 0);
+    if (all(greaterThanEqual(chunk, ivec2(0))) && all(lessThan(chunk, maskSize)) &&
+        texelFetch(u_ChunkMask, chunk, 0).r > 0.5) {
+        discard;
+    }
+
+    vec3 sunDir = vec3(rotateX(normalize(fs_LightVec), u_Time * 0.008));
+    float diffuseTerm = clamp(dot(normalize(fs_Nor), vec4(normalize(sunDir), 0.0)), 0, 1);
+    float lightIntensity = diffuseTerm + 0.2;
+
+    vec4 fog_color = vec4(0.75, 0.75, 0.75, 1);
+    vec4 fog = rotateY(normalize(fog_color), u_Time * 0.011);
+    float dist = length(fs_Pos.xz - u_Player.xz) / u_FogDistance;
+
+    vec4 color = vec4(fs_Col.rgb * lightIntensity, 1);
+    color = mix(color, fog, pow(smoothstep(0, 1, min(1, dist)), 2));
+    out_Col = vec4(color.rgb, 1);
+}
@@ -0,0 +1,27 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Refer to the lambert shader files for useful comments
+
+uniform mat4 u_ViewProj;
+
+in vec4 vs_Pos;             // Already in world space; the grid is never moved
+in vec4 vs_Nor;
+in vec4 vs_UV;              // FarTerrain puts each vertex's color where Chunks put their UVs
+
+out vec4 fs_Pos;
+out vec4 fs_Nor;
+out vec4 fs_LightVec;
+out vec4 fs_Col;
+
+const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));
+
+void main()
+{
+    fs_Pos = vs_Pos;
+    fs_Nor = vs_Nor;
+    fs_Col = vs_UV;
+    fs_LightVec = lightDir;
+
+    gl_Position = u_ViewProj * vs_Pos;
+}
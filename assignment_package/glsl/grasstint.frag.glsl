@@ -0,0 +1,72 @@
+#version 150
+// ^ Change this to version 130 if you have compatibility issues
+
+// Bakes the fbm that tints grass tops into GrassTint's texture. This is
+// the noise lambert.frag.glsl used to evaluate for every grass fragment,
+// unchanged. Each texel holds it at the one world position in the window
+// that lands on that texel, so the window can move a strip at a time.
+// One texel per fragment.
+
+uniform ivec2 u_Dimensions; // Size of the texture in texels
+uniform ivec2 u_TintOrigin; // World x and z of the window's lowest corner
+
+// Blocks covered by the texture (GrassTint::WINDOW_BLOCKS)
+const float WINDOW = 1024.0;
+
+out vec4 out_Col;
+
+float random1(vec3 p) {
+    return fract(sin(dot(p,vec3(127.1, 311.7, 191.999)))
+                 *43758.5453);
+}
+
+float mySmoothStep(float a, float b, float t) {
+    t = smoothstep(0, 1, t);
+    return mix(a, b, t);
+}
+
+float cubicTriMix(vec3 p) {
+    vec3 pFract = fract(p);
+    float llb = random1(floor(p) + vec3(0,0,0));
+    float lrb = random1(floor(p) + vec3(1,0,0));
+    float ulb = random1(floor(p) + vec3(0,1,0));
+    float urb = random1(floor(p) + vec3(1,1,0));
+
+    float llf = random1(floor(p) + vec3(0,0,1));
+    float lrf = random1(floor(p) + vec3(1,0,1));
+    float ulf = random1(floor(p) + vec3(0,1,1));
+    float urf = random1(floor(p) + vec3(1,1,1));
+
+    float mixLoBack = mySmoothStep(llb, lrb, pFract.x);
+    float mixHiBack = mySmoothStep(ulb, urb, pFract.x);
+    float mixLoFront = mySmoothStep(llf, lrf, pFract.x);
+    float mixHiFront = mySmoothStep(ulf, urf, pFract.x);
+
+    float mixLo = mySmoothStep(mixLoBack, mixLoFront, pFract.z);
+    float mixHi = mySmoothStep(mixHiBack, mixHiFront, pFract.z);
+
+    return mySmoothStep(mixLo, mixHi, pFract.y);
+}
+
+float fbm(vec3 p) {
+    float amp = 0.5;
+    float freq = 4.0;
+    float sum = float(0.0);
+    for(int i = 0; i < 8; i++) {
+        sum += cubicTriMix(p * freq) * amp;
+        amp *= 0.5;
+        freq *= 2.0;
+    }
+    return sum;
+}
+
+void main()
+{
+    // lambert.frag.glsl looks this texel up for every world x and z that
+    // is the same modulo WINDOW, and of those this is the one in the window
+    vec2 texel = gl_FragCoord.xy / vec2(u_Dimensions) * WINDOW;
+    vec2 origin = vec2(u_TintOrigin);
+    vec2 pos = origin + mod(texel - origin, WINDOW);
+    vec3 p = vec3((pos / 16.f), 1);
+    out_Col = vec4(fbm(p), 0, 0, 1);
+}
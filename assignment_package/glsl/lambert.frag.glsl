@@ -14,6 +14,11 @@
 uniform sampler2D u_Texture;
 uniform int u_Time;
 uniform vec4 u_Player;
+uniform float u_FogDistance; // How far from the player the fog becomes opaque
+uniform sampler2D u_GrassTint; // fbm tint of grass tops, baked by GrassTint
+
+// Blocks covered by u_GrassTint (GrassTint::WINDOW_BLOCKS)
+const float GRASS_TINT_WINDOW = 1024.0;
 
 // These are the interpolated values out of the rasterizer, so you can't know
 // their specific values without knowing the vertices that contributed to them
@@ -26,51 +31,6 @@ in vec4 fs_CameraPos;
 out vec4 out_Col; // This is the final output color that you will see on your
                   // screen for the pixel that is currently being processed.
 
-float random1(vec3 p) {
-    return fract(sin(dot(p,vec3(127.1, 311.7, 191.999)))
-                 *43758.5453);
-}
-
-float mySmoothStep(float a, float b, float t) {
-    t = smoothstep(0, 1, t);
-    return mix(a, b, t);
-}
-
-float cubicTriMix(vec3 p) {
-    vec3 pFract = fract(p);
-    float llb = random1(floor(p) + vec3(0,0,0));
-    float lrb = random1(floor(p) + vec3(1,0,0));
-    float ulb = random1(floor(p) + vec3(0,1,0));
-    float urb = random1(floor(p) + vec3(1,1,0));
-
-    float llf = random1(floor(p) + vec3(0,0,1));
-    float lrf = random1(floor(p) + vec3(1,0,1));
-    float ulf = random1(floor(p) + vec3(0,1,1));
-    float urf = random1(floor(p) + vec3(1,1,1));
-
-    float mixLoBack = mySmoothStep(llb, lrb, pFract.x);
-    float mixHiBack = mySmoothStep(ulb, urb, pFract.x);
-    float mixLoFront = mySmoothStep(llf, lrf, pFract.x);
-    float mixHiFront = mySmoothStep(ulf, urf, pFract.x);
-
-    float mixLo = mySmoothStep(mixLoBack, mixLoFront, pFract.z);
-    float mixHi = mySmoothStep(mixHiBack, mixHiFront, pFract.z);
-
-    return mySmoothStep(mixLo, mixHi, pFract.y);
-}
-
-float fbm(vec3 p) {
-    float amp = 0.5;
-    float freq = 4.0;
-    float sum = float(0.0);
-    for(int i = 0; i < 8; i++) {
-        sum += cubicTriMix(p * freq) * amp;
-        amp *= 0.5;
-        freq *= 2.0;
-    }
-    return sum;
-}
-
 // sun rotation around x axis given point and angle
 vec4 rotateX(vec4 p, float a) {
     return vec4(p.x, cos(a) * p.y + -sin(a) * p.z, sin(a) * p.y + cos(a) * p.z, 0.0);
@@ -100,7 +60,9 @@ void main()
         fs_UV.x < 9.f / 16.f &&
         fs_UV.y < 14.f / 16.f) {
 
-        vec3 p = vec3((fs_Pos.xz / 16.f), 1);
+        // baked fbm of the world position. The texture wraps around
+        // the window of the world that GrassTint keeps it baked for.
+        float tint = texture(u_GrassTint, fs_Pos.xz / GRASS_TINT_WINDOW).r;
 
         // brownish grass
         vec3 grass_1 = vec3(0.95, 0.65, 0.35);
@@ -108,8 +70,8 @@ void main()
         vec3 grass_2 = vec3(0.5, 0.5, 0.25);
 
         // using fbm to dynamically color
-        vec3 col = mix(grass_2 * diffuseColor.rgb, grass_1 * diffuseColor.rgb, fbm(p));
-        vec3 color = mix(col * diffuseColor.rgb, diffuseColor.rgb, fbm(p));
+        vec3 col = mix(grass_2 * diffuseColor.rgb, grass_1 * diffuseColor.rgb, tint);
+        vec3 color = mix(col * diffuseColor.rgb, diffuseColor.rgb, tint);
 
         diffuseColor = vec4(color, diffuseColor.a);
     }
@@ -133,7 +95,7 @@ void main()
     // fog
     vec4 fog_color = vec4(0.75, 0.75, 0.75, 1);
     vec4 fog = rotateY(normalize(fog_color), u_Time * 0.011);    // fog color matches color of sky
-    float dist = length(fs_Pos.xz - u_Player.xz) * 0.01;        // fog moves with player
+    float dist = length(fs_Pos.xz - u_Player.xz) / u_FogDistance; // fog moves with player
 
     vec4 color = vec4(diffuseColor.rgb * lightIntensity, diffuseColor.a);
     color = mix(color, fog, pow(smoothstep(0, 1, min(1, dist)), 2));
@@ -36,6 +36,10 @@ out vec4 fs_LightVec;       // The direction in which our virtual light lies, re
 out vec4 fs_CameraPos;
 out vec4 fs_UV;
 
+// Terrain's depth pre-pass draws the same geometry through this shader in
+// another program, and the shading pass tests for equal depth against it
+invariant gl_Position;
+
 const vec4 lightDir = normalize(vec4(0.5, 1, 0.75, 0));  // The direction of our virtual light, which is used to compute the shading of
                                         // the geometry in the fragment shader.
 
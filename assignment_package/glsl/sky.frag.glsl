@@ -4,7 +4,10 @@ uniform mat4 u_ViewProj;    // We're actually passing the inverse of the viewpro
                             // from our CPU, but it's named u_ViewProj so we don't
                             // have to bother rewriting our ShaderProgram class
 
-uniform ivec2 u_Dimensions; // Screen dimensions
+uniform ivec2 u_Dimensions; // Screen dimensions, or the noise map's in mode 2
+
+uniform int u_Mode; // 0: noise per pixel, 1: noise from u_Texture, 2: draw the noise map
+uniform sampler2D u_Texture; // Noise map, over the same uv as sphereToUV
 
 uniform vec3 u_Eye; // Camera pos
 
@@ -43,6 +46,13 @@ vec2 sphereToUV(vec3 p) {
     return vec2(1 - phi / TWO_PI, 1 - theta / PI);
 }
 
+// inverse of sphereToUV, gives the direction that maps to uv
+vec3 uvToSphere(vec2 uv) {
+    float phi = (1 - uv.x) * TWO_PI;
+    float theta = (1 - uv.y) * PI;
+    return vec3(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+}
+
 // takes in uv coords of polar coords sphereToUV
 // measures just y coord for linearly arranged piecewise values
 // gives right sunset color mix depending uv.y
@@ -192,6 +202,13 @@ float worleyFBM(vec3 uv) {
 
 void main()
 {
+    // filling in the noise map, one texel per direction
+    if (u_Mode == 2) {
+        vec3 dir = uvToSphere(gl_FragCoord.xy / vec2(u_Dimensions));
+        outColor = vec4(worleyFBM(dir), 0, 0, 1);
+        return;
+    }
+
     // ray casting
     // convert to world space
     vec2 ndc = (gl_FragCoord.xy / vec2(u_Dimensions)) * 2.0 - 1.0; // -1 to 1 NDC
@@ -211,7 +228,11 @@ void main()
 #ifdef WORLEY_OFFSET
     // Get a noise value in the range [-1, 1]
     // by using Worley noise as the noise basis of FBM
-    offset = vec2(worleyFBM(rayDir));
+    if (u_Mode == 1) {
+        offset = vec2(texture(u_Texture, uv).r);
+    } else {
+        offset = vec2(worleyFBM(rayDir));
+    }
     offset *= 2.0;
     offset -= vec2(1.0);
 #endif
@@ -16,15 +16,15 @@ Drawable::~Drawable()
 
 void Drawable::destroy()
 {
-    mp_context->glDeleteBuffers(1, &m_bufIdx);
-    mp_context->glDeleteBuffers(1, &m_bufPos);
-    mp_context->glDeleteBuffers(1, &m_bufNor);
-    mp_context->glDeleteBuffers(1, &m_bufCol);
+    mp_context->deleteBuffers(1, &m_bufIdx);
+    mp_context->deleteBuffers(1, &m_bufPos);
+    mp_context->deleteBuffers(1, &m_bufNor);
+    mp_context->deleteBuffers(1, &m_bufCol);
 
-    mp_context->glDeleteBuffers(1, &m_bufOpq);
-    mp_context->glDeleteBuffers(1, &m_bufTrans);
-    mp_context->glDeleteBuffers(1, &m_bufIdxOpq);
-    mp_context->glDeleteBuffers(1, &m_bufIdxTrans);
+    mp_context->deleteBuffers(1, &m_bufOpq);
+    mp_context->deleteBuffers(1, &m_bufTrans);
+    mp_context->deleteBuffers(1, &m_bufIdxOpq);
+    mp_context->deleteBuffers(1, &m_bufIdxTrans);
 
     m_idxGenerated = m_posGenerated = m_norGenerated = m_colGenerated =
     m_opqGenerated = m_idxOpqGenerated = m_transGenerated = m_idxTransGenerated = false;
@@ -124,7 +124,7 @@ void Drawable::generateTrans() {
 bool Drawable::bindIdx()
 {
     if(m_idxGenerated) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
+        mp_context->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdx);
     }
     return m_idxGenerated;
 }
@@ -133,7 +133,7 @@ bool Drawable::bindIdx()
 bool Drawable::bindIdxOpq()
 {
     if(m_idxOpqGenerated) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
+        mp_context->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxOpq);
     }
     return m_idxOpqGenerated;
 }
@@ -141,7 +141,7 @@ bool Drawable::bindIdxOpq()
 bool Drawable::bindIdxTrans()
 {
     if(m_idxTransGenerated) {
-        mp_context->glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTrans);
+        mp_context->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_bufIdxTrans);
     }
     return m_idxTransGenerated;
 }
@@ -149,7 +149,7 @@ bool Drawable::bindIdxTrans()
 bool Drawable::bindPos()
 {
     if(m_posGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufPos);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufPos);
     }
     return m_posGenerated;
 }
@@ -157,7 +157,7 @@ bool Drawable::bindPos()
 bool Drawable::bindNor()
 {
     if(m_norGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufNor);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufNor);
     }
     return m_norGenerated;
 }
@@ -165,7 +165,7 @@ bool Drawable::bindNor()
 bool Drawable::bindCol()
 {
     if(m_colGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufCol);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufCol);
     }
     return m_colGenerated;
 }
@@ -173,7 +173,7 @@ bool Drawable::bindCol()
 bool Drawable::bindUV()
 {
     if(m_UVGenerated){
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufUV);
     }
     return m_UVGenerated;
 }
@@ -181,14 +181,14 @@ bool Drawable::bindUV()
 // added in milestone 2
 bool Drawable::bindOpq() {
     if (m_opqGenerated) {
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufOpq);
     }
     return m_opqGenerated;
 }
 
 bool Drawable::bindTrans() {
     if (m_transGenerated) {
-        mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufTrans);
+        mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufTrans);
     }
     return m_transGenerated;
 }
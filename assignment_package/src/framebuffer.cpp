@@ -22,7 +22,7 @@ void FrameBuffer::create() {
 
     mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
     // Bind our texture so that all functions that deal with textures will interact with this one
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
     // Give an empty image to OpenGL ( the last "0" )
     mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
 
@@ -63,7 +63,7 @@ void FrameBuffer::createDepth() {
 
     mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
     // Bind our texture so that all functions that deal with textures will interact with this one
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
     // Give an empty image to OpenGL ( the last "0" )
     mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT16, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
 
@@ -90,11 +90,37 @@ void FrameBuffer::createDepth() {
     }
 }
 
+void FrameBuffer::createColor(GLenum internalFormat) {
+    mp_context->glGenFramebuffers(1, &m_frameBuffer);
+    mp_context->glGenTextures(1, &m_outputTexture);
+
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, m_frameBuffer);
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_width * m_devicePixelRatio, m_height * m_devicePixelRatio, 0, GL_RGB, GL_UNSIGNED_BYTE, (void*)0);
+
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+    mp_context->glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, m_outputTexture, 0);
+    GLenum drawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+    mp_context->glDrawBuffers(1, drawBuffers);
+
+    m_created = true;
+    if(mp_context->glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    {
+        m_created = false;
+        std::cout << "Frame buffer did not initialize correctly..." << std::endl;
+        mp_context->printGLErrorLog();
+    }
+}
+
 void FrameBuffer::destroy() {
     if(m_created) {
         m_created = false;
         mp_context->glDeleteFramebuffers(1, &m_frameBuffer);
-        mp_context->glDeleteTextures(1, &m_outputTexture);
+        mp_context->deleteTextures(1, &m_outputTexture);
         mp_context->glDeleteRenderbuffers(1, &m_depthRenderBuffer);
     }
 }
@@ -105,8 +131,20 @@ void FrameBuffer::bindFrameBuffer() {
 
 void FrameBuffer::bindToTextureSlot(unsigned int slot) {
     m_textureSlot = slot;
-    mp_context->glActiveTexture(GL_TEXTURE0 + slot);
-    mp_context->glBindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->activeTexture(GL_TEXTURE0 + slot);
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
+}
+
+void FrameBuffer::setFilter(GLenum filter) {
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+}
+
+void FrameBuffer::setWrap(GLenum s, GLenum t) {
+    mp_context->bindTexture(GL_TEXTURE_2D, m_outputTexture);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, s);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, t);
 }
 
 unsigned int FrameBuffer::getTextureSlot() const {
@@ -32,10 +32,17 @@ public:
     // Initialize all GPU-side data required
     void create();
     void createDepth();
+    // Like create(), but the texture has the given internal format
+    // and there is no depth buffer
+    void createColor(GLenum internalFormat);
     // Deallocate all GPU-side data
     void destroy();
     void bindFrameBuffer();
     // Associate our output texture with the indicated texture slot
     void bindToTextureSlot(unsigned int slot);
+    // Set how the output texture is sampled, GL_NEAREST unless changed
+    void setFilter(GLenum filter);
+    // Set how the output texture wraps along s and t, GL_CLAMP_TO_EDGE unless changed
+    void setWrap(GLenum s, GLenum t);
     unsigned int getTextureSlot() const;
 };
@@ -0,0 +1,230 @@
+#include "frameprofiler.h"
+#include <cstdio>
+
+FrameProfiler::Scope::Scope(FrameProfiler *profiler, Section section)
+    : mp_profiler(profiler), m_section(section), m_start()
+{
+    if (mp_profiler != nullptr) {
+        m_start = std::chrono::steady_clock::now();
+    }
+}
+
+FrameProfiler::Scope::~Scope() {
+    if (mp_profiler != nullptr) {
+        mp_profiler->add(m_section, std::chrono::steady_clock::now() - m_start);
+    }
+}
+
+FrameProfiler::FrameProfiler()
+    : m_pendingNs(), m_frameStart(std::chrono::steady_clock::now()), m_frameIndex(0),
+      m_queries(), m_slotFrame(), m_slotUsed(), m_gpuTimers(false), m_gpuOpen(GPU_SECTION_COUNT),
+      m_history()
+{
+    for (std::atomic<long long> &ns : m_pendingNs) {
+        ns = 0;
+    }
+    m_slotFrame.fill(-1);
+}
+
+void FrameProfiler::create() {
+    m_gpuTimers = true;
+    for (auto &slot : m_queries) {
+        for (uPtr<QOpenGLTimerQuery> &query : slot) {
+            query = mkU<QOpenGLTimerQuery>();
+            // Fails without GL 3.3 or ARB_timer_query
+            m_gpuTimers = m_gpuTimers && query->create();
+        }
+    }
+    if (!m_gpuTimers) {
+        destroy();
+    }
+}
+
+void FrameProfiler::destroy() {
+    for (auto &slot : m_queries) {
+        for (uPtr<QOpenGLTimerQuery> &query : slot) {
+            if (query != nullptr) {
+                query->destroy();
+                query.reset();
+            }
+        }
+    }
+    m_gpuTimers = false;
+}
+
+bool FrameProfiler::hasGpuTimers() const {
+    return m_gpuTimers;
+}
+
+void FrameProfiler::beginFrame() {
+    m_frameStart = std::chrono::steady_clock::now();
+    if (m_gpuTimers) {
+        // This frame reuses the slot of the frame FRAMES_IN_FLIGHT ago
+        int slot = static_cast<int>(m_frameIndex % FRAMES_IN_FLIGHT);
+        collectGpu(slot);
+        m_slotFrame[slot] = m_frameIndex;
+        m_slotUsed[slot].fill(false);
+    }
+}
+
+void FrameProfiler::endFrame() {
+    endGpu();
+
+    Frame frame;
+    frame.index = m_frameIndex++;
+    frame.frameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count();
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        frame.cpuMs[i] = m_pendingNs[i].exchange(0) / 1e6f;
+    }
+    frame.gpuMs.fill(0);
+    frame.gpuValid = false;
+
+    m_history.push_back(frame);
+    if (static_cast<int>(m_history.size()) > HISTORY) {
+        m_history.pop_front();
+    }
+}
+
+void FrameProfiler::beginGpu(GpuSection section) {
+    if (!m_gpuTimers) {
+        return;
+    }
+    // Timer queries can't nest, so a new section ends the last one
+    endGpu();
+    int slot = static_cast<int>(m_frameIndex % FRAMES_IN_FLIGHT);
+    m_queries[slot][section]->begin();
+    m_slotUsed[slot][section] = true;
+    m_gpuOpen = section;
+}
+
+void FrameProfiler::endGpu() {
+    if (m_gpuOpen == GPU_SECTION_COUNT) {
+        return;
+    }
+    int slot = static_cast<int>(m_frameIndex % FRAMES_IN_FLIGHT);
+    m_queries[slot][m_gpuOpen]->end();
+    m_gpuOpen = GPU_SECTION_COUNT;
+}
+
+void FrameProfiler::add(Section section, std::chrono::steady_clock::duration time) {
+    m_pendingNs[section] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+}
+
+FrameProfiler::Frame* FrameProfiler::findFrame(long long index) {
+    if (m_history.empty() || index < m_history.front().index || index > m_history.back().index) {
+        return nullptr;
+    }
+    return &m_history[index - m_history.front().index];
+}
+
+void FrameProfiler::collectGpu(int slot) {
+    Frame *frame = findFrame(m_slotFrame[slot]);
+    if (frame == nullptr) {
+        return;
+    }
+    for (int i = 0; i < GPU_SECTION_COUNT; i++) {
+        if (!m_slotUsed[slot][i]) {
+            continue;
+        }
+        // Still not back after FRAMES_IN_FLIGHT frames. Rather
+        // than wait, this frame goes without GPU times.
+        if (!m_queries[slot][i]->isResultAvailable()) {
+            return;
+        }
+        frame->gpuMs[i] = m_queries[slot][i]->waitForResult() / 1e6f;
+    }
+    frame->gpuValid = true;
+}
+
+FrameProfiler::Frame FrameProfiler::average(int n) const {
+    Frame avg;
+    avg.index = m_history.empty() ? 0 : m_history.back().index;
+    avg.frameMs = 0;
+    avg.cpuMs.fill(0);
+    avg.gpuMs.fill(0);
+    avg.gpuValid = false;
+
+    int frames = 0, gpuFrames = 0;
+    for (auto it = m_history.rbegin(); it != m_history.rend() && frames < n; ++it, ++frames) {
+        avg.frameMs += it->frameMs;
+        for (int i = 0; i < SECTION_COUNT; i++) {
+            avg.cpuMs[i] += it->cpuMs[i];
+        }
+        if (it->gpuValid) {
+            for (int i = 0; i < GPU_SECTION_COUNT; i++) {
+                avg.gpuMs[i] += it->gpuMs[i];
+            }
+            gpuFrames++;
+        }
+    }
+    if (frames > 0) {
+        avg.frameMs /= frames;
+        for (float &ms : avg.cpuMs) {
+            ms /= frames;
+        }
+    }
+    if (gpuFrames > 0) {
+        for (float &ms : avg.gpuMs) {
+            ms /= gpuFrames;
+        }
+        avg.gpuValid = true;
+    }
+    return avg;
+}
+
+const std::deque<FrameProfiler::Frame>& FrameProfiler::history() const {
+    return m_history;
+}
+
+bool FrameProfiler::exportCsv(const std::string &path) const {
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    std::fprintf(file, "frame,frame_ms");
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        std::fprintf(file, ",%s_ms", sectionName(static_cast<Section>(i)));
+    }
+    for (int i = 0; i < GPU_SECTION_COUNT; i++) {
+        std::fprintf(file, ",gpu_%s_ms", gpuSectionName(static_cast<GpuSection>(i)));
+    }
+    std::fprintf(file, "\n");
+
+    for (const Frame &frame : m_history) {
+        std::fprintf(file, "%lld,%.3f", frame.index, frame.frameMs);
+        for (float ms : frame.cpuMs) {
+            std::fprintf(file, ",%.3f", ms);
+        }
+        // Left empty where there are no GPU times
+        for (float ms : frame.gpuMs) {
+            if (frame.gpuValid) {
+                std::fprintf(file, ",%.3f", ms);
+            } else {
+                std::fprintf(file, ",");
+            }
+        }
+        std::fprintf(file, "\n");
+    }
+    return std::fclose(file) == 0;
+}
+
+const char* FrameProfiler::sectionName(Section section) {
+    switch (section) {
+    case TICK: return "tick";
+    case STREAMING: return "streaming";
+    case CULLING: return "culling";
+    case SUBMISSION: return "submission";
+    case UPLOAD: return "upload";
+    default: return "";
+    }
+}
+
+const char* FrameProfiler::gpuSectionName(GpuSection section) {
+    switch (section) {
+    case GPU_SKY: return "sky";
+    case GPU_FAR_TERRAIN: return "far_terrain";
+    case GPU_CHUNKS: return "chunks";
+    default: return "";
+    }
+}
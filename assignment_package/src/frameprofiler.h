@@ -0,0 +1,116 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <QOpenGLTimerQuery>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <string>
+
+// Breaks each frame's time down into a few named sections, on the CPU and,
+// where the driver has timer queries, on the GPU too.
+//
+// CPU time is measured with Scopes. A section may be timed several times a
+// frame, from any thread; whatever was spent in it between two endFrame()
+// calls is that frame's share. GPU time is measured with timer queries
+// around whole passes, which can't nest. Their results are only read once
+// the GPU has caught up, a few frames later, so reading them never stalls.
+class FrameProfiler {
+public:
+    enum Section {
+        TICK,       // Player physics, on the simulation thread
+        STREAMING,  // Deciding which Chunks to load and unload
+        CULLING,    // Finding the Chunks to draw
+        SUBMISSION, // Issuing draw calls
+        UPLOAD,     // Sending finished meshes to the GPU
+        SECTION_COUNT
+    };
+    enum GpuSection {
+        GPU_SKY,         // With the water and lava overlay
+        GPU_FAR_TERRAIN,
+        GPU_CHUNKS,
+        GPU_SECTION_COUNT
+    };
+
+    struct Frame {
+        long long index;
+        // From beginFrame() to endFrame()
+        float frameMs;
+        std::array<float, SECTION_COUNT> cpuMs;
+        // Only meaningful if gpuValid, which is false until the results
+        // come back, or for good if the queries aren't supported
+        std::array<float, GPU_SECTION_COUNT> gpuMs;
+        bool gpuValid;
+    };
+
+    // Times the enclosing block. Does nothing if given no profiler.
+    class Scope {
+    public:
+        Scope(FrameProfiler *profiler, Section section);
+        ~Scope();
+
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        FrameProfiler *mp_profiler;
+        Section m_section;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    // How many frames of history are kept, and exported
+    static const int HISTORY = 600;
+
+    FrameProfiler();
+
+    FrameProfiler(const FrameProfiler&) = delete;
+    FrameProfiler& operator=(const FrameProfiler&) = delete;
+
+    // Makes the timer queries, if the driver has them. Needs the GL context.
+    void create();
+    void destroy();
+    bool hasGpuTimers() const;
+
+    // Called from the thread that owns the GL context
+    void beginFrame();
+    void endFrame();
+    void beginGpu(GpuSection section);
+    void endGpu();
+
+    // Adds to the current frame's time in section. Safe from any thread.
+    void add(Section section, std::chrono::steady_clock::duration time);
+
+    // Average of the last n frames. The GPU times are averaged over just
+    // those of them whose results are in, and gpuValid says if any were.
+    Frame average(int n) const;
+    const std::deque<Frame>& history() const;
+    // Writes the history as CSV, one line per frame, oldest first.
+    // Returns false if the file can't be written.
+    bool exportCsv(const std::string &path) const;
+
+    static const char* sectionName(Section section);
+    static const char* gpuSectionName(GpuSection section);
+
+private:
+    // Frames a query may take to come back before its slot is reused
+    static const int FRAMES_IN_FLIGHT = 4;
+
+    // Reads whatever came back for the frame that last used slot
+    void collectGpu(int slot);
+    Frame* findFrame(long long index);
+
+    std::array<std::atomic<long long>, SECTION_COUNT> m_pendingNs;
+    std::chrono::steady_clock::time_point m_frameStart;
+    long long m_frameIndex;
+
+    // One query per GPU section per frame in flight
+    std::array<std::array<uPtr<QOpenGLTimerQuery>, GPU_SECTION_COUNT>, FRAMES_IN_FLIGHT> m_queries;
+    // The frame that last used each slot, and which of its queries ran
+    std::array<long long, FRAMES_IN_FLIGHT> m_slotFrame;
+    std::array<std::array<bool, GPU_SECTION_COUNT>, FRAMES_IN_FLIGHT> m_slotUsed;
+    bool m_gpuTimers;
+    // The GPU section currently running, or GPU_SECTION_COUNT
+    GpuSection m_gpuOpen;
+
+    std::deque<Frame> m_history;
+};
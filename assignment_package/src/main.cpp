@@ -29,6 +29,10 @@ int main(int argc, char *argv[])
     format.setVersion(3, 2);
     format.setOption(QSurfaceFormat::DeprecatedFunctions, false);
     format.setProfile(QSurfaceFormat::CoreProfile);
+#ifdef QT_DEBUG
+    // Lets the driver report GL errors through KHR_debug
+    format.setOption(QSurfaceFormat::DebugContext);
+#endif
     //format.setSamples(4);  // Uncomment for nice antialiasing. Not always supported.
 
     /*** AUTOMATIC TESTING: DO NOT MODIFY ***/
@@ -20,6 +20,8 @@ MainWindow::MainWindow(QWidget *parent) :
     connect(ui->mygl, SIGNAL(sig_sendPlayerLook(QString)), &playerInfoWindow, SLOT(slot_setLookText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerChunk(QString)), &playerInfoWindow, SLOT(slot_setChunkText(QString)));
     connect(ui->mygl, SIGNAL(sig_sendPlayerTerrainZone(QString)), &playerInfoWindow, SLOT(slot_setZoneText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendRates(QString)), &playerInfoWindow, SLOT(slot_setRateText(QString)));
+    connect(ui->mygl, SIGNAL(sig_sendPipelineStats(QString)), &playerInfoWindow, SLOT(slot_setPipelineText(QString)));
 
     // inventory
     connect(ui->mygl, SIGNAL(sig_inventoryOpenClose(bool)), this, SLOT(slot_inventoryOpenClose(bool)));
@@ -1,17 +1,28 @@
 #include "mygl.h"
 #include <glm_includes.h>
 
+#include <algorithm>
+#include <cstdio>
 #include <iostream>
 #include <QApplication>
 #include <QKeyEvent>
 #include <qdatetime.h>
+#include <stdexcept>
+#include "scene/procgen.h"
 
 MyGL::MyGL(QWidget *parent)
     : OpenGLContext(parent),
       m_worldAxes(this),
-      m_progLambert(this), m_progFlat(this), m_progSky(this), m_progOverlay(this), m_quad(this),
-      m_frameBuffer(this, this->width(), this->height(), this->devicePixelRatio()),
-      m_terrain(this), m_player(glm::vec3(48.f, 150.f, 48.f), m_terrain),
+      m_progLambert(this), m_progFlat(this), m_progSky(this), m_progOverlay(this), m_progFar(this),
+      m_progGrassTint(this), m_progDepth(this), m_quad(this),
+      m_frameBuffer(this, this->width(), this->height(), this->devicePixelRatio()), m_sky(this),
+      m_terrain(this, WORLD_SEED, GENERATION_MODE, WORLD_DIR), m_farTerrain(this, m_terrain),
+      m_grassTint(this),
+      m_player(glm::vec3(48.f, 150.f, 48.f), m_terrain),
+      m_simThread(), m_simRunning(false), m_simMutex(), m_streamedFrom(m_player.mcr_position),
+      m_prevState(), m_currState(), m_currStateTime(std::chrono::steady_clock::now()),
+      m_renderStateMutex(), m_simSteps(0), m_frames(0), m_chunksDrawn(0), m_chunksCulled(0), m_chunksOccluded(0),
+      m_drawCalls(0), m_profiler(), m_renderDistance(FRAME_BUDGET_MS, 5),
       m_currMSecSinceEpoch(QDateTime::currentMSecsSinceEpoch()),
       m_texture(this), m_time(0.f),
       openInventory(false), numGrass(10), numDirt(10), numStone(10),
@@ -22,6 +33,10 @@ MyGL::MyGL(QWidget *parent)
     connect(&m_timer, SIGNAL(timeout()), this, SLOT(tick()));
     // Tell the timer to redraw 60 times per second
     m_timer.start(16);
+
+    m_currState = captureRenderState();
+    m_prevState = m_currState;
+
     setFocusPolicy(Qt::ClickFocus);
 
     setMouseTracking(true); // MyGL will track the mouse's movements even if a mouse button is not pressed
@@ -29,12 +44,22 @@ MyGL::MyGL(QWidget *parent)
 }
 
 MyGL::~MyGL() {
+    m_simRunning = false;
+    if (m_simThread.joinable()) {
+        m_simThread.join();
+    }
+
     makeCurrent();
-    glDeleteVertexArrays(1, &vao);
+    deleteVertexArrays(1, &vao);
+    m_profiler.destroy();
 
     m_quad.destroy();
     m_worldAxes.destroy();
+    m_farTerrain.destroyAll();
+    m_terrain.destroyMeshes();
     m_frameBuffer.destroy();
+    m_sky.destroy();
+    m_grassTint.destroy();
 }
 
 
@@ -48,13 +73,14 @@ void MyGL::initializeGL() {
     initializeOpenGLFunctions();
     // Print out some information about the current OpenGL context
     debugContextVersion();
+    initializeErrorChecks();
 
     // Set a few settings/modes in OpenGL rendering
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_LINE_SMOOTH);
+    enable(GL_DEPTH_TEST);
+    enable(GL_LINE_SMOOTH);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    enable(GL_BLEND);
+    blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
     // Set the color with which the screen is filled at the start of each render call.
@@ -71,6 +97,7 @@ void MyGL::initializeGL() {
 
     // Initiailize frame buffers
     m_frameBuffer.create();
+    m_sky.create();
 
     // Create and set up the diffuse shader
     m_progLambert.create(":/glsl/lambert.vert.glsl", ":/glsl/lambert.frag.glsl");
@@ -81,6 +108,15 @@ void MyGL::initializeGL() {
     m_quad.create();
     // overlay shader
     m_progOverlay.create(":/glsl/overlay.vert.glsl", ":/glsl/overlay.frag.glsl");
+    // Create and set up the far terrain shader
+    m_progFar.create(":/glsl/far.vert.glsl", ":/glsl/far.frag.glsl");
+    // Bakes the grass tint around the player
+    m_progGrassTint.create(":/glsl/sky.vert.glsl", ":/glsl/grasstint.frag.glsl");
+    // Lays down the terrain's depth before it is shaded
+    m_progDepth.create(":/glsl/lambert.vert.glsl", ":/glsl/depth.frag.glsl");
+
+    m_progLambert.setFogDistance(FOG_DISTANCE);
+    m_progFar.setFogDistance(FOG_DISTANCE);
 
     // Set a color with which to draw geometry.
     // This will ultimately not be used when you change
@@ -90,29 +126,42 @@ void MyGL::initializeGL() {
 
     // We have to have a VAO bound in OpenGL 3.2 Core. But if we're not
     // using multiple VAOs, we can just bind one once.
-    glBindVertexArray(vao);
+    bindVertexArray(vao);
 
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    enable(GL_BLEND);
+    blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     m_texture.create(":/minecraft_textures_all/minecraft_textures_all.png");
     m_texture.load(0);
+    m_grassTint.create();
+    m_progLambert.setGrassTint(GRASS_TINT_SLOT);
+
+    m_profiler.create();
+    if (!m_profiler.hasGpuTimers()) {
+        printf("No GL timer queries, so the profiler only times the CPU\n");
+    }
+
+    // Everything the simulation needs exists now, so start stepping the world
+    m_simRunning = true;
+    m_simThread = std::thread(&MyGL::simulate, this);
 }
 
 void MyGL::resizeGL(int w, int h) {
     //This code sets the concatenated view and perspective projection matrices used for
     //our scene's camera view.
+    std::lock_guard<std::mutex> lock(m_simMutex);
     m_player.setCameraWidthHeight(static_cast<unsigned int>(w), static_cast<unsigned int>(h));
     glm::mat4 viewproj = m_player.mcr_camera.getViewProj();
 
     // Upload the view-projection matrix to our shaders (i.e. onto the graphics card)
     m_progLambert.setViewProjMatrix(viewproj);
     m_progFlat.setViewProjMatrix(viewproj);
+    m_progFar.setViewProjMatrix(viewproj);
+    m_progDepth.setViewProjMatrix(viewproj);
     m_progSky.setViewProjMatrix(glm::inverse(viewproj));
 
     m_progSky.useMe();
-    this->glUniform2i(m_progSky.unifDimensions, width(), height());
-    this->glUniform3f(m_progSky.unifEye, m_player.mcr_camera.mcr_position.x,
+    this->uniform3f(m_progSky.unifEye, m_player.mcr_camera.mcr_position.x,
                                          m_player.mcr_camera.mcr_position.y,
                                          m_player.mcr_camera.mcr_position.z);
 
@@ -124,24 +173,117 @@ void MyGL::resizeGL(int w, int h) {
 }
 
 // MyGL's constructor links tick() to a timer that fires 60 times per second.
-// We're treating MyGL as our game engine class, so we're going to perform
-// all per-frame actions here, such as performing physics updates on all
-// entities in the scene.
+// The world is simulated on m_simThread, so all that is left to do here
+// is to ask for a new frame and keep the GUI up to date.
 void MyGL::tick() {
-    glm::vec3 prevPlayerPos = m_player.mcr_position;
-
-    float dT = (QDateTime::currentMSecsSinceEpoch() - m_currMSecSinceEpoch) / 1000.f;
-    m_player.tick(dT, m_inputs);
-    m_currMSecSinceEpoch = QDateTime::currentMSecsSinceEpoch();
-
-    m_terrain.multithreadedWork(m_player.mcr_position, prevPlayerPos);
-
     update(); // Calls paintGL() as part of a larger QOpenGLWidget pipeline
     sendPlayerDataToGUI(); // Updates the info in the secondary window displaying player data
     sendInventoryDataToGUI(); // Update inventory quanities
+    sendRatesToGUI();
+}
+
+void MyGL::simulate() {
+    using clock = std::chrono::steady_clock;
+    const clock::duration step = std::chrono::duration_cast<clock::duration>(
+                std::chrono::duration<float>(SIM_DT));
+
+    clock::time_point nextStep = clock::now();
+    while (m_simRunning) {
+        int steps = 0;
+        while (clock::now() >= nextStep && steps < MAX_CATCHUP_STEPS) {
+            stepSimulation(SIM_DT);
+            nextStep += step;
+            steps++;
+        }
+        // Stopped at the cap with steps still due: drop the time that was
+        // lost instead of trying to make it up later. Having caught up in
+        // exactly MAX_CATCHUP_STEPS steps loses nothing.
+        if (steps == MAX_CATCHUP_STEPS && clock::now() >= nextStep) {
+            nextStep = clock::now();
+        }
+        std::this_thread::sleep_until(nextStep);
+    }
+}
+
+void MyGL::stepSimulation(float dT) {
+    glm::vec3 playerPos;
+    {
+        std::lock_guard<std::mutex> lock(m_simMutex);
+        FrameProfiler::Scope scope(&m_profiler, FrameProfiler::TICK);
+        m_player.tick(dT, m_inputs);
+        playerPos = m_player.mcr_position;
+    }
+
+    // Outside m_simMutex, so the GUI thread never waits on streaming. If
+    // the render thread is busy uploading, streaming is put off to a later
+    // step, which then loads everything the player moved into since
+    // m_streamedFrom.
+    {
+        FrameProfiler::Scope scope(&m_profiler, FrameProfiler::STREAMING);
+        if (m_terrain.tryExpansion(playerPos, m_streamedFrom)) {
+            m_streamedFrom = playerPos;
+        }
+    }
+
+    RenderState state;
+    {
+        std::lock_guard<std::mutex> lock(m_simMutex);
+        state = captureRenderState();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_renderStateMutex);
+        m_prevState = m_currState;
+        m_currState = state;
+        m_currStateTime = std::chrono::steady_clock::now();
+    }
+    m_simSteps++;
+}
+
+// Caller holds m_simMutex
+MyGL::RenderState MyGL::captureRenderState() {
+    RenderState state;
+    state.eye = m_player.mcr_camera.mcr_position;
+    state.forward = m_player.mcr_camera.getForward();
+    state.up = m_player.mcr_camera.getUp();
+    state.playerPos = m_player.mcr_position;
+    try {
+        state.underWater = m_player.isUnderWater(m_terrain, m_inputs);
+        state.underLava = !state.underWater && m_player.isUnderLava(m_terrain, m_inputs);
+    } catch (const std::out_of_range &) {
+        // The blocks around the player haven't been generated yet
+        state.underWater = false;
+        state.underLava = false;
+    }
+    return state;
+}
+
+MyGL::RenderState MyGL::interpolatedRenderState() {
+    RenderState prev, curr;
+    std::chrono::steady_clock::time_point currTime;
+    {
+        std::lock_guard<std::mutex> lock(m_renderStateMutex);
+        prev = m_prevState;
+        curr = m_currState;
+        currTime = m_currStateTime;
+    }
+
+    // curr became visible at currTime, so we're rendering somewhere
+    // between it and the step after it. Showing prev -> curr over that
+    // interval trades one step of latency for smooth motion.
+    float t = std::chrono::duration<float>(std::chrono::steady_clock::now() - currTime).count() / SIM_DT;
+    t = glm::clamp(t, 0.f, 1.f);
+
+    RenderState state = curr;
+    state.eye = glm::mix(prev.eye, curr.eye, t);
+    state.playerPos = glm::mix(prev.playerPos, curr.playerPos, t);
+    state.forward = glm::normalize(glm::mix(prev.forward, curr.forward, t));
+    state.up = glm::normalize(glm::mix(prev.up, curr.up, t));
+    return state;
 }
 
-void MyGL::sendPlayerDataToGUI() const {
+void MyGL::sendPlayerDataToGUI() {
+    std::lock_guard<std::mutex> lock(m_simMutex);
     emit sig_sendPlayerPos(m_player.posAsQString());
     emit sig_sendPlayerVel(m_player.velAsQString());
     emit sig_sendPlayerAcc(m_player.accAsQString());
@@ -153,7 +295,7 @@ void MyGL::sendPlayerDataToGUI() const {
     emit sig_sendPlayerTerrainZone(QString::fromStdString("( " + std::to_string(zone.x) + ", " + std::to_string(zone.y) + " )"));
 }
 
-void MyGL::sendInventoryDataToGUI() const {
+void MyGL::sendInventoryDataToGUI() {
     emit sig_sendNumGrass(numGrass);
     emit sig_sendNumDirt(numDirt);
     emit sig_sendNumStone(numStone);
@@ -164,10 +306,120 @@ void MyGL::sendInventoryDataToGUI() const {
     emit sig_sendNumSnow(numSnow);
 }
 
+void MyGL::sendRatesToGUI() {
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 elapsed = now - m_currMSecSinceEpoch;
+    if (elapsed < 1000) {
+        return;
+    }
+
+    int frames = m_frames;
+    float frameRate = frames * 1000.f / elapsed;
+    float simRate = m_simSteps.exchange(0) * 1000.f / elapsed;
+    m_frames = 0;
+    m_currMSecSinceEpoch = now;
+    emit sig_sendRates(QString::fromStdString(std::to_string(static_cast<int>(frameRate)) + " fps / "
+                                              + std::to_string(static_cast<int>(simRate)) + " Hz"));
+
+    // One line per stage: backlog, throughput, then average latency
+    // with the part of it spent running in parentheses
+    std::string stats;
+    for (const ChunkPipeline::StageMetrics &m : m_terrain.pipelineMetrics()) {
+        stats += m.name + ": " + std::to_string(m.backlog) + " queued, "
+                + std::to_string(static_cast<int>(m.throughput)) + "/s, "
+                + std::to_string(static_cast<int>(m.latencyMs)) + " ms ("
+                + std::to_string(static_cast<int>(m.runMs)) + " ms)\n";
+    }
+
+    // Share of the columns generated so far that each biome layer
+    // actually had to be evaluated for
+    ProcGen::BiomeCounters biomes = ProcGen::biomeCounters();
+    if (biomes.columns > 0) {
+        stats += "biomes: grass " + std::to_string(100 * biomes.grasslands / biomes.columns)
+                + "%, mountains " + std::to_string(100 * biomes.mountains / biomes.columns)
+                + "%, desert " + std::to_string(100 * biomes.desert / biomes.columns) + "%\n";
+    }
+    stats += "far terrain: 1 draw, " + std::to_string(m_farTerrain.byteSize() / 1024) + " KB\n";
+    // Per frame, averaged since the last report
+    if (frames > 0) {
+        stats += "chunks: " + std::to_string(m_chunksDrawn / frames) + " drawn, "
+                + std::to_string(m_chunksCulled / frames) + " culled, "
+                + std::to_string(m_chunksOccluded / frames) + " occluded\n";
+        stats += "terrain: " + std::to_string(m_drawCalls / frames) + " draw calls"
+                + (m_terrain.multiDraw() ? " (multi-draw)" : "")
+                + (m_terrain.depthPrePass() ? " (depth pre-pass)\n" : "\n");
+        StateCallCounts calls = stateCallCounts();
+        stats += "GL state calls: " + std::to_string(calls.issued / frames) + " issued, "
+                + std::to_string(calls.skipped / frames) + " skipped as redundant\n";
+        stats += "uniforms: " + std::to_string(calls.uniformBytes / frames) + " bytes\n";
+    }
+    resetStateCallCounts();
+    m_chunksDrawn = 0;
+    m_chunksCulled = 0;
+    m_chunksOccluded = 0;
+    m_drawCalls = 0;
+
+    // The simulation steps that ran during a frame count towards it
+    FrameProfiler::Frame avg = m_profiler.average(frames);
+    char times[256];
+    std::snprintf(times, sizeof(times), "cpu: %.2f ms a frame, tick %.2f, streaming %.2f, culling %.2f,"
+                                        " submission %.2f, upload %.2f\n",
+                  avg.frameMs, avg.cpuMs[FrameProfiler::TICK], avg.cpuMs[FrameProfiler::STREAMING],
+                  avg.cpuMs[FrameProfiler::CULLING], avg.cpuMs[FrameProfiler::SUBMISSION],
+                  avg.cpuMs[FrameProfiler::UPLOAD]);
+    stats += times;
+    if (avg.gpuValid) {
+        std::snprintf(times, sizeof(times), "gpu: sky %.2f ms, far terrain %.2f, chunks %.2f\n",
+                      avg.gpuMs[FrameProfiler::GPU_SKY], avg.gpuMs[FrameProfiler::GPU_FAR_TERRAIN],
+                      avg.gpuMs[FrameProfiler::GPU_CHUNKS]);
+        stats += times;
+    } else {
+        stats += m_profiler.hasGpuTimers() ? "gpu: waiting for results\n" : "gpu: no timer queries\n";
+    }
+    // Fragments the opaque Chunks shaded, against the pixels on screen.
+    // Overdraw is how far past 1 that goes.
+    long long fragments = m_terrain.opaqueFragments();
+    if (fragments >= 0) {
+        float pixels = width() * height() * devicePixelRatio() * devicePixelRatio();
+        std::snprintf(times, sizeof(times), "opaque fragments: %lld, %.2f per pixel\n",
+                      fragments, fragments / pixels);
+        stats += times;
+    }
+    const RenderDistance::State &distance = m_renderDistance.state();
+    std::snprintf(times, sizeof(times), "render distance: %d x %d zones, %d blocks, %s (%s, %.2f of %.2f ms,"
+                                        " %d queued)\n",
+                  distance.loadZones, distance.loadZones, distance.drawRadius,
+                  distance.adaptive ? "adaptive" : "fixed", RenderDistance::actionName(distance.lastAction),
+                  distance.frameMs, m_renderDistance.targetMs(), distance.backlog);
+    stats += times;
+    ChunkArena::Stats arena = m_terrain.arenaStats();
+    stats += "mesh arena: " + std::to_string(arena.meshes) + " meshes in " + std::to_string(arena.pages)
+            + " pages, " + std::to_string(arena.usedBytes >> 20) + " / "
+            + std::to_string(arena.capacityBytes >> 20) + " MB, "
+            + std::to_string(arena.defragmentations) + " defragmentations\n";
+    emit sig_sendPipelineStats(QString::fromStdString(stats));
+}
+
 // This function is called whenever update() is called.
 // MyGL's constructor links update() to a timer that fires 60 times per second,
 // so paintGL() called at a rate of 60 frames per second.
 void MyGL::paintGL() {
+    m_frames++;
+    // Qt may have touched GL state since the last frame. Everything that
+    // isn't drawn through its own VAO uses vao.
+    invalidateStateCache();
+    bindVertexArray(vao);
+    m_profiler.beginFrame();
+
+    // Upload whatever the workers finished since the last frame
+    {
+        FrameProfiler::Scope scope(&m_profiler, FrameProfiler::UPLOAD);
+        m_terrain.checkThreadResults();
+    }
+
+    RenderState state = interpolatedRenderState();
+    glm::mat4 viewProj = m_player.mcr_camera.getViewProj(state.eye, state.forward, state.up);
+
     // Clear the screen so that we only see newly drawn images
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -176,72 +428,114 @@ void MyGL::paintGL() {
 //    glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
 //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
-    m_progLambert.setViewProjMatrix(m_player.mcr_camera.getViewProj());
+    m_progFlat.setViewProjMatrix(viewProj);
+    m_progLambert.setViewProjMatrix(viewProj);
+    m_progFar.setViewProjMatrix(viewProj);
+    m_progDepth.setViewProjMatrix(viewProj);
 
     // SKY CODE
-    m_progSky.setViewProjMatrix(glm::inverse(m_player.mcr_camera.getViewProj()));
+    m_profiler.beginGpu(FrameProfiler::GPU_SKY);
+    m_progSky.setViewProjMatrix(glm::inverse(viewProj));
     m_progSky.useMe();
-    this->glUniform3f(m_progSky.unifEye, m_player.mcr_camera.mcr_position.x,
-                                         m_player.mcr_camera.mcr_position.y,
-                                         m_player.mcr_camera.mcr_position.z);
-    this->glUniform1f(m_progSky.unifTime, m_time++);
-    m_progSky.draw(m_quad);
+    this->uniform3f(m_progSky.unifEye, state.eye.x, state.eye.y, state.eye.z);
+    this->uniform1f(m_progSky.unifTime, m_time++);
+    m_sky.draw(m_progSky, m_quad, glm::ivec2(width() * devicePixelRatio(), height() * devicePixelRatio()),
+               SKY_MAP_SLOT);
 
+    m_progFar.setTime(m_time);
     m_progLambert.setTime(m_time++);
-    m_progLambert.setPlayerPosition(glm::vec4(m_player.mcr_position.x,
-                                              m_player.mcr_position.y,
-                                              m_player.mcr_position.z, 0));
+    m_progLambert.setPlayerPosition(glm::vec4(state.playerPos.x,
+                                              state.playerPos.y,
+                                              state.playerPos.z, 0));
+    m_progFar.setPlayerPosition(glm::vec4(state.playerPos, 0));
 
-    glDisable(GL_DEPTH_TEST);
+    disable(GL_DEPTH_TEST);
     m_progFlat.setModelMatrix(glm::mat4());
-    m_progFlat.setViewProjMatrix(m_player.mcr_camera.getViewProj());
+    m_progFlat.setViewProjMatrix(viewProj);
     // m_progFlat.draw(m_worldAxes);
-    glEnable(GL_DEPTH_TEST);
+    enable(GL_DEPTH_TEST);
 
 //    glBindFramebuffer(GL_FRAMEBUFFER, this->defaultFramebufferObject());
 //    glViewport(0,0,this->width() * this->devicePixelRatio(), this->height() * this->devicePixelRatio());
 //    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    // draw the river and trees (wait for chunk to be drawn)
-    if (m_time == 500) {
-        cout << "draw river + trees" << endl;
-        m_terrain.drawRiver();
-        m_terrain.drawTrees();
+    // determine overlay
+    if (state.underWater) {
+        // cout << "underwater overlay" << endl;
+        m_progOverlay.overlayType(1);
+        m_frameBuffer.bindToTextureSlot(2);
+        m_progOverlay.drawOverlay(m_quad);
+    } else if (state.underLava) {
+        // cout << "underlava overlay" << endl;
+        m_progOverlay.overlayType(2);
+        m_frameBuffer.bindToTextureSlot(2);
+        m_progOverlay.drawOverlay(m_quad);
+    } else {
+        m_progOverlay.overlayType(0);
     }
 
-    // determine overlay after the river is drawn
-    if (m_time > 500) {
-        if (m_player.isUnderWater(m_terrain, m_inputs)) {
-            // cout << "underwater overlay" << endl;
-            m_progOverlay.overlayType(1);
-            m_frameBuffer.bindToTextureSlot(2);
-            m_progOverlay.drawOverlay(m_quad);
-        } else if (m_player.isUnderLava(m_terrain, m_inputs)) {
-            // cout << "underlava overlay" << endl;
-            m_progOverlay.overlayType(2);
-            m_frameBuffer.bindToTextureSlot(2);
-            m_progOverlay.drawOverlay(m_quad);
-        } else {
-            m_progOverlay.overlayType(0);
+    renderTerrain(state.playerPos, state.eye, viewProj);
+    m_profiler.endFrame();
+    updateRenderDistance();
+}
+
+void MyGL::updateRenderDistance() {
+    // The GPU may be what holds frames up, once its times are in
+    FrameProfiler::Frame recent = m_profiler.average(DISTANCE_FRAMES);
+    float frameMs = recent.frameMs;
+    if (recent.gpuValid) {
+        float gpuMs = 0;
+        for (float ms : recent.gpuMs) {
+            gpuMs += ms;
         }
+        frameMs = std::max(frameMs, gpuMs);
     }
 
-    renderTerrain();
+    if (m_renderDistance.update(frameMs, m_terrain.streamingBacklog())) {
+        m_terrain.setLoadZones(m_renderDistance.state().loadZones);
+    }
 }
 
 // TODO: Change this so it renders the nine zones of generated
 // terrain that surround the player (refer to Terrain::m_generatedTerrain
 // for more info)
-void MyGL::renderTerrain() {
+void MyGL::renderTerrain(glm::vec3 center, glm::vec3 eye, const glm::mat4 &viewProj) {
     m_texture.bind(0);
+    m_grassTint.update(m_progGrassTint, m_quad, center,
+                       glm::ivec2(width() * devicePixelRatio(), height() * devicePixelRatio()));
+    m_grassTint.bind(GRASS_TINT_SLOT);
+    int radius = m_renderDistance.state().drawRadius;
 
-    int xFloor = static_cast<int>(glm::floor(m_player.mcr_position.x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(m_player.mcr_position.z / 16.f));
+    int xFloor = static_cast<int>(glm::floor(center.x / 16.f));
+    int zFloor = static_cast<int>(glm::floor(center.z / 16.f));
     int x = 16 * xFloor;
     int z = 16 * zFloor;
 
-    m_terrain.draw(x - 256, x + 256, z - 256, z + 256, &m_progLambert);
+    // The far terrain goes first so that water at the edge
+    // of the Chunks blends over it
+    m_profiler.beginGpu(FrameProfiler::GPU_FAR_TERRAIN);
+    {
+        FrameProfiler::Scope scope(&m_profiler, FrameProfiler::STREAMING);
+        m_farTerrain.update(center);
+    }
+    if (m_farTerrain.elemCountOpq() >= 0) {
+        FrameProfiler::Scope scope(&m_profiler, FrameProfiler::SUBMISSION);
+        m_farTerrain.updateMask(x - radius, x + radius, z - radius, z + radius, CHUNK_MASK_SLOT);
+        m_progFar.setChunkMask(CHUNK_MASK_SLOT, m_farTerrain.maskOrigin());
+        m_progFar.drawOpq(m_farTerrain);
+    }
+
+    // Chunks past the fog would only be drawn in the fog's color
+    m_profiler.beginGpu(FrameProfiler::GPU_CHUNKS);
+    Frustum frustum(viewProj);
+    frustum.limitDistance(glm::vec2(center.x, center.z), FOG_DISTANCE);
+    Terrain::DrawCounts counts = m_terrain.draw(x - radius, x + radius, z - radius, z + radius, frustum, eye,
+                                                &m_progLambert, &m_progDepth, &m_profiler);
+    m_profiler.endGpu();
+    m_drawCalls += counts.drawCalls;
+    m_chunksDrawn += counts.drawn;
+    m_chunksCulled += counts.culled;
+    m_chunksOccluded += counts.occluded;
 }
 
 void MyGL::keyPressEvent(QKeyEvent *e) {
@@ -258,6 +552,7 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
         QApplication::quit();
     }
 
+    std::lock_guard<std::mutex> lock(m_simMutex);
     if (!e->isAutoRepeat()) {
         if (e->key() == Qt::Key_W) {
             m_inputs.wPressed = true;
@@ -282,6 +577,51 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
                 std::cout << "hide inventory" << std::endl;
             }
             emit sig_inventoryOpenClose(openInventory);
+        } else if (e->key() == Qt::Key_O) {
+            m_terrain.setOcclusionCulling(!m_terrain.occlusionCulling());
+            if (m_terrain.occlusionCulling()) {
+                std::cout << "occlusion culling on" << std::endl;
+            } else {
+                std::cout << "occlusion culling off" << std::endl;
+            }
+        } else if (e->key() == Qt::Key_M) {
+            m_terrain.setMultiDraw(!m_terrain.multiDraw());
+            if (m_terrain.multiDraw()) {
+                std::cout << "multi-draw on" << std::endl;
+            } else {
+                std::cout << "multi-draw off" << std::endl;
+            }
+        } else if (e->key() == Qt::Key_P) {
+            if (m_profiler.exportCsv(PROFILE_FILE)) {
+                std::cout << "wrote the last " << m_profiler.history().size()
+                          << " frames to " << PROFILE_FILE << std::endl;
+            } else {
+                std::cout << "could not write " << PROFILE_FILE << std::endl;
+            }
+        } else if (e->key() == Qt::Key_K) {
+            m_sky.setQuality(static_cast<Sky::Quality>((m_sky.quality() + 1) % Sky::QUALITY_COUNT));
+            std::cout << "sky quality " << Sky::qualityName(m_sky.quality()) << std::endl;
+        } else if (e->key() == Qt::Key_BracketLeft || e->key() == Qt::Key_BracketRight) {
+            // Setting the distance by hand turns the controller off
+            int step = e->key() == Qt::Key_BracketLeft ? -2 : 2;
+            m_renderDistance.setAdaptive(false);
+            m_renderDistance.setLoadZones(m_renderDistance.state().loadZones + step);
+            m_terrain.setLoadZones(m_renderDistance.state().loadZones);
+            std::cout << "render distance " << m_renderDistance.state().loadZones << " zones" << std::endl;
+        } else if (e->key() == Qt::Key_Z) {
+            m_terrain.setDepthPrePass(!m_terrain.depthPrePass());
+            if (m_terrain.depthPrePass()) {
+                std::cout << "depth pre-pass on" << std::endl;
+            } else {
+                std::cout << "depth pre-pass off" << std::endl;
+            }
+        } else if (e->key() == Qt::Key_R) {
+            m_renderDistance.setAdaptive(!m_renderDistance.state().adaptive);
+            if (m_renderDistance.state().adaptive) {
+                std::cout << "adaptive render distance on" << std::endl;
+            } else {
+                std::cout << "adaptive render distance off" << std::endl;
+            }
         }
 
         if (m_inputs.flightMode) {
@@ -316,6 +656,7 @@ void MyGL::keyPressEvent(QKeyEvent *e) {
 }
 
 void MyGL::keyReleaseEvent(QKeyEvent *e) {
+    std::lock_guard<std::mutex> lock(m_simMutex);
     if (!e->isAutoRepeat()) {
         if (e->key() == Qt::Key_W) {
             m_inputs.wPressed = false;
@@ -340,8 +681,11 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
     // for mac
     float dx = (this->width() * 0.5 - e->pos().x()) / width();
     float dy = (this->height() * 0.5 - e->pos().y()) / height();
-    m_player.rotateOnUpGlobal(dx * 360 * 0.005f);
-    m_player.rotateOnRightLocal(dy * 360 * 0.005f);
+    {
+        std::lock_guard<std::mutex> lock(m_simMutex);
+        m_player.rotateOnUpGlobal(dx * 360 * 0.005f);
+        m_player.rotateOnRightLocal(dy * 360 * 0.005f);
+    }
     moveMouseToCenter();
 
  //     for windows
@@ -362,6 +706,7 @@ void MyGL::mouseMoveEvent(QMouseEvent *e) {
 
 // add and remove chunks
 void MyGL::mousePressEvent(QMouseEvent *e) {
+    std::lock_guard<std::mutex> lock(m_simMutex);
     if (e->button() == Qt::LeftButton) {
         BlockType removed = m_player.removeBlock(&m_terrain);
         if (removed == GRASS) {
@@ -6,6 +6,7 @@
 #include "scene/worldaxes.h"
 #include "scene/camera.h"
 #include "scene/terrain.h"
+#include "scene/farterrain.h"
 #include "scene/player.h"
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLShaderProgram>
@@ -13,6 +14,14 @@
 #include "framebuffer.h"
 #include "texture.h"
 #include "scene/quad.h"
+#include "scene/sky.h"
+#include "scene/grasstint.h"
+#include "frameprofiler.h"
+#include "renderdistance.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
 
 
 class MyGL : public OpenGLContext {
@@ -23,25 +32,103 @@ private:
     ShaderProgram m_progFlat;// A shader program that uses "flat" reflection (no shadowing at all)
     ShaderProgram m_progSky;// A shader program for day/night cycle
     ShaderProgram m_progOverlay; // A shader program for water/lava overlay
+    ShaderProgram m_progFar; // A shader program for the terrain beyond the Chunks
+    ShaderProgram m_progGrassTint; // A shader program that bakes m_grassTint
+    ShaderProgram m_progDepth; // A shader program for the terrain's depth pre-pass
     Quad m_quad;
     FrameBuffer m_frameBuffer; // Frame buffer used to redirect rendered 3D scene to save as a texture
+    Sky m_sky; // Draws m_progSky, mostly from a small map of its cloud noise
+    // Texture slot of m_sky's noise map
+    static constexpr int SKY_MAP_SLOT = 3;
     GLuint vao; // A handle for our vertex array object. This will store the VBOs created in our geometry classes.
     // Don't worry too much about this. Just know it is necessary in order to render geometry.
 
+    // Every noise, river and tree in the world derives from this.
+    // The same seed always generates the same world.
+    static constexpr unsigned int WORLD_SEED = 1337;
+    // Carve caves and overhangs out of the height map
+    static constexpr GenerationMode GENERATION_MODE = DENSITY_TERRAIN;
+    // A world pre-generated with tools/pregen, relative to the working
+    // directory. Used if it exists and matches the seed and mode above.
+    static constexpr const char *WORLD_DIR = "world";
+
     Terrain m_terrain; // All of the Chunks that currently comprise the world.
+    FarTerrain m_farTerrain; // Stands in for the world where there are no Chunks to draw
+    // Texture slot of m_farTerrain's chunk mask
+    static constexpr int CHUNK_MASK_SLOT = 1;
+    GrassTint m_grassTint; // The noise that tints grass tops, baked around the player
+    static constexpr int GRASS_TINT_SLOT = 4;
+    // Everything is hidden by fog this far from the player. Just short of
+    // where the far terrain ends in the direction it reaches least.
+    static constexpr float FOG_DISTANCE = FarTerrain::RADIUS - FarTerrain::SNAP;
     Player m_player; // The entity controlled by the user. Contains a camera to display what it sees as well.
     InputBundle m_inputs; // A collection of variables to be updated in keyPressEvent, mouseMoveEvent, mousePressEvent, etc.
 
+    // The world is simulated on its own thread at a fixed rate, independent
+    // of how fast paintGL() runs. m_simMutex guards m_player and m_inputs, and
+    // must be held by anything on the GUI thread that touches them. When both
+    // are needed it is taken before Terrain's streaming mutex. The simulation
+    // thread streams Chunks without holding it.
+    static constexpr int SIM_HZ = 60;
+    static constexpr float SIM_DT = 1.f / SIM_HZ;
+    // If the simulation falls further behind than this, it drops the
+    // backlog instead of spiralling
+    static constexpr int MAX_CATCHUP_STEPS = 5;
+
+    std::thread m_simThread;
+    std::atomic<bool> m_simRunning;
+    std::mutex m_simMutex;
+    // Where the player was the last time Terrain::tryExpansion() ran.
+    // Only touched by the simulation thread.
+    glm::vec3 m_streamedFrom;
+
+    // What paintGL() needs from one simulation step. The simulation thread
+    // publishes one per step and paintGL() interpolates between the last two.
+    struct RenderState {
+        glm::vec3 eye, forward, up;
+        glm::vec3 playerPos;
+        bool underWater, underLava;
+    };
+    RenderState m_prevState, m_currState;
+    std::chrono::steady_clock::time_point m_currStateTime;
+    std::mutex m_renderStateMutex; // Guards the three members above
+
+    // Counted since the last time the rates were sent to the GUI
+    std::atomic<int> m_simSteps;
+    int m_frames;
+    // Summed over every frame's Terrain::draw()
+    int m_chunksDrawn, m_chunksCulled, m_chunksOccluded;
+    int m_drawCalls;
+    // Times each frame, and the simulation steps that ran during it
+    FrameProfiler m_profiler;
+    // Where the P key writes m_profiler's history, relative to the working directory
+    static constexpr const char *PROFILE_FILE = "frame_profile.csv";
+    // How much of the world is loaded and drawn. Adapts to keep frames
+    // within FRAME_BUDGET_MS, judged over the last DISTANCE_FRAMES.
+    RenderDistance m_renderDistance;
+    static constexpr float FRAME_BUDGET_MS = 12.f;
+    static constexpr int DISTANCE_FRAMES = 30;
     qint64 m_currMSecSinceEpoch;
 
     QTimer m_timer; // Timer linked to tick(). Fires approximately 60 times per second.
 
+    // Body of m_simThread. Runs stepSimulation() SIM_HZ times per second
+    // until m_simRunning is cleared.
+    void simulate();
+    // Advances the player and terrain streaming by dT seconds
+    // and publishes the result for paintGL()
+    void stepSimulation(float dT);
+    RenderState captureRenderState();
+    // The latest published state, interpolated to the current time
+    RenderState interpolatedRenderState();
+
     void moveMouseToCenter(); // Forces the mouse position to the screen's center. You should call this
     // from within a mouse move event after reading the mouse movement so that
     // your mouse stays within the screen bounds and is always read.
 
-    void sendPlayerDataToGUI() const;
-    void sendInventoryDataToGUI() const;
+    void sendPlayerDataToGUI();
+    void sendInventoryDataToGUI();
+    void sendRatesToGUI();
 
     Texture m_texture;
     int m_time;
@@ -74,8 +161,12 @@ public:
     void paintGL();
 
     // Called from paintGL().
-    // Calls Terrain::draw().
-    void renderTerrain();
+    // Calls Terrain::draw() on the area around center,
+    // leaving out what can't be seen from eye through viewProj.
+    void renderTerrain(glm::vec3 center, glm::vec3 eye, const glm::mat4 &viewProj);
+    // Feeds the frame that just ended to m_renderDistance, and
+    // passes on any change to m_terrain
+    void updateRenderDistance();
 
 protected:
     // Automatically invoked when the user
@@ -91,7 +182,10 @@ protected:
     void mousePressEvent(QMouseEvent *e);
 
 private slots:
-    void tick(); // Slot that gets called ~60 times per second by m_timer firing.
+    // Slot that gets called ~60 times per second by m_timer firing.
+    // Only schedules a repaint and refreshes the GUI; the world itself
+    // is advanced by m_simThread.
+    void tick();
 
 signals:
     void sig_sendPlayerPos(QString) const;
@@ -100,6 +194,8 @@ signals:
     void sig_sendPlayerLook(QString) const;
     void sig_sendPlayerChunk(QString) const;
     void sig_sendPlayerTerrainZone(QString) const;
+    void sig_sendRates(QString) const;
+    void sig_sendPipelineStats(QString) const;
 
     void sig_inventoryOpenClose(bool);
     void sig_sendNumGrass(int) const;
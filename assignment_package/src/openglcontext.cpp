@@ -8,8 +8,11 @@
 
 
 OpenGLContext::OpenGLContext(QWidget *parent)
-    : QOpenGLWidget(parent)
-{}
+    : QOpenGLWidget(parent), m_capabilities(), m_stateCalls{0, 0, 0},
+      m_errorChecks(false), mp_debugLogger(nullptr)
+{
+    invalidateStateCache();
+}
 
 OpenGLContext::~OpenGLContext()
 {}
@@ -69,8 +72,49 @@ void OpenGLContext::debugContextVersion()
     }
 }
 
+void OpenGLContext::initializeErrorChecks()
+{
+#ifdef QT_DEBUG
+    if (context()->hasExtension("GL_KHR_debug")) {
+        mp_debugLogger = new QOpenGLDebugLogger(this);
+        if (mp_debugLogger->initialize()) {
+            QObject::connect(mp_debugLogger, &QOpenGLDebugLogger::messageLogged,
+                             [](const QOpenGLDebugMessage &message) {
+                // Drivers send plenty of notes about buffer placement and the like
+                if (message.severity() != QOpenGLDebugMessage::NotificationSeverity) {
+                    std::cerr << "OpenGL: " << message.message().toStdString() << std::endl;
+                }
+            });
+            // Synchronous, so that a breakpoint in the handler
+            // lands on the call that caused the message
+            mp_debugLogger->startLogging(QOpenGLDebugLogger::SynchronousLogging);
+            m_errorChecks = false;
+            printf("GL errors: reported through KHR_debug\n");
+            return;
+        }
+    }
+    m_errorChecks = true;
+    printf("GL errors: checked with glGetError\n");
+#else
+    m_errorChecks = false;
+#endif
+}
+
+void OpenGLContext::setErrorChecks(bool on)
+{
+    m_errorChecks = on;
+}
+
+bool OpenGLContext::errorChecks() const
+{
+    return m_errorChecks;
+}
+
 void OpenGLContext::printGLErrorLog()
 {
+    if (!m_errorChecks) {
+        return;
+    }
     GLenum error = glGetError();
     if (error != GL_NO_ERROR) {
         std::cerr << "OpenGL error " << error << ": ";
@@ -142,3 +186,217 @@ void OpenGLContext::printShaderInfoLog(int shader)
     // Throwing here allows us to use the debugger to track down the error.
     throw;
 }
+
+bool OpenGLContext::cached(GLuint &value, GLuint next)
+{
+    if (value == next) {
+        m_stateCalls.skipped++;
+        return true;
+    }
+    value = next;
+    m_stateCalls.issued++;
+    return false;
+}
+
+void OpenGLContext::useProgram(GLuint program)
+{
+    if (!cached(m_program, program)) {
+        glUseProgram(program);
+    }
+}
+
+void OpenGLContext::bindBuffer(GLenum target, GLuint buffer)
+{
+    if (target == GL_ARRAY_BUFFER) {
+        if (cached(m_arrayBuffer, buffer)) {
+            return;
+        }
+    } else if (target == GL_ELEMENT_ARRAY_BUFFER) {
+        if (cached(m_elementBuffer, buffer)) {
+            return;
+        }
+    } else {
+        m_stateCalls.issued++;
+    }
+    glBindBuffer(target, buffer);
+}
+
+void OpenGLContext::bindVertexArray(GLuint array)
+{
+    if (!cached(m_vertexArray, array)) {
+        glBindVertexArray(array);
+        // The element array binding belongs to the VAO
+        m_elementBuffer = UNKNOWN;
+    }
+}
+
+GLuint OpenGLContext::boundVertexArray() const
+{
+    return m_vertexArray;
+}
+
+void OpenGLContext::activeTexture(GLenum unit)
+{
+    if (!cached(m_activeTexture, unit)) {
+        glActiveTexture(unit);
+    }
+}
+
+void OpenGLContext::bindTexture(GLenum target, GLuint texture)
+{
+    int unit = static_cast<int>(m_activeTexture - GL_TEXTURE0);
+    if (target == GL_TEXTURE_2D && m_activeTexture != UNKNOWN && unit < TEXTURE_UNITS) {
+        if (cached(m_textures[unit], texture)) {
+            return;
+        }
+    } else {
+        m_stateCalls.issued++;
+    }
+    glBindTexture(target, texture);
+}
+
+void OpenGLContext::enable(GLenum capability)
+{
+    auto state = m_capabilities.emplace(capability, UNKNOWN).first;
+    if (!cached(state->second, GL_TRUE)) {
+        glEnable(capability);
+    }
+}
+
+void OpenGLContext::disable(GLenum capability)
+{
+    auto state = m_capabilities.emplace(capability, UNKNOWN).first;
+    if (!cached(state->second, GL_FALSE)) {
+        glDisable(capability);
+    }
+}
+
+void OpenGLContext::blendFunc(GLenum sfactor, GLenum dfactor)
+{
+    // Counted once, as the one call it is
+    if (m_blendSrc == sfactor && m_blendDst == dfactor) {
+        m_stateCalls.skipped++;
+        return;
+    }
+    m_blendSrc = sfactor;
+    m_blendDst = dfactor;
+    m_stateCalls.issued++;
+    glBlendFunc(sfactor, dfactor);
+}
+
+void OpenGLContext::depthFunc(GLenum func)
+{
+    if (!cached(m_depthFunc, func)) {
+        glDepthFunc(func);
+    }
+}
+
+void OpenGLContext::depthMask(GLboolean flag)
+{
+    if (!cached(m_depthMask, flag)) {
+        glDepthMask(flag);
+    }
+}
+
+void OpenGLContext::colorMask(GLboolean flag)
+{
+    if (!cached(m_colorMask, flag)) {
+        glColorMask(flag, flag, flag, flag);
+    }
+}
+
+void OpenGLContext::deleteBuffers(GLsizei n, const GLuint *buffers)
+{
+    glDeleteBuffers(n, buffers);
+    for (GLsizei i = 0; i < n; i++) {
+        if (buffers[i] == 0) {
+            continue;
+        }
+        if (m_arrayBuffer == buffers[i]) {
+            m_arrayBuffer = 0;
+        }
+        // It is only unbound from the VAO bound right now, not
+        // necessarily the one the cache thinks of
+        if (m_elementBuffer == buffers[i]) {
+            m_elementBuffer = UNKNOWN;
+        }
+    }
+}
+
+void OpenGLContext::deleteTextures(GLsizei n, const GLuint *textures)
+{
+    glDeleteTextures(n, textures);
+    for (GLsizei i = 0; i < n; i++) {
+        for (GLuint &bound : m_textures) {
+            if (textures[i] != 0 && bound == textures[i]) {
+                bound = 0;
+            }
+        }
+    }
+}
+
+void OpenGLContext::deleteVertexArrays(GLsizei n, const GLuint *arrays)
+{
+    glDeleteVertexArrays(n, arrays);
+    for (GLsizei i = 0; i < n; i++) {
+        if (arrays[i] != 0 && m_vertexArray == arrays[i]) {
+            m_vertexArray = 0;
+            m_elementBuffer = UNKNOWN;
+        }
+    }
+}
+
+void OpenGLContext::invalidateStateCache()
+{
+    m_program = m_arrayBuffer = m_elementBuffer = m_vertexArray = UNKNOWN;
+    m_activeTexture = UNKNOWN;
+    m_textures.fill(UNKNOWN);
+    m_capabilities.clear();
+    m_blendSrc = m_blendDst = m_depthFunc = m_depthMask = m_colorMask = UNKNOWN;
+}
+
+void OpenGLContext::uniform1i(GLint location, GLint v0)
+{
+    m_stateCalls.uniformBytes += sizeof(GLint);
+    glUniform1i(location, v0);
+}
+
+void OpenGLContext::uniform1f(GLint location, GLfloat v0)
+{
+    m_stateCalls.uniformBytes += sizeof(GLfloat);
+    glUniform1f(location, v0);
+}
+
+void OpenGLContext::uniform2i(GLint location, GLint v0, GLint v1)
+{
+    m_stateCalls.uniformBytes += 2 * sizeof(GLint);
+    glUniform2i(location, v0, v1);
+}
+
+void OpenGLContext::uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2)
+{
+    m_stateCalls.uniformBytes += 3 * sizeof(GLfloat);
+    glUniform3f(location, v0, v1, v2);
+}
+
+void OpenGLContext::uniform4fv(GLint location, GLsizei count, const GLfloat *value)
+{
+    m_stateCalls.uniformBytes += count * 4 * sizeof(GLfloat);
+    glUniform4fv(location, count, value);
+}
+
+void OpenGLContext::uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value)
+{
+    m_stateCalls.uniformBytes += count * 16 * sizeof(GLfloat);
+    glUniformMatrix4fv(location, count, transpose, value);
+}
+
+OpenGLContext::StateCallCounts OpenGLContext::stateCallCounts() const
+{
+    return m_stateCalls;
+}
+
+void OpenGLContext::resetStateCallCounts()
+{
+    m_stateCalls = {0, 0, 0};
+}
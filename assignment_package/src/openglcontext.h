@@ -3,6 +3,9 @@
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions_3_2_Core>
 #include <QTimer>
+#include <QOpenGLDebugLogger>
+#include <array>
+#include <map>
 
 
 class OpenGLContext
@@ -14,7 +17,82 @@ public:
     ~OpenGLContext();
 
     void debugContextVersion();
+    // In debug builds, has the driver report GL errors through KHR_debug
+    // as they happen, or, where that isn't available, turns on polling them
+    // in printGLErrorLog(). Release builds check for neither, since each
+    // glGetError() waits for the GL to catch up.
+    void initializeErrorChecks();
+    void setErrorChecks(bool on);
+    bool errorChecks() const;
+    // Does nothing unless error checks are on
     void printGLErrorLog();
     void printLinkInfoLog(int prog);
     void printShaderInfoLog(int shader);
+
+    // Cached versions of the GL calls that set state. Each one only reaches
+    // GL when it would change what GL last heard through the cache, so
+    // code can set exactly the state it needs without checking first.
+    // Anything that changes this state without going through here must
+    // call invalidateStateCache() afterwards.
+    void useProgram(GLuint program);
+    // Caches GL_ARRAY_BUFFER and GL_ELEMENT_ARRAY_BUFFER, passes other
+    // targets straight through
+    void bindBuffer(GLenum target, GLuint buffer);
+    void bindVertexArray(GLuint array);
+    // The VAO last bound through the cache
+    GLuint boundVertexArray() const;
+    void activeTexture(GLenum unit);
+    // Caches GL_TEXTURE_2D on each unit, passes other targets through
+    void bindTexture(GLenum target, GLuint texture);
+    void enable(GLenum capability);
+    void disable(GLenum capability);
+    void blendFunc(GLenum sfactor, GLenum dfactor);
+    void depthFunc(GLenum func);
+    void depthMask(GLboolean flag);
+    // All four channels at once
+    void colorMask(GLboolean flag);
+    // Also drop the deleted names from the cache, since GL unbinds them
+    void deleteBuffers(GLsizei n, const GLuint *buffers);
+    void deleteTextures(GLsizei n, const GLuint *textures);
+    void deleteVertexArrays(GLsizei n, const GLuint *arrays);
+    // Forgets everything, so the next call of each kind reaches GL
+    void invalidateStateCache();
+
+    // Uniform uploads, not cached but counted in uniformBytes
+    void uniform1i(GLint location, GLint v0);
+    void uniform1f(GLint location, GLfloat v0);
+    void uniform2i(GLint location, GLint v0, GLint v1);
+    void uniform3f(GLint location, GLfloat v0, GLfloat v1, GLfloat v2);
+    void uniform4fv(GLint location, GLsizei count, const GLfloat *value);
+    void uniformMatrix4fv(GLint location, GLsizei count, GLboolean transpose, const GLfloat *value);
+
+    struct StateCallCounts {
+        // Calls passed on to GL, and calls skipped as redundant
+        int issued, skipped;
+        // Bytes of uniform values sent
+        size_t uniformBytes;
+    };
+    // Since the last resetStateCallCounts()
+    StateCallCounts stateCallCounts() const;
+    void resetStateCallCounts();
+
+private:
+    // Stands for state the cache doesn't know
+    static constexpr GLuint UNKNOWN = ~0u;
+    static constexpr int TEXTURE_UNITS = 16;
+
+    // True if value already held next, otherwise stores it and counts a call
+    bool cached(GLuint &value, GLuint next);
+
+    GLuint m_program, m_arrayBuffer, m_elementBuffer, m_vertexArray;
+    GLuint m_activeTexture;
+    std::array<GLuint, TEXTURE_UNITS> m_textures;
+    // GL_TRUE or GL_FALSE for each capability set through the cache
+    std::map<GLenum, GLuint> m_capabilities;
+    GLuint m_blendSrc, m_blendDst, m_depthFunc, m_depthMask, m_colorMask;
+    StateCallCounts m_stateCalls;
+
+    bool m_errorChecks;
+    QOpenGLDebugLogger *mp_debugLogger; // Owned by Qt, through its parent
+
 };
@@ -35,4 +35,10 @@ void PlayerInfo::slot_setChunkText(QString s) {
 void PlayerInfo::slot_setZoneText(QString s) {
     ui->zoneLabel->setText(s);
 }
+void PlayerInfo::slot_setRateText(QString s) {
+    ui->rateLabel->setText(s);
+}
 
+void PlayerInfo::slot_setPipelineText(QString s) {
+    ui->pipelineLabel->setText(s);
+}
@@ -0,0 +1,87 @@
+#include "renderdistance.h"
+#include "scene/terrain.h"
+#include <algorithm>
+
+RenderDistance::RenderDistance(float targetMs, int loadZones)
+    : m_targetMs(targetMs), m_state()
+{
+    m_state.adaptive = true;
+    m_state.lastAction = HOLD;
+    setLoadZones(loadZones);
+}
+
+void RenderDistance::setAdaptive(bool adaptive) {
+    m_state.adaptive = adaptive;
+    m_state.overBudgetFrames = 0;
+    m_state.underBudgetFrames = 0;
+}
+
+void RenderDistance::setTargetMs(float targetMs) {
+    m_targetMs = targetMs;
+}
+
+float RenderDistance::targetMs() const {
+    return m_targetMs;
+}
+
+void RenderDistance::setLoadZones(int n) {
+    n = std::max(MIN_ZONES, std::min(MAX_ZONES, n));
+    if (n % 2 == 0) {
+        n++;
+    }
+    change(n, HOLD);
+}
+
+void RenderDistance::change(int loadZones, Action action) {
+    m_state.loadZones = loadZones;
+    m_state.drawRadius = drawRadius(loadZones);
+    m_state.overBudgetFrames = 0;
+    m_state.underBudgetFrames = 0;
+    m_state.cooldownFrames = COOLDOWN_FRAMES;
+    m_state.lastAction = action;
+}
+
+bool RenderDistance::update(float frameMs, int backlog) {
+    m_state.frameMs = frameMs;
+    m_state.backlog = backlog;
+    if (!m_state.adaptive) {
+        return false;
+    }
+    if (m_state.cooldownFrames > 0) {
+        // New zones make frames slower and the backlog longer for a
+        // while, which says nothing about the distance they settle at
+        m_state.cooldownFrames--;
+        return false;
+    }
+
+    bool over = frameMs > m_targetMs * OVER_BUDGET || backlog > BACKLOG_HIGH;
+    bool under = frameMs < m_targetMs * UNDER_BUDGET && backlog < BACKLOG_LOW;
+    m_state.overBudgetFrames = over ? m_state.overBudgetFrames + 1 : 0;
+    m_state.underBudgetFrames = under ? m_state.underBudgetFrames + 1 : 0;
+
+    if (m_state.overBudgetFrames >= SHRINK_FRAMES && m_state.loadZones > MIN_ZONES) {
+        change(m_state.loadZones - 2, SHRINK);
+        return true;
+    }
+    if (m_state.underBudgetFrames >= GROW_FRAMES && m_state.loadZones < MAX_ZONES) {
+        change(m_state.loadZones + 2, GROW);
+        return true;
+    }
+    return false;
+}
+
+const RenderDistance::State& RenderDistance::state() const {
+    return m_state;
+}
+
+int RenderDistance::drawRadius(int loadZones) {
+    return (loadZones + Terrain::EVICTION_MARGIN) / 2 * 64;
+}
+
+const char* RenderDistance::actionName(Action action) {
+    switch (action) {
+    case GROW: return "grew";
+    case SHRINK: return "shrank";
+    default: return "holding";
+    }
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Decides how much of the world is kept loaded and drawn around the player,
+// from how long frames take and how far behind Chunk streaming is.
+//
+// The world is loaded in an n x n grid of 64 x 64 block zones around the
+// player's zone (see Terrain::setLoadZones), and drawn out to as far as
+// loaded zones can linger before they are evicted. The controller moves n
+// up or down a ring at a time. Frames have to stay over budget, or the
+// backlog has to stay high, for a while before it shrinks; they have to
+// stay well under budget with little backlog for longer still before it
+// grows. After every change it waits for streaming to catch up before
+// looking again, so the load that new zones bring doesn't immediately
+// count against them.
+class RenderDistance {
+public:
+    // The zone grids the controller picks between. Odd, so that the grid
+    // is centered on the player's zone. The largest keeps the draw window
+    // within the 1024 blocks FarTerrain's chunk mask covers.
+    static const int MIN_ZONES = 3;
+    static const int MAX_ZONES = 13;
+
+    enum Action { HOLD, GROW, SHRINK };
+
+    struct State {
+        int loadZones;
+        // Blocks drawn on each side of the player's Chunk
+        int drawRadius;
+        // What the last update() was given
+        float frameMs;
+        int backlog;
+        // Consecutive frames each way, counting towards a change
+        int overBudgetFrames, underBudgetFrames;
+        // Frames left before another change is considered
+        int cooldownFrames;
+        Action lastAction;
+        bool adaptive;
+    };
+
+    RenderDistance(float targetMs, int loadZones);
+
+    // When off, the distance only changes through setLoadZones()
+    void setAdaptive(bool adaptive);
+    void setTargetMs(float targetMs);
+    float targetMs() const;
+    // Rounded to the nearest allowed grid
+    void setLoadZones(int n);
+
+    // Called once a frame with what that frame cost, however it is
+    // measured, and the number of Chunks waiting to be streamed in.
+    // Returns true if the distance changed.
+    bool update(float frameMs, int backlog);
+    const State& state() const;
+
+    // How far zones of a grid this size reach before they are evicted
+    static int drawRadius(int loadZones);
+    static const char* actionName(Action action);
+
+private:
+    // A frame is over budget above OVER_BUDGET * target,
+    // and well under it below UNDER_BUDGET * target
+    static constexpr float OVER_BUDGET = 1.15f;
+    static constexpr float UNDER_BUDGET = 0.7f;
+    static const int SHRINK_FRAMES = 30;
+    static const int GROW_FRAMES = 120;
+    // Chunks queued. Above the first streaming can't keep up; growing
+    // waits until it is below the second. The first is more than the
+    // 768 Chunks that the largest ring of zones adds, so that growing
+    // can't by itself cause a shrink.
+    static const int BACKLOG_HIGH = 1024;
+    static const int BACKLOG_LOW = 16;
+    static const int COOLDOWN_FRAMES = 180;
+
+    void change(int loadZones, Action action);
+
+    float m_targetMs;
+    State m_state;
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+// C++ 11 allows us to define the size of an enum. This lets us use only one byte
+// of memory to store our different block types. By default, the size of a C++ enum
+// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
+// block types, but in the scope of this project we'll never get anywhere near that many.
+enum BlockType : unsigned char
+{
+    EMPTY, GRASS, DIRT, SNOW, STONE, LAVA, WATER, ICE, SAND, WOOD, LEAF, COAL, IRON
+};
@@ -7,7 +7,7 @@ Camera::Camera(glm::vec3 pos)
 
 Camera::Camera(unsigned int w, unsigned int h, glm::vec3 pos)
     : Entity(pos), m_fovy(45), m_width(w), m_height(h),
-      m_near_clip(0.1f), m_far_clip(1000.f), m_aspect(w / static_cast<float>(h))
+      m_near_clip(0.1f), m_far_clip(6000.f), m_aspect(w / static_cast<float>(h))
 {}
 
 Camera::Camera(const Camera &c)
@@ -33,5 +33,17 @@ void Camera::tick(float dT, InputBundle &input) {
 }
 
 glm::mat4 Camera::getViewProj() const {
-    return glm::perspective(glm::radians(m_fovy), m_aspect, m_near_clip, m_far_clip) * glm::lookAt(m_position, m_position + m_forward, m_up);
+    return getViewProj(m_position, m_forward, m_up);
+}
+
+glm::mat4 Camera::getViewProj(glm::vec3 eye, glm::vec3 forward, glm::vec3 up) const {
+    return glm::perspective(glm::radians(m_fovy), m_aspect, m_near_clip, m_far_clip) * glm::lookAt(eye, eye + forward, up);
+}
+
+glm::vec3 Camera::getForward() const {
+    return m_forward;
+}
+
+glm::vec3 Camera::getUp() const {
+    return m_up;
 }
@@ -21,4 +21,10 @@ public:
     void tick(float dT, InputBundle &input) override;
 
     glm::mat4 getViewProj() const;
+    // Same projection as getViewProj(), but looking from an arbitrary
+    // pose, e.g. one interpolated between two simulation steps
+    glm::mat4 getViewProj(glm::vec3 eye, glm::vec3 forward, glm::vec3 up) const;
+
+    glm::vec3 getForward() const;
+    glm::vec3 getUp() const;
 };
@@ -1,11 +1,18 @@
 #include "chunk.h"
 #include <iostream>
+#include <algorithm>
 
-Chunk::Chunk(OpenGLContext *context) :
+Chunk::Chunk(OpenGLContext *context, ChunkArena *arena) :
     Drawable(context), m_blocks(),
-    m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}}
+    m_neighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+    m_meshNeighbors{{XPOS, nullptr}, {XNEG, nullptr}, {ZPOS, nullptr}, {ZNEG, nullptr}},
+    worldPos_x(0), worldPos_z(0), m_state(NEW), m_maxHeight(-1),
+    m_sectionVisibility(), mp_arena(arena), m_meshOpq(nullptr), m_meshTrans(nullptr),
+    m_heightMap(), m_needsRemesh(false), m_fromStore(false)
 {
     std::fill_n(m_blocks.begin(), 65536, EMPTY);
+    m_sectionVisibility.fill(ALL_FACES_VISIBLE);
+    m_heightMap.fill(0);
 }
 
 // Does bounds checking with at()
@@ -34,6 +41,31 @@ BlockType Chunk::getBlockAt(int x, int y, int z) const {
 // Does bounds checking with at()
 void Chunk::setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t) {
     m_blocks.at(x + 16 * y + 16 * 256 * z) = t;
+    if (t != EMPTY) {
+        m_maxHeight = std::max(m_maxHeight, static_cast<int>(y));
+    }
+}
+
+BlockType* Chunk::blockData() {
+    return m_blocks.data();
+}
+
+void Chunk::computeMaxHeight() {
+    m_maxHeight = -1;
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            // Only what is above the tallest column so far needs looking at
+            int y = 255;
+            while (y > m_maxHeight && getBlockAt(x, y, z) == EMPTY) {
+                y--;
+            }
+            m_maxHeight = std::max(m_maxHeight, y);
+        }
+    }
+}
+
+int Chunk::getMaxHeight() const {
+    return m_maxHeight;
 }
 
 const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirection {
@@ -45,13 +77,75 @@ const static std::unordered_map<Direction, Direction, EnumHash> oppositeDirectio
     {ZNEG, ZPOS}
 };
 
-void Chunk::linkNeighbor(uPtr<Chunk> &neighbor, Direction dir) {
+void Chunk::linkNeighbor(Chunk *neighbor, Direction dir) {
     if(neighbor != nullptr) {
-        this->m_neighbors[dir] = neighbor.get();
+        this->m_neighbors[dir] = neighbor;
         neighbor->m_neighbors[oppositeDirection.at(dir)] = this;
     }
 }
 
+void Chunk::unlinkNeighbors() {
+    for (auto & [ dir, neighbor ] : m_neighbors) {
+        if (neighbor != nullptr) {
+            neighbor->m_neighbors[oppositeDirection.at(dir)] = nullptr;
+            neighbor = nullptr;
+        }
+    }
+}
+
+Chunk* Chunk::getNeighbor(Direction dir) const {
+    return m_neighbors.at(dir);
+}
+
+ChunkState Chunk::getState() const {
+    return m_state.load();
+}
+
+void Chunk::setState(ChunkState state) {
+    m_state.store(state);
+}
+
+bool Chunk::neighborsHaveBlockData() const {
+    for (auto & [ dir, neighbor ] : m_neighbors) {
+        if (neighbor != nullptr && neighbor->getState() < BLOCKS_READY) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Chunk::snapshotNeighbors() {
+    for (auto & [ dir, neighbor ] : m_neighbors) {
+        if (neighbor != nullptr && neighbor->getState() >= BLOCKS_READY) {
+            m_meshNeighbors[dir] = neighbor;
+        } else {
+            m_meshNeighbors[dir] = nullptr;
+        }
+    }
+}
+
+int ChunkMeshInput::borderIndex(Direction side, int along, int y) {
+    int slot = side == XPOS ? 0 : side == XNEG ? 1 : side == ZPOS ? 2 : 3;
+    return slot * 16 * 256 + along + 16 * y;
+}
+
+void Chunk::copyMeshInput(ChunkMeshInput &input) const {
+    input.blocks = m_blocks;
+    input.maxHeight = m_maxHeight;
+    for (Direction side : {XPOS, XNEG, ZPOS, ZNEG}) {
+        const Chunk *neighbor = m_meshNeighbors.at(side);
+        for (int along = 0; along < 16; along++) {
+            // The neighbor's column that touches ours
+            int x = side == XPOS ? 0 : side == XNEG ? 15 : along;
+            int z = side == ZPOS ? 0 : side == ZNEG ? 15 : along;
+            for (int y = 0; y < 256; y++) {
+                input.borders[ChunkMeshInput::borderIndex(side, along, y)] =
+                        neighbor != nullptr ? neighbor->m_blocks[x + 16 * y + 16 * 256 * z] : EMPTY;
+            }
+        }
+    }
+}
+
 void Chunk::setWorldPos(int x, int z) {
     int x_floor = static_cast<int>(glm::floor(x / 16.f));
     int z_floor = static_cast<int>(glm::floor(z / 16.f));
@@ -67,15 +161,108 @@ bool isTrans(BlockType t) {
     return t == WATER || t == LAVA;
 }
 
-Chunk::~Chunk() {}
+// The bit of the pair of faces a and b in a SectionVisibility
+static int facePairBit(int a, int b) {
+    if (a > b) {
+        std::swap(a, b);
+    }
+    // Pairs are numbered (0, 1), (0, 2), ... (0, 5), (1, 2), ...
+    return a * (11 - a) / 2 + b - a - 1;
+}
+
+bool Chunk::canSee(SectionVisibility visibility, Direction from, Direction to) {
+    return from != to && (visibility >> facePairBit(from, to)) & 1;
+}
+
+SectionVisibility Chunk::getSectionVisibility(int section) const {
+    return m_sectionVisibility[section];
+}
+
+SectionVisibility Chunk::computeSectionVisibility(const ChunkMeshInput &input, int section) {
+    int yMin = 16 * section;
+    // Nothing but sky
+    if (yMin > input.maxHeight) {
+        return ALL_FACES_VISIBLE;
+    }
+
+    auto index = [yMin](int x, int y, int z) {
+        return x + 16 * (yMin + y) + 16 * 256 * z;
+    };
+    auto opaque = [](BlockType t) {
+        return t != EMPTY && !isTrans(t);
+    };
+
+    std::array<bool, 4096> visited;
+    visited.fill(false);
+    std::vector<glm::ivec3> stack;
+    SectionVisibility visibility = 0;
+
+    for (int start = 0; start < 4096; start++) {
+        glm::ivec3 s(start % 16, (start / 16) % 16, start / 256);
+        if (visited[start] || opaque(input.blocks[index(s.x, s.y, s.z)])) {
+            continue;
+        }
+
+        // The faces this pocket of open cells touches can all see each other
+        int faces = 0;
+        visited[start] = true;
+        stack.push_back(s);
+        while (!stack.empty()) {
+            glm::ivec3 p = stack.back();
+            stack.pop_back();
+            faces |= (p.x == 15) << XPOS | (p.x == 0) << XNEG
+                   | (p.y == 15) << YPOS | (p.y == 0) << YNEG
+                   | (p.z == 15) << ZPOS | (p.z == 0) << ZNEG;
+
+            for (const BlockNeighbor &n : neighbors) {
+                glm::ivec3 q = p + glm::ivec3(n.offset);
+                if (q.x < 0 || q.x > 15 || q.y < 0 || q.y > 15 || q.z < 0 || q.z > 15) {
+                    continue;
+                }
+                int i = q.x + 16 * q.y + 256 * q.z;
+                if (!visited[i] && !opaque(input.blocks[index(q.x, q.y, q.z)])) {
+                    visited[i] = true;
+                    stack.push_back(q);
+                }
+            }
+        }
+
+        for (int a = 0; a < 6; a++) {
+            for (int b = a + 1; b < 6; b++) {
+                if ((faces >> a & 1) && (faces >> b & 1)) {
+                    visibility |= 1 << facePairBit(a, b);
+                }
+            }
+        }
+        if (visibility == ALL_FACES_VISIBLE) {
+            break;
+        }
+    }
+    return visibility;
+}
+
+Chunk::~Chunk() {
+    if (mp_arena != nullptr) {
+        mp_arena->release(m_meshOpq);
+        mp_arena->release(m_meshTrans);
+    }
+}
 
 void Chunk::create() {
     loadVBO();
 }
 
-void Chunk::generateVBOData() {
+void Chunk::generateVBOData(const ChunkMeshInput &input) {
     chunkVBOData.chunk = this;
 
+    // Like getBlockAt(), but out of the copy
+    auto getBlockAt = [&input](int x, int y, int z) {
+        if (x < 0 || x >= 16 || y < 0 || y >= 256 || z < 0 || z >= 16) {
+            return EMPTY;
+        }
+        return input.blocks[x + 16 * y + 16 * 256 * z];
+    };
+
     // for opaque blocks
     std::vector<GLuint> idx_opq;
     std::vector<glm::vec4> interleave_opq;
@@ -90,13 +277,15 @@ void Chunk::generateVBOData() {
     int faces_opq = 0;
     int vertices_opq = 0;
 
-    // iterates over all 3 coords of chunks
+    // iterates over all 3 coords of chunks, skipping
+    // the empty sky above the tallest column
+    int maxHeight = input.maxHeight;
     for (int x = 0; x < 16; ++x) {
-        for (int y = 0; y < 256; ++y) {
+        for (int y = 0; y <= maxHeight; ++y) {
             for (int z = 0; z < 16; ++z) {
 
                 BlockType t = getBlockAt(x, y, z);
-                glm::vec4 block(x, y, z, 0);
+                glm::vec4 block(worldPos_x + x, y, worldPos_z + z, 0);
 
                 if (t != EMPTY) {
 
@@ -107,12 +296,12 @@ void Chunk::generateVBOData() {
                     BlockType z_pos = getBlockAt(x, y, z + 1);
                     BlockType z_neg = getBlockAt(x, y, z - 1);
 
-                    if (x == 0 && m_neighbors[XNEG]) {
-                        x_neg = m_neighbors[XNEG]->getBlockAt(15, y, z);
+                    if (x == 0) {
+                        x_neg = input.borders[ChunkMeshInput::borderIndex(XNEG, z, y)];
                     }
 
-                    if (x == 15 && m_neighbors[XPOS]) {
-                        x_pos = m_neighbors[XPOS]->getBlockAt((x + 1) % 16, y, z);
+                    if (x == 15) {
+                        x_pos = input.borders[ChunkMeshInput::borderIndex(XPOS, z, y)];
                     }
 
                     if (y == 0) {
@@ -123,12 +312,12 @@ void Chunk::generateVBOData() {
                         y_pos = EMPTY;
                     }
 
-                    if (z == 0 && m_neighbors[ZNEG]) {
-                        z_neg = m_neighbors[ZNEG]->getBlockAt(x, y, 15);
+                    if (z == 0) {
+                        z_neg = input.borders[ChunkMeshInput::borderIndex(ZNEG, x, y)];
                     }
 
-                    if (z == 15 && m_neighbors[ZPOS]) {
-                        z_pos = m_neighbors[ZPOS]->getBlockAt(x, y, 0);
+                    if (z == 15) {
+                        z_pos = input.borders[ChunkMeshInput::borderIndex(ZPOS, x, y)];
                     }
 
                     if (x_pos == EMPTY || (isTrans(x_pos) && x_pos != t)) {
@@ -208,6 +397,10 @@ void Chunk::generateVBOData() {
 
     chunkVBOData.m_vboDataTrans = interleave_trans;
     chunkVBOData.m_idxDataTrans = idx_trans;
+
+    for (int section = 0; section < SECTIONS; section++) {
+        chunkVBOData.m_sectionVisibility[section] = computeSectionVisibility(input, section);
+    }
 }
 
 void Chunk::updateVBO(std::vector<glm::vec4> &interleave,
@@ -229,31 +422,30 @@ void Chunk::updateVBO(std::vector<glm::vec4> &interleave,
 }
 
 // takes in a vector of interleaved vertex data and a vector of index data,
-// and buffers them into the appropriate VBOs of your Drawable
+// and buffers them into the arena in place of the previous mesh
 void Chunk::loadVBO() {
-    std::vector<glm::vec4> interleave_opq = chunkVBOData.m_vboDataOpaque;
-    std::vector<glm::vec4> interleave_trans = chunkVBOData.m_vboDataTrans;
-    std::vector<GLuint> idx_opq = chunkVBOData.m_idxDataOpaque;
-    std::vector<GLuint> idx_trans = chunkVBOData.m_idxDataTrans;
-
-    m_countOpq = idx_opq.size();
-    m_countTrans = idx_trans.size();
-
-    generateOpq();
-    bindOpq();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, interleave_opq.size() * sizeof(glm::vec4), interleave_opq.data(), GL_STATIC_DRAW);
-
-    generateIdxOpq();
-    bindIdxOpq();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_opq.size() * sizeof(GLuint), idx_opq.data(), GL_STATIC_DRAW);
+    mp_arena->release(m_meshOpq);
+    mp_arena->release(m_meshTrans);
+    m_meshOpq = mp_arena->upload(chunkVBOData.m_vboDataOpaque, chunkVBOData.m_idxDataOpaque);
+    m_meshTrans = mp_arena->upload(chunkVBOData.m_vboDataTrans, chunkVBOData.m_idxDataTrans);
+
+    m_countOpq = chunkVBOData.m_idxDataOpaque.size();
+    m_countTrans = chunkVBOData.m_idxDataTrans.size();
+    m_sectionVisibility = chunkVBOData.m_sectionVisibility;
+
+    // The arena has its own copy now
+    chunkVBOData.m_vboDataOpaque = std::vector<glm::vec4>();
+    chunkVBOData.m_idxDataOpaque = std::vector<GLuint>();
+    chunkVBOData.m_vboDataTrans = std::vector<glm::vec4>();
+    chunkVBOData.m_idxDataTrans = std::vector<GLuint>();
+}
 
-    generateTrans();
-    bindTrans();
-    mp_context->glBufferData(GL_ARRAY_BUFFER, interleave_trans.size() * sizeof(glm::vec4), interleave_trans.data(), GL_STATIC_DRAW);
+const ChunkArena::Allocation* Chunk::meshOpq() const {
+    return m_meshOpq;
+}
 
-    generateIdxTrans();
-    bindIdxTrans();
-    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_trans.size() * sizeof(GLuint), idx_trans.data(), GL_STATIC_DRAW);
+const ChunkArena::Allocation* Chunk::meshTrans() const {
+    return m_meshTrans;
 }
 
 
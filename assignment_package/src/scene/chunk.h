@@ -4,27 +4,17 @@
 #include <array>
 #include <unordered_map>
 #include <cstddef>
+#include <cstdint>
 #include "drawable.h"
+#include "blocktype.h"
+#include "chunkarena.h"
+#include "chunkstate.h"
 #include <iostream>
+#include <atomic>
 
 
 //using namespace std;
 
-// C++ 11 allows us to define the size of an enum. This lets us use only one byte
-// of memory to store our different block types. By default, the size of a C++ enum
-// is that of an int (so, usually four bytes). This *does* limit us to only 256 different
-// block types, but in the scope of this project we'll never get anywhere near that many.
-enum BlockType : unsigned char
-{
-    EMPTY, GRASS, DIRT, SNOW, STONE, LAVA, WATER, ICE, SAND, WOOD, LEAF
-};
-
-// The six cardinal directions in 3D space
-enum Direction : unsigned char
-{
-    XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
-};
-
 // Lets us use any enum class as the key of a
 // std::unordered_map
 struct EnumHash {
@@ -150,16 +140,55 @@ const static std::unordered_map<BlockType, std::unordered_map<Direction, glm::ve
                                                               {YPOS, glm::vec4(4.f/16.f, 12.f/16.f, 0, 0)},
                                                               {YNEG, glm::vec4(4.f/16.f, 12.f/16.f, 0, 0)},
                                                               {ZPOS, glm::vec4(4.f/16.f, 12.f/16.f, 0, 0)},
-                                                              {ZNEG, glm::vec4(4.f/16.f, 12.f/16.f, 0, 0)}}}
+                                                              {ZNEG, glm::vec4(4.f/16.f, 12.f/16.f, 0, 0)}}},
+
+    {COAL, std::unordered_map<Direction, glm::vec4, EnumHash>{{XPOS, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {XNEG, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {YPOS, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {YNEG, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {ZPOS, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {ZNEG, glm::vec4(2.f/16.f, 13.f/16.f, 0, 0)}}},
+
+    {IRON, std::unordered_map<Direction, glm::vec4, EnumHash>{{XPOS, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {XNEG, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {YPOS, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {YNEG, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {ZPOS, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)},
+                                                              {ZNEG, glm::vec4(1.f/16.f, 13.f/16.f, 0, 0)}}}
 
 };
 
 class Chunk;
 
+// Which pairs of a 16 x 16 x 16 section's six faces can see each other
+// through the cells of the section that are not opaque. One bit per pair,
+// see Chunk::canSee().
+typedef uint16_t SectionVisibility;
+// Every face can see every other one, as in a section with no blocks
+const static SectionVisibility ALL_FACES_VISIBLE = 0x7fff;
+
+// What a Chunk's mesh is built from: its blocks, and the blocks just
+// across each side. Copied out before meshing starts, so that blocks can
+// be edited while a worker builds the mesh.
+struct ChunkMeshInput {
+    // Laid out as in Chunk
+    std::array<BlockType, 65536> blocks;
+    // Taken from the neighbor on that side, or EMPTY if there was none.
+    // See borderIndex().
+    std::array<BlockType, 4 * 16 * 256> borders;
+    int maxHeight;
+
+    // Where the block at height y and position along (z for the x sides,
+    // x for the z sides) across the given side is in borders
+    static int borderIndex(Direction side, int along, int y);
+};
+
 struct ChunkVBOData {
     Chunk* chunk;
     std::vector<glm::vec4> m_vboDataOpaque, m_vboDataTrans;
     std::vector<GLuint> m_idxDataOpaque, m_idxDataTrans;
+    // Computed alongside the mesh, from the bottom section up
+    std::array<SectionVisibility, 16> m_sectionVisibility;
 };
 
 // One Chunk is a 16 x 256 x 16 section of the world,
@@ -179,30 +208,103 @@ private:
     // a key for this map.
     // These allow us to properly determine
     std::unordered_map<Direction, Chunk*, EnumHash> m_neighbors;
+    // A copy of m_neighbors taken on the main thread when this Chunk is
+    // queued for meshing, so that the VBO worker never reads m_neighbors
+    // while linkNeighbor() is writing to it. Only neighbors that already
+    // had block data at that time are kept.
+    std::unordered_map<Direction, Chunk*, EnumHash> m_meshNeighbors;
 
     int worldPos_x;
     int worldPos_z;
 
+    // Written by worker threads, read by the main thread
+    std::atomic<ChunkState> m_state;
+
+    // At least the height of the highest non-empty block, or -1 if
+    // there is none. Blocks above it are all empty, so meshing and
+    // culling stop there.
+    int m_maxHeight;
+
+    // Of the uploaded mesh, so only touched on the main thread. Every face
+    // sees every other until the first upload, so that a Chunk still being
+    // meshed never hides what is behind it.
+    std::array<SectionVisibility, 16> m_sectionVisibility;
+
+    // Where the uploaded opaque and transparent meshes are,
+    // or nullptr if there is nothing to draw
+    ChunkArena *mp_arena;
+    ChunkArena::Allocation *m_meshOpq, *m_meshTrans;
+
+    // Flood fills the cells of one section that are not opaque
+    static SectionVisibility computeSectionVisibility(const ChunkMeshInput &input, int section);
+
 public:
+    // Chunks are split into this many sections of 16 x 16 x 16 blocks
+    // when working out what can be seen through them
+    static const int SECTIONS = 16;
+
     ChunkVBOData chunkVBOData;
-    Chunk(OpenGLContext* context);
+    // Terrain surface height of each column, indexed x + 16 * z.
+    // Filled by the heightmap stage for the surface stage to build on.
+    std::array<int, 256> m_heightMap;
+    // Set when a neighbor's blocks (or our own) changed after this Chunk
+    // was queued for meshing. Only touched on the main thread.
+    bool m_needsRemesh;
+    // Set by the heightmap stage when the blocks were loaded from a
+    // ChunkStore, so that the later generation stages leave them alone
+    bool m_fromStore;
+
+    // Meshes are uploaded into arena, which must outlive the Chunk
+    Chunk(OpenGLContext* context, ChunkArena* arena);
 
     BlockType getBlockAt(unsigned int x, unsigned int y, unsigned int z) const;
     BlockType getBlockAt(int x, int y, int z) const;
 
     void setBlockAt(unsigned int x, unsigned int y, unsigned int z, BlockType t);
-    void linkNeighbor(uPtr<Chunk>& neighbor, Direction dir);
+    // All of the blocks, laid out as WorldGen::blockIndex() says. Writing
+    // through this skips m_maxHeight, so computeMaxHeight() after.
+    BlockType* blockData();
+    void linkNeighbor(Chunk* neighbor, Direction dir);
+    // Clears the links in both directions, e.g. before this Chunk is evicted
+    void unlinkNeighbors();
+    Chunk* getNeighbor(Direction dir) const;
+
+    ChunkState getState() const;
+    void setState(ChunkState state);
+    // True if every linked neighbor has finished filling in its blocks
+    bool neighborsHaveBlockData() const;
+    // Copies the linked neighbors into m_meshNeighbors. Call right before
+    // handing this Chunk to a VBO worker.
+    void snapshotNeighbors();
+    // Copies our blocks and the borders of the neighbors in the snapshot.
+    // The caller keeps setBlockAt() from running on any of them meanwhile.
+    void copyMeshInput(ChunkMeshInput &input) const;
+
+    // Recomputes m_maxHeight from scratch. setBlockAt() only ever raises
+    // it, since a bound that is too high is still correct, so this is
+    // needed to tighten it after blocks are carved away.
+    void computeMaxHeight();
+    int getMaxHeight() const;
+
+    SectionVisibility getSectionVisibility(int section) const;
+    // Whether looking in through face from, one can see out through face to
+    static bool canSee(SectionVisibility visibility, Direction from, Direction to);
 
     void setWorldPos(int x, int z);
     glm::ivec2 getWorldPos();
 
+    // Uploads chunkVBOData into the arena in place of the previous mesh.
+    // Vertex positions are in world space, so no model matrix is needed.
     void loadVBO();
+    const ChunkArena::Allocation* meshOpq() const;
+    const ChunkArena::Allocation* meshTrans() const;
     void updateVBO(std::vector<glm::vec4> &interleave,
                    Direction dir, glm::vec4 pos,
                    BlockType blockType, int faces);
 
     void virtual create() override;
-    void generateVBOData();
+    // Builds chunkVBOData from a copy made by copyMeshInput()
+    void generateVBOData(const ChunkMeshInput &input);
 
     GLenum drawMode() override;
 
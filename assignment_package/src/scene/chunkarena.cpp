@@ -0,0 +1,273 @@
+#include "chunkarena.h"
+#include <algorithm>
+
+ChunkArena::ChunkArena(OpenGLContext *context)
+    : mp_context(context), m_pages(), m_allocations(), m_defragmentations(0)
+{}
+
+ChunkArena::~ChunkArena()
+{}
+
+int ChunkArena::allocateRange(FreeList &list, int size) {
+    for (auto it = list.begin(); it != list.end(); ++it) {
+        if (it->second < size) {
+            continue;
+        }
+        int offset = it->first, left = it->second - size;
+        list.erase(it);
+        if (left > 0) {
+            list[offset + size] = left;
+        }
+        return offset;
+    }
+    return -1;
+}
+
+void ChunkArena::freeRange(FreeList &list, int offset, int size) {
+    auto next = list.lower_bound(offset);
+    // Merge with the range right after...
+    if (next != list.end() && next->first == offset + size) {
+        size += next->second;
+        next = list.erase(next);
+    }
+    // ...and the one right before
+    if (next != list.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    list[offset] = size;
+}
+
+int ChunkArena::largestRange(const FreeList &list) {
+    int largest = 0;
+    for (const auto &range : list) {
+        largest = std::max(largest, range.second);
+    }
+    return largest;
+}
+
+int ChunkArena::totalFree(const FreeList &list) {
+    int total = 0;
+    for (const auto &range : list) {
+        total += range.second;
+    }
+    return total;
+}
+
+void ChunkArena::setUpVertexArray(const Page &page) {
+    GLuint previous = mp_context->boundVertexArray();
+    mp_context->bindVertexArray(page.vao);
+    mp_context->bindBuffer(GL_ELEMENT_ARRAY_BUFFER, page.ibo);
+    mp_context->bindBuffer(GL_ARRAY_BUFFER, page.vbo);
+    mp_context->glEnableVertexAttribArray(ATTR_POS);
+    mp_context->glVertexAttribPointer(ATTR_POS, 4, GL_FLOAT, false, VERTEX_SIZE, (void*)0);
+    mp_context->glEnableVertexAttribArray(ATTR_NOR);
+    mp_context->glVertexAttribPointer(ATTR_NOR, 4, GL_FLOAT, false, VERTEX_SIZE, (void*)(sizeof(glm::vec4)));
+    mp_context->glEnableVertexAttribArray(ATTR_UV);
+    mp_context->glVertexAttribPointer(ATTR_UV, 4, GL_FLOAT, false, VERTEX_SIZE, (void*)(2 * sizeof(glm::vec4)));
+    mp_context->bindVertexArray(previous);
+}
+
+void ChunkArena::createPage(int vertexCapacity, int indexCapacity) {
+    Page page;
+    page.vertexCapacity = vertexCapacity;
+    page.indexCapacity = indexCapacity;
+    page.freeVertices[0] = vertexCapacity;
+    page.freeIndices[0] = indexCapacity;
+
+    mp_context->glGenBuffers(1, &page.vbo);
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, page.vbo);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(vertexCapacity) * VERTEX_SIZE,
+                             nullptr, GL_STATIC_DRAW);
+    mp_context->glGenBuffers(1, &page.ibo);
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, page.ibo);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(indexCapacity) * sizeof(GLuint),
+                             nullptr, GL_STATIC_DRAW);
+    mp_context->glGenVertexArrays(1, &page.vao);
+    setUpVertexArray(page);
+    m_pages.push_back(page);
+}
+
+bool ChunkArena::allocateIn(int page, Allocation &a) {
+    Page &p = m_pages[page];
+    int vertex = allocateRange(p.freeVertices, a.vertexCount);
+    if (vertex < 0) {
+        return false;
+    }
+    int index = allocateRange(p.freeIndices, a.indexCount);
+    if (index < 0) {
+        freeRange(p.freeVertices, vertex, a.vertexCount);
+        return false;
+    }
+    a.page = page;
+    a.firstVertex = vertex;
+    a.firstIndex = index;
+    return true;
+}
+
+ChunkArena::Allocation* ChunkArena::upload(const std::vector<glm::vec4> &interleaved,
+                                           const std::vector<GLuint> &indices) {
+    if (indices.empty()) {
+        return nullptr;
+    }
+
+    uPtr<Allocation> a = mkU<Allocation>();
+    a->vertexCount = static_cast<int>(interleaved.size() / 3);
+    a->indexCount = static_cast<int>(indices.size());
+
+    bool placed = false;
+    for (int i = 0; i < pageCount() && !placed; i++) {
+        placed = allocateIn(i, *a);
+    }
+    // Packing copies the whole page, so it is only worth it when that
+    // makes room for this mesh and plenty more after it
+    for (int i = 0; i < pageCount() && !placed; i++) {
+        const Page &p = m_pages[i];
+        int freeVertices = totalFree(p.freeVertices), freeIndices = totalFree(p.freeIndices);
+        if (freeVertices >= std::max(a->vertexCount, p.vertexCapacity / 4)
+                && freeIndices >= std::max(a->indexCount, p.indexCapacity / 4)) {
+            defragment(i);
+            placed = allocateIn(i, *a);
+        }
+    }
+    if (!placed) {
+        // A mesh bigger than a whole page gets a page of its own size
+        createPage(std::max(PAGE_VERTICES, a->vertexCount), std::max(PAGE_INDICES, a->indexCount));
+        placed = allocateIn(pageCount() - 1, *a);
+    }
+
+    // Through the copy target, so whichever VAO is bound keeps its buffers
+    const Page &p = m_pages[a->page];
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, p.vbo);
+    mp_context->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(a->firstVertex) * VERTEX_SIZE,
+                                static_cast<GLsizeiptr>(a->vertexCount) * VERTEX_SIZE, interleaved.data());
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, p.ibo);
+    mp_context->glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(a->firstIndex) * sizeof(GLuint),
+                                static_cast<GLsizeiptr>(a->indexCount) * sizeof(GLuint), indices.data());
+
+    Allocation *result = a.get();
+    m_allocations[result] = std::move(a);
+    return result;
+}
+
+void ChunkArena::release(Allocation *a) {
+    // Everything is already gone if the arena was destroyed
+    auto found = m_allocations.find(a);
+    if (found == m_allocations.end()) {
+        return;
+    }
+    Page &p = m_pages[a->page];
+    freeRange(p.freeVertices, a->firstVertex, a->vertexCount);
+    freeRange(p.freeIndices, a->firstIndex, a->indexCount);
+    m_allocations.erase(found);
+}
+
+void ChunkArena::defragment(int page) {
+    std::vector<Allocation*> live;
+    for (const auto &entry : m_allocations) {
+        if (entry.first->page == page) {
+            live.push_back(entry.first);
+        }
+    }
+    // In the order they sit in the vertex buffer
+    std::sort(live.begin(), live.end(), [](const Allocation *a, const Allocation *b) {
+        return a->firstVertex < b->firstVertex;
+    });
+
+    // Copy everything into fresh buffers, packed together. Indices
+    // are relative to their mesh's first vertex, so they copy as is.
+    Page &p = m_pages[page];
+    GLuint vbo, ibo;
+    mp_context->glGenBuffers(1, &vbo);
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, vbo);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(p.vertexCapacity) * VERTEX_SIZE,
+                             nullptr, GL_STATIC_DRAW);
+    mp_context->bindBuffer(GL_COPY_READ_BUFFER, p.vbo);
+    int vertex = 0;
+    for (Allocation *a : live) {
+        mp_context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                        static_cast<GLintptr>(a->firstVertex) * VERTEX_SIZE,
+                                        static_cast<GLintptr>(vertex) * VERTEX_SIZE,
+                                        static_cast<GLsizeiptr>(a->vertexCount) * VERTEX_SIZE);
+        a->firstVertex = vertex;
+        vertex += a->vertexCount;
+    }
+
+    std::sort(live.begin(), live.end(), [](const Allocation *a, const Allocation *b) {
+        return a->firstIndex < b->firstIndex;
+    });
+    mp_context->glGenBuffers(1, &ibo);
+    mp_context->bindBuffer(GL_COPY_WRITE_BUFFER, ibo);
+    mp_context->glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(p.indexCapacity) * sizeof(GLuint),
+                             nullptr, GL_STATIC_DRAW);
+    mp_context->bindBuffer(GL_COPY_READ_BUFFER, p.ibo);
+    int index = 0;
+    for (Allocation *a : live) {
+        mp_context->glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER,
+                                        static_cast<GLintptr>(a->firstIndex) * sizeof(GLuint),
+                                        static_cast<GLintptr>(index) * sizeof(GLuint),
+                                        static_cast<GLsizeiptr>(a->indexCount) * sizeof(GLuint));
+        a->firstIndex = index;
+        index += a->indexCount;
+    }
+
+    mp_context->deleteBuffers(1, &p.vbo);
+    mp_context->deleteBuffers(1, &p.ibo);
+    p.vbo = vbo;
+    p.ibo = ibo;
+    setUpVertexArray(p);
+    p.freeVertices.clear();
+    p.freeIndices.clear();
+    if (vertex < p.vertexCapacity) {
+        p.freeVertices[vertex] = p.vertexCapacity - vertex;
+    }
+    if (index < p.indexCapacity) {
+        p.freeIndices[index] = p.indexCapacity - index;
+    }
+    m_defragmentations++;
+}
+
+void ChunkArena::defragment() {
+    for (int i = 0; i < pageCount(); i++) {
+        const Page &p = m_pages[i];
+        // Nothing to gain if the free space is already in one piece
+        if (largestRange(p.freeVertices) < totalFree(p.freeVertices)
+                || largestRange(p.freeIndices) < totalFree(p.freeIndices)) {
+            defragment(i);
+        }
+    }
+}
+
+void ChunkArena::destroy() {
+    for (Page &p : m_pages) {
+        mp_context->deleteBuffers(1, &p.vbo);
+        mp_context->deleteBuffers(1, &p.ibo);
+        mp_context->deleteVertexArrays(1, &p.vao);
+    }
+    m_pages.clear();
+    m_allocations.clear();
+}
+
+int ChunkArena::pageCount() const {
+    return static_cast<int>(m_pages.size());
+}
+
+void ChunkArena::bindPage(int page) {
+    mp_context->bindVertexArray(m_pages[page].vao);
+}
+
+ChunkArena::Stats ChunkArena::stats() const {
+    Stats s = {pageCount(), static_cast<int>(m_allocations.size()), 0, 0, m_defragmentations};
+    for (const auto &entry : m_allocations) {
+        s.usedBytes += static_cast<size_t>(entry.first->vertexCount) * VERTEX_SIZE
+                + static_cast<size_t>(entry.first->indexCount) * sizeof(GLuint);
+    }
+    for (const Page &p : m_pages) {
+        s.capacityBytes += static_cast<size_t>(p.vertexCapacity) * VERTEX_SIZE
+                + static_cast<size_t>(p.indexCapacity) * sizeof(GLuint);
+    }
+    return s;
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "openglcontext.h"
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Holds the meshes of every Chunk in a few large pages, each one a vertex
+// buffer and an index buffer, instead of four small buffers per Chunk. All
+// the meshes in a page share its vertex layout, so any number of them can
+// be drawn with one glMultiDrawElementsBaseVertex call. Each page also has
+// its own VAO with that layout set up once, at the attribute locations
+// ShaderProgram binds every shader's vs_Pos, vs_Nor and vs_UV to, so
+// drawing from a page is a VAO bind and a draw.
+//
+// Each mesh takes one range of a page's vertices and one of its indices.
+// The indices count from the start of the mesh's own vertices, and the
+// draw adds where those start as the base vertex. Freed ranges go back on
+// the page's free lists and are merged with any free neighbors. When no page
+// has room for a mesh, but one that is at least a quarter free would after
+// packing its meshes together, that page is defragmented before a new one
+// is made.
+//
+// Only used on the thread that owns the GL context.
+class ChunkArena {
+public:
+    // Vertices are a position, a normal and a UV, a vec4 each
+    static const int VERTEX_SIZE = 3 * sizeof(glm::vec4);
+    // 48 MB of vertices, room for a few dozen Chunks, and
+    // the 6 indices for every 4 of them
+    static const int PAGE_VERTICES = 1 << 20;
+    static const int PAGE_INDICES = PAGE_VERTICES / 4 * 6;
+    // Where a page's VAO feeds each part of a vertex
+    static const GLuint ATTR_POS = 0, ATTR_NOR = 1, ATTR_UV = 2;
+
+    // Where one mesh lives. Stays valid, though not necessarily in the
+    // same place, until the mesh is released.
+    struct Allocation {
+        int page;
+        int firstVertex, vertexCount;
+        int firstIndex, indexCount;
+    };
+
+    struct Stats {
+        int pages;
+        int meshes;
+        // Bytes taken up by meshes, and by the pages holding them
+        size_t usedBytes, capacityBytes;
+        int defragmentations;
+    };
+
+    ChunkArena(OpenGLContext *context);
+    ~ChunkArena();
+
+    ChunkArena(const ChunkArena&) = delete;
+    ChunkArena& operator=(const ChunkArena&) = delete;
+
+    // Copies a mesh in. interleaved holds 3 vec4s per vertex. Returns
+    // nullptr for a mesh with no indices, which has nothing to draw.
+    Allocation* upload(const std::vector<glm::vec4> &interleaved, const std::vector<GLuint> &indices);
+    // Gives the mesh's ranges back. Doesn't touch GL, so it is safe to
+    // call from a Chunk's destructor. Ignores nullptr, and meshes the
+    // arena was destroyed under.
+    void release(Allocation*);
+
+    // Packs the meshes of every page to its start
+    void defragment();
+    // Frees every page. Every Allocation is invalid afterwards.
+    void destroy();
+
+    int pageCount() const;
+    // Binds the page's VAO. Whoever calls this has to bind another VAO
+    // before setting up any attributes of their own.
+    void bindPage(int page);
+    Stats stats() const;
+
+private:
+    // Offset to size, for ranges of vertices or of indices
+    typedef std::map<int, int> FreeList;
+
+    struct Page {
+        GLuint vbo, ibo, vao;
+        int vertexCapacity, indexCapacity;
+        FreeList freeVertices, freeIndices;
+    };
+
+    // First fit. Returns the offset, or -1 if nothing is big enough.
+    static int allocateRange(FreeList &list, int size);
+    static void freeRange(FreeList &list, int offset, int size);
+    static int largestRange(const FreeList &list);
+    static int totalFree(const FreeList &list);
+
+    void createPage(int vertexCapacity, int indexCapacity);
+    // Points the page's VAO at its current buffers
+    void setUpVertexArray(const Page &page);
+    // Moves every mesh in the page to the front of its buffers
+    void defragment(int page);
+    // Tries to take both ranges from the page
+    bool allocateIn(int page, Allocation &a);
+
+    OpenGLContext *mp_context;
+    std::vector<Page> m_pages;
+    // Every live Allocation, keyed by the pointer handed out for it
+    std::unordered_map<Allocation*, uPtr<Allocation>> m_allocations;
+    int m_defragmentations;
+};
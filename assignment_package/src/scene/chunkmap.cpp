@@ -0,0 +1,75 @@
+#include "chunkmap.h"
+
+ChunkMap::ChunkMap(EpochManager &epochs, std::function<void(Chunk*)> deleter)
+    : m_epochs(epochs), m_deleter(deleter), m_table(new Table()), m_writeMutex()
+{}
+
+ChunkMap::~ChunkMap() {
+    const Table *table = m_table.load();
+    for (auto & [ key, chunk ] : *table) {
+        m_deleter(chunk);
+    }
+    delete table;
+}
+
+Chunk* ChunkMap::find(int64_t key) const {
+    const Table &table = snapshot();
+    auto it = table.find(key);
+    return it == table.end() ? nullptr : it->second;
+}
+
+const ChunkMap::Table& ChunkMap::snapshot() const {
+    return *m_table.load();
+}
+
+size_t ChunkMap::size() const {
+    EpochManager::Guard guard(m_epochs);
+    return snapshot().size();
+}
+
+void ChunkMap::insert(std::vector<std::pair<int64_t, uPtr<Chunk>>> &chunks) {
+    if (chunks.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Table *table = new Table(*m_table.load());
+    for (auto & [ key, chunk ] : chunks) {
+        if (table->find(key) == table->end()) {
+            (*table)[key] = chunk.release();
+        }
+    }
+    publish(table);
+}
+
+void ChunkMap::erase(const std::vector<int64_t> &keys) {
+    if (keys.empty()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+    Table *table = new Table(*m_table.load());
+    std::vector<Chunk*> erased;
+    for (int64_t key : keys) {
+        auto it = table->find(key);
+        if (it != table->end()) {
+            erased.push_back(it->second);
+            table->erase(it);
+        }
+    }
+    publish(table);
+
+    // The Chunks were unlinked by publish(), so readers that pin from
+    // now on can't find them
+    std::function<void(Chunk*)> deleter = m_deleter;
+    m_epochs.retire([erased, deleter]() {
+        for (Chunk *chunk : erased) {
+            deleter(chunk);
+        }
+    });
+}
+
+void ChunkMap::publish(Table *table) {
+    const Table *old = m_table.exchange(table);
+    m_epochs.retire([old]() { delete old; });
+}
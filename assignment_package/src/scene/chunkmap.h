@@ -0,0 +1,57 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include "epochmanager.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+class Chunk;
+
+// Index of every Chunk in the world, keyed by toKey(x, z) of its corner.
+// Reads never lock: the whole index is an immutable table that writers
+// copy, modify and publish with a single atomic store. Replaced tables
+// and erased Chunks are handed to an EpochManager, so anything a reader
+// looked up stays valid for as long as it holds an EpochManager::Guard.
+//
+// Any number of threads may call find() or snapshot() concurrently with
+// one another and with writers. Writers are serialized internally.
+class ChunkMap {
+public:
+    typedef std::unordered_map<int64_t, Chunk*> Table;
+
+    // deleter is run on erased Chunks once no reader can still hold them.
+    // It runs on whichever thread calls EpochManager::collect().
+    ChunkMap(EpochManager &epochs, std::function<void(Chunk*)> deleter);
+    ~ChunkMap();
+
+    ChunkMap(const ChunkMap&) = delete;
+    ChunkMap& operator=(const ChunkMap&) = delete;
+
+    // Must be called while holding a Guard on this map's EpochManager.
+    // Returns nullptr if there is no Chunk with this key.
+    Chunk* find(int64_t key) const;
+    // The current table. Must be called while holding a Guard, and the
+    // table may only be used until that Guard is released.
+    const Table& snapshot() const;
+
+    size_t size() const;
+
+    // Takes ownership of every Chunk and publishes them all at once.
+    // Keys that already exist are left untouched and their Chunk is discarded.
+    void insert(std::vector<std::pair<int64_t, uPtr<Chunk>>> &chunks);
+    // Unpublishes the Chunks with these keys and retires them
+    void erase(const std::vector<int64_t> &keys);
+
+private:
+    // Swaps in the new table and retires the old one. Caller holds m_writeMutex.
+    void publish(Table *table);
+
+    EpochManager &m_epochs;
+    std::function<void(Chunk*)> m_deleter;
+    std::atomic<const Table*> m_table;
+    std::mutex m_writeMutex;
+};
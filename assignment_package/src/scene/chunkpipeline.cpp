@@ -0,0 +1,142 @@
+#include "chunkpipeline.h"
+
+ChunkPipeline::ChunkPipeline()
+    : m_stages(), m_stopping(false)
+{}
+
+ChunkPipeline::~ChunkPipeline() {
+    m_stopping = true;
+    for (uPtr<Stage> &stage : m_stages) {
+        // Taking the lock makes sure no worker is between
+        // checking m_stopping and going to sleep
+        std::lock_guard<std::mutex> lock(stage->mutex);
+        stage->ready.notify_all();
+    }
+    for (uPtr<Stage> &stage : m_stages) {
+        for (std::thread &thread : stage->threads) {
+            thread.join();
+        }
+    }
+}
+
+void ChunkPipeline::addStage(std::string name, int workers, Work work) {
+    uPtr<Stage> stage = mkU<Stage>();
+    stage->name = name;
+    stage->work = work;
+    stage->workers = workers;
+    stage->completed = 0;
+    stage->totalLatency = 0;
+    stage->totalRun = 0;
+    stage->sampledCompleted = 0;
+    stage->sampledLatency = 0;
+    stage->sampledRun = 0;
+    stage->sampledAt = Clock::now();
+    stage->next = nullptr;
+
+    for (int i = 0; i < workers; i++) {
+        stage->threads.push_back(std::thread(&ChunkPipeline::runWorker, this, stage.get()));
+    }
+    if (!m_stages.empty()) {
+        m_stages.back()->next = stage.get();
+    }
+    m_stages.push_back(std::move(stage));
+}
+
+void ChunkPipeline::submit(Chunk *chunk) {
+    enqueue(*m_stages.front(), chunk);
+}
+
+void ChunkPipeline::enqueue(Stage &s, Chunk *chunk) {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    s.queue.push_back({chunk, Clock::now()});
+    s.ready.notify_one();
+}
+
+void ChunkPipeline::pump() {
+    for (uPtr<Stage> &stage : m_stages) {
+        Stage &s = *stage;
+        if (s.workers > 0) {
+            continue;
+        }
+
+        // Only take what is queued now, in case running a job feeds this
+        // pipeline again
+        std::deque<Job> jobs;
+        {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            jobs.swap(s.queue);
+        }
+        for (const Job &job : jobs) {
+            runJob(s, job);
+        }
+    }
+}
+
+void ChunkPipeline::runWorker(Stage *stage) {
+    Stage &s = *stage;
+    while (true) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(s.mutex);
+            s.ready.wait(lock, [&]() { return m_stopping || !s.queue.empty(); });
+            if (m_stopping) {
+                return;
+            }
+            job = s.queue.front();
+            s.queue.pop_front();
+        }
+        runJob(s, job);
+    }
+}
+
+void ChunkPipeline::runJob(Stage &s, Job job) {
+    Clock::time_point start = Clock::now();
+    s.work(job.chunk);
+    Clock::time_point end = Clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(s.mutex);
+        s.completed++;
+        s.totalLatency += std::chrono::duration<double, std::milli>(end - job.enqueued).count();
+        s.totalRun += std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    if (Stage *next = s.next) {
+        enqueue(*next, job.chunk);
+    }
+}
+
+std::vector<ChunkPipeline::StageMetrics> ChunkPipeline::metrics() {
+    std::vector<StageMetrics> result;
+    Clock::time_point now = Clock::now();
+
+    for (uPtr<Stage> &stage : m_stages) {
+        std::lock_guard<std::mutex> lock(stage->mutex);
+
+        int completed = stage->completed - stage->sampledCompleted;
+        float seconds = std::chrono::duration<float>(now - stage->sampledAt).count();
+
+        StageMetrics m;
+        m.name = stage->name;
+        m.backlog = static_cast<int>(stage->queue.size());
+        m.throughput = seconds > 0 ? completed / seconds : 0;
+        m.latencyMs = completed > 0 ? (stage->totalLatency - stage->sampledLatency) / completed : 0;
+        m.runMs = completed > 0 ? (stage->totalRun - stage->sampledRun) / completed : 0;
+        result.push_back(m);
+
+        stage->sampledCompleted = stage->completed;
+        stage->sampledLatency = stage->totalLatency;
+        stage->sampledRun = stage->totalRun;
+        stage->sampledAt = now;
+    }
+    return result;
+}
+
+int ChunkPipeline::backlog() {
+    int total = 0;
+    for (uPtr<Stage> &stage : m_stages) {
+        std::lock_guard<std::mutex> lock(stage->mutex);
+        total += static_cast<int>(stage->queue.size());
+    }
+    return total;
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "smartpointerhelp.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class Chunk;
+
+// A fixed sequence of named stages that every submitted Chunk passes
+// through in order. Each stage has its own queue and its own workers, so
+// a slow stage backs up in front of itself instead of stalling the rest,
+// and its metrics show exactly where.
+//
+// A stage with no workers is run by whichever thread calls pump(), which
+// is how work that needs the GL context stays on the main thread.
+class ChunkPipeline {
+public:
+    typedef std::function<void(Chunk*)> Work;
+
+    struct StageMetrics {
+        std::string name;
+        // Chunks waiting in this stage's queue
+        int backlog;
+        // Chunks finished per second since the previous call to metrics()
+        float throughput;
+        // Average time from entering the queue to finishing,
+        // and the part of that spent running, in milliseconds
+        float latencyMs;
+        float runMs;
+    };
+
+    ChunkPipeline();
+    // Stops the workers. Chunks still queued are dropped.
+    ~ChunkPipeline();
+
+    ChunkPipeline(const ChunkPipeline&) = delete;
+    ChunkPipeline& operator=(const ChunkPipeline&) = delete;
+
+    // Appends a stage. Must be called before the first submit().
+    void addStage(std::string name, int workers, Work work);
+
+    // Queues the Chunk at the first stage
+    void submit(Chunk*);
+
+    // Runs everything queued at stages that have no workers
+    void pump();
+
+    std::vector<StageMetrics> metrics();
+    // Chunks waiting in every stage's queue. Unlike metrics(),
+    // doesn't reset anything, so it can be polled every frame.
+    int backlog();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Job {
+        Chunk *chunk;
+        Clock::time_point enqueued;
+    };
+
+    struct Stage {
+        std::string name;
+        Work work;
+        int workers;
+
+        std::deque<Job> queue;
+        std::mutex mutex;
+        std::condition_variable ready;
+
+        // Guarded by mutex
+        int completed;
+        double totalLatency, totalRun;
+        // What metrics() saw last time, to report rates since then
+        int sampledCompleted;
+        double sampledLatency, sampledRun;
+        Clock::time_point sampledAt;
+
+        std::vector<std::thread> threads;
+        // The stage after this one, or null for the last. Set by the
+        // addStage() call that appends it, possibly while this stage's
+        // workers are already running.
+        std::atomic<Stage*> next;
+    };
+
+    // Workers only ever reach stages through these pointers, never
+    // through m_stages, which addStage() may still be growing
+    void enqueue(Stage &stage, Chunk*);
+    void runWorker(Stage *stage);
+    void runJob(Stage &stage, Job job);
+
+    std::vector<uPtr<Stage>> m_stages;
+    std::atomic<bool> m_stopping;
+};
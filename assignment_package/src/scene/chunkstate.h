@@ -0,0 +1,42 @@
+#pragma once
+#include <initializer_list>
+
+// The six cardinal directions in 3D space
+enum Direction : unsigned char
+{
+    XPOS, XNEG, YPOS, YNEG, ZPOS, ZNEG
+};
+
+// The stages a Chunk moves through between being instantiated and being drawn.
+// NEW chunks are still having their blocks filled in by a worker thread.
+// A Chunk may only be meshed once every neighbor it is linked to has reached
+// BLOCKS_READY, since meshing reads the blocks along each neighbor's border.
+enum ChunkState : unsigned char
+{
+    NEW, BLOCKS_READY, MESH_QUEUED, MESHED, UPLOADED
+};
+
+// Whether a Chunk can be evicted and freed yet. It can't while anything is
+// left to do to it, nor while a neighbor is being meshed: a mesh job takes
+// its snapshot of neighbor pointers when it is queued, but only reads their
+// borders once a worker gets to it, and nothing pins them in between.
+//
+// Kept apart from Chunk, which needs OpenGL, so that the streaming stress
+// test can check the same rule against its own stand-in. ChunkT has
+// getState(), getNeighbor() and m_needsRemesh like Chunk. The caller holds
+// whatever serializes queueing meshes (Terrain::m_streamingMutex), so no
+// neighbor can become queued while this looks.
+template <typename ChunkT>
+bool canEvict(const ChunkT &chunk) {
+    if (chunk.getState() != UPLOADED || chunk.m_needsRemesh) {
+        return false;
+    }
+    for (Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+        const ChunkT *neighbor = chunk.getNeighbor(dir);
+        if (neighbor != nullptr && (neighbor->getState() == MESH_QUEUED
+                                    || neighbor->getState() == MESHED)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,251 @@
+#include "chunkstore.h"
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <vector>
+
+// Bumped whenever the layout of world.txt, a region file or a record changes
+static const int STORE_VERSION = 2;
+static const char REGION_MAGIC[4] = {'M', 'M', 'R', 'G'};
+// The magic, the version and then the table
+static const int REGION_HEADER = 8 + 2 * ChunkStore::REGION_CHUNKS * ChunkStore::REGION_CHUNKS * 4;
+
+// Everything in a region file is little-endian,
+// whatever the machine that wrote it
+static void putU32(std::vector<unsigned char> &out, uint32_t v) {
+    for (int i = 0; i < 4; i++) {
+        out.push_back(static_cast<unsigned char>(v >> (8 * i)));
+    }
+}
+
+static uint32_t getU32(const unsigned char *in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<uint32_t>(in[3]) << 24);
+}
+
+// FNV-1a, to tell a record that was cut short from a whole one
+static uint32_t checksum(const unsigned char *data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ data[i]) * 16777619u;
+    }
+    return h;
+}
+
+ChunkStore::ChunkStore(const std::string &dir)
+    : m_dir(dir), m_open(false), m_writable(false), m_mutex(), m_regions()
+{}
+
+bool ChunkStore::open(unsigned int seed, GenerationMode mode, OpenMode openMode) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_writable = openMode != READ_ONLY;
+
+    std::ostringstream expected;
+    expected << "version " << STORE_VERSION << "\n"
+             << "seed " << seed << "\n"
+             << "mode " << static_cast<int>(mode) << "\n"
+             << "generator " << WorldGen::GENERATOR_VERSION << "\n";
+
+    std::string path = m_dir + "/world.txt";
+    std::ifstream in(path);
+    if (in) {
+        std::ostringstream found;
+        found << in.rdbuf();
+        m_open = found.str() == expected.str();
+        return m_open;
+    }
+    if (openMode != CREATE) {
+        return false;
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(m_dir, error);
+    std::ofstream out(path);
+    out << expected.str();
+    m_open = static_cast<bool>(out.flush());
+    return m_open;
+}
+
+bool ChunkStore::isOpen() const {
+    return m_open;
+}
+
+glm::ivec2 ChunkStore::regionOf(glm::ivec2 chunkPos) {
+    int size = 16 * REGION_CHUNKS;
+    return glm::ivec2(static_cast<int>(glm::floor(chunkPos.x / static_cast<float>(size))),
+                      static_cast<int>(glm::floor(chunkPos.y / static_cast<float>(size))));
+}
+
+int ChunkStore::indexInRegion(glm::ivec2 chunkPos) {
+    glm::ivec2 local = chunkPos / 16 - regionOf(chunkPos) * REGION_CHUNKS;
+    return local.x + REGION_CHUNKS * local.y;
+}
+
+std::string ChunkStore::regionPath(glm::ivec2 region) const {
+    return m_dir + "/r." + std::to_string(region.x) + "." + std::to_string(region.y) + ".bin";
+}
+
+ChunkStore::Region* ChunkStore::regionAt(glm::ivec2 region, bool create) {
+    int64_t key = (static_cast<int64_t>(region.x) << 32) | static_cast<uint32_t>(region.y);
+    auto found = m_regions.find(key);
+    if (found != m_regions.end() && (found->second != nullptr || !create)) {
+        return found->second.get();
+    }
+
+    uPtr<Region> r = mkU<Region>();
+    r->table.fill(0);
+    std::string path = regionPath(region);
+    std::vector<unsigned char> header(REGION_HEADER);
+
+    std::ios::openmode access = m_writable ? std::ios::in | std::ios::out : std::ios::in;
+    r->file.open(path, access | std::ios::binary);
+    if (r->file.is_open()) {
+        r->file.read(reinterpret_cast<char*>(header.data()), REGION_HEADER);
+        bool valid = r->file.gcount() == REGION_HEADER
+                && std::equal(REGION_MAGIC, REGION_MAGIC + 4, header.begin())
+                && getU32(&header[4]) == static_cast<uint32_t>(STORE_VERSION);
+        if (!valid) {
+            // Don't guess at what is in it
+            m_regions[key] = nullptr;
+            return nullptr;
+        }
+        for (size_t i = 0; i < r->table.size(); i++) {
+            r->table[i] = getU32(&header[8 + 4 * i]);
+        }
+        r->file.clear();
+    } else if (create && m_writable) {
+        r->file.open(path, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!r->file.is_open()) {
+            return nullptr;
+        }
+        header.clear();
+        header.insert(header.end(), REGION_MAGIC, REGION_MAGIC + 4);
+        putU32(header, STORE_VERSION);
+        header.resize(REGION_HEADER, 0);
+        r->file.write(reinterpret_cast<const char*>(header.data()), REGION_HEADER);
+        r->file.flush();
+    } else {
+        m_regions[key] = nullptr;
+        return nullptr;
+    }
+
+    Region *result = r.get();
+    m_regions[key] = std::move(r);
+    return result;
+}
+
+void ChunkStore::closeRegions() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_regions.clear();
+}
+
+bool ChunkStore::has(glm::ivec2 chunkPos) {
+    if (!m_open) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Region *region = regionAt(regionOf(chunkPos), false);
+    return region != nullptr && region->table[2 * indexInRegion(chunkPos) + 1] != 0;
+}
+
+bool ChunkStore::save(glm::ivec2 chunkPos, const int *heights, const BlockType *blocks) {
+    if (!m_open || !m_writable) {
+        return false;
+    }
+
+    // The height map, then the blocks as runs of (length, type)
+    std::vector<unsigned char> payload;
+    payload.reserve(4096);
+    for (int i = 0; i < 256; i++) {
+        payload.push_back(static_cast<unsigned char>(heights[i]));
+        payload.push_back(static_cast<unsigned char>(heights[i] >> 8));
+    }
+    for (int i = 0; i < WorldGen::BLOCKS;) {
+        int run = 1;
+        while (i + run < WorldGen::BLOCKS && run < 255 && blocks[i + run] == blocks[i]) {
+            run++;
+        }
+        payload.push_back(static_cast<unsigned char>(run));
+        payload.push_back(blocks[i]);
+        i += run;
+    }
+
+    std::vector<unsigned char> record;
+    putU32(record, static_cast<uint32_t>(payload.size()));
+    putU32(record, checksum(payload.data(), payload.size()));
+    record.insert(record.end(), payload.begin(), payload.end());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Region *region = regionAt(regionOf(chunkPos), true);
+    if (region == nullptr) {
+        return false;
+    }
+
+    region->file.seekp(0, std::ios::end);
+    uint32_t offset = static_cast<uint32_t>(region->file.tellp());
+    region->file.write(reinterpret_cast<const char*>(record.data()), record.size());
+    region->file.flush();
+
+    int index = indexInRegion(chunkPos);
+    std::vector<unsigned char> entry;
+    putU32(entry, offset);
+    putU32(entry, static_cast<uint32_t>(record.size()));
+    region->file.seekp(8 + 8 * index);
+    region->file.write(reinterpret_cast<const char*>(entry.data()), entry.size());
+    region->file.flush();
+
+    if (!region->file) {
+        region->file.clear();
+        return false;
+    }
+    region->table[2 * index] = offset;
+    region->table[2 * index + 1] = static_cast<uint32_t>(record.size());
+    return true;
+}
+
+bool ChunkStore::load(glm::ivec2 chunkPos, int *heights, BlockType *blocks) {
+    if (!m_open) {
+        return false;
+    }
+
+    std::vector<unsigned char> record;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        Region *region = regionAt(regionOf(chunkPos), false);
+        if (region == nullptr) {
+            return false;
+        }
+        int index = indexInRegion(chunkPos);
+        uint32_t offset = region->table[2 * index], size = region->table[2 * index + 1];
+        if (size < 8) {
+            return false;
+        }
+        record.resize(size);
+        region->file.seekg(offset);
+        region->file.read(reinterpret_cast<char*>(record.data()), size);
+        if (static_cast<uint32_t>(region->file.gcount()) != size) {
+            region->file.clear();
+            return false;
+        }
+    }
+
+    const unsigned char *payload = record.data() + 8;
+    size_t payloadSize = getU32(record.data());
+    if (payloadSize != record.size() - 8 || payloadSize < 512
+            || checksum(payload, payloadSize) != getU32(record.data() + 4)) {
+        return false;
+    }
+
+    for (int i = 0; i < 256; i++) {
+        heights[i] = static_cast<int16_t>(payload[2 * i] | (payload[2 * i + 1] << 8));
+    }
+    int filled = 0;
+    for (size_t i = 512; i + 1 < payloadSize; i += 2) {
+        int run = payload[i];
+        if (filled + run > WorldGen::BLOCKS) {
+            return false;
+        }
+        std::fill_n(blocks + filled, run, static_cast<BlockType>(payload[i + 1]));
+        filled += run;
+    }
+    return filled == WorldGen::BLOCKS;
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "glm_includes.h"
+#include "smartpointerhelp.h"
+#include "worldgen.h"
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Finished Chunks saved on disk, so that a world can be generated ahead of
+// time and loaded instead of generated again.
+//
+// A store is a directory holding world.txt, which records the seed and mode
+// the world was generated with and WorldGen::GENERATOR_VERSION, and one
+// region file per REGION_CHUNKS x
+// REGION_CHUNKS area of Chunks. Each region file starts with a table of
+// where each of its Chunks is, followed by the Chunks themselves in the
+// order they were saved. A Chunk is appended first and only then entered
+// in the table, so a Chunk whose save was interrupted simply reads as
+// missing.
+//
+// Different processes may write to one store as long as no two of them
+// write to the same region. Safe to use from any number of threads at once.
+class ChunkStore {
+public:
+    static const int REGION_CHUNKS = 32;
+
+    enum OpenMode {
+        // Loads only. Region files are never opened for writing.
+        READ_ONLY,
+        // Loads and saves, in a store that already holds the world
+        READ_WRITE,
+        // READ_WRITE, but first makes an empty store hold the world
+        CREATE
+    };
+
+    ChunkStore(const std::string &dir);
+
+    ChunkStore(const ChunkStore&) = delete;
+    ChunkStore& operator=(const ChunkStore&) = delete;
+
+    // Checks that the store holds the world generated from this seed and
+    // mode, by this version of WorldGen. A store baked by another version
+    // is refused, since its Chunks wouldn't match the ones generated around
+    // them. Nothing else works until this has succeeded.
+    bool open(unsigned int seed, GenerationMode mode, OpenMode openMode);
+    bool isOpen() const;
+
+    // Whether the Chunk with its corner at chunkPos has been saved
+    bool has(glm::ivec2 chunkPos);
+    // Reads the Chunk's height map and blocks, laid out as WorldGen's.
+    // False if it has not been saved or did not read back intact.
+    bool load(glm::ivec2 chunkPos, int *heights, BlockType *blocks);
+    // Always false in a store opened READ_ONLY
+    bool save(glm::ivec2 chunkPos, const int *heights, const BlockType *blocks);
+
+    // The region the Chunk with its corner at chunkPos belongs to
+    static glm::ivec2 regionOf(glm::ivec2 chunkPos);
+    // Closes the files of every region used so far
+    void closeRegions();
+
+private:
+    struct Region {
+        std::fstream file;
+        // The offset and size of each Chunk's record, 0 if it has none
+        std::array<uint32_t, 2 * REGION_CHUNKS * REGION_CHUNKS> table;
+    };
+
+    // nullptr if the region's file doesn't exist and create isn't set.
+    // Caller holds m_mutex.
+    Region* regionAt(glm::ivec2 region, bool create);
+    std::string regionPath(glm::ivec2 region) const;
+    static int indexInRegion(glm::ivec2 chunkPos);
+
+    std::string m_dir;
+    bool m_open;
+    bool m_writable;
+    std::mutex m_mutex;
+    // Regions that have been looked at, including ones that had no file
+    std::unordered_map<int64_t, uPtr<Region>> m_regions;
+};
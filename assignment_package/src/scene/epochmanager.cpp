@@ -0,0 +1,100 @@
+#include "epochmanager.h"
+#include <stdexcept>
+#include <thread>
+
+EpochManager::Guard::Guard(EpochManager &manager)
+    : m_manager(manager), m_slot(manager.pin())
+{}
+
+EpochManager::Guard::~Guard() {
+    m_manager.unpin(m_slot);
+}
+
+EpochManager::EpochManager()
+    : m_globalEpoch(0), m_slots(), m_retired(), m_retiredMutex()
+{
+    for (Slot &slot : m_slots) {
+        slot.epoch.store(INACTIVE);
+        slot.inUse.store(false);
+    }
+}
+
+EpochManager::~EpochManager() {
+    for (auto & [ epoch, deleter ] : m_retired) {
+        deleter();
+    }
+}
+
+int EpochManager::pin() {
+    // Threads tend to pin from the same slot every time,
+    // so start looking where we left off
+    thread_local int hint = 0;
+
+    for (int attempt = 0; attempt < 1000; attempt++) {
+        for (int i = 0; i < MAX_PINS; i++) {
+            int slot = (hint + i) % MAX_PINS;
+            bool expected = false;
+            if (m_slots[slot].inUse.compare_exchange_strong(expected, true)) {
+                // Publishing our epoch must happen before we read any shared
+                // pointer, which the default seq_cst ordering guarantees
+                m_slots[slot].epoch.store(m_globalEpoch.load());
+                hint = slot;
+                return slot;
+            }
+        }
+        std::this_thread::yield();
+    }
+    throw std::runtime_error("EpochManager ran out of pin slots");
+}
+
+void EpochManager::unpin(int slot) {
+    m_slots[slot].epoch.store(INACTIVE);
+    m_slots[slot].inUse.store(false);
+}
+
+uint64_t EpochManager::minPinnedEpoch() const {
+    uint64_t minEpoch = INACTIVE;
+    for (const Slot &slot : m_slots) {
+        minEpoch = std::min(minEpoch, slot.epoch.load());
+    }
+    return minEpoch;
+}
+
+void EpochManager::retire(std::function<void()> deleter) {
+    // Any reader that pins after this increment started after the object
+    // was unlinked, so it can only be seen by readers pinned at or before
+    // the epoch we tag it with
+    uint64_t epoch = m_globalEpoch.fetch_add(1);
+
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    m_retired.push_back({epoch, std::move(deleter)});
+}
+
+int EpochManager::collect() {
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> lock(m_retiredMutex);
+        uint64_t minEpoch = minPinnedEpoch();
+
+        auto stillVisible = m_retired.begin();
+        for (auto it = m_retired.begin(); it != m_retired.end(); ++it) {
+            if (it->first < minEpoch) {
+                ready.push_back(std::move(it->second));
+            } else {
+                *stillVisible++ = std::move(*it);
+            }
+        }
+        m_retired.erase(stillVisible, m_retired.end());
+    }
+
+    // Run the deleters outside the lock in case they retire more objects
+    for (auto &deleter : ready) {
+        deleter();
+    }
+    return static_cast<int>(ready.size());
+}
+
+int EpochManager::pendingCount() {
+    std::lock_guard<std::mutex> lock(m_retiredMutex);
+    return static_cast<int>(m_retired.size());
+}
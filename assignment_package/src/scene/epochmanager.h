@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+// Deferred reclamation for data that is read without locks.
+// A reader pins the current epoch for as long as it holds pointers it
+// loaded from a shared structure. A writer that unlinks an object hands
+// it to retire() instead of deleting it, and collect() only runs the
+// deleter once every reader that could still have seen the object has
+// unpinned.
+class EpochManager {
+public:
+    // Maximum number of pins that may be held at the same time,
+    // across all threads
+    static const int MAX_PINS = 64;
+
+    // Keeps the epoch it was created in pinned until it goes out of scope
+    class Guard {
+    public:
+        Guard(EpochManager &manager);
+        ~Guard();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    private:
+        EpochManager &m_manager;
+        int m_slot;
+    };
+
+    EpochManager();
+    // Runs every deleter still waiting, so nothing may be pinned by then
+    ~EpochManager();
+
+    // Schedules deleter to run once no reader can hold the object anymore.
+    // The object must already be unreachable from the shared structure.
+    void retire(std::function<void()> deleter);
+
+    // Runs the deleters of every retired object that is no longer visible
+    // to any pinned reader. Returns how many were freed.
+    int collect();
+
+    // Number of objects retired but not yet freed
+    int pendingCount();
+
+private:
+    static const uint64_t INACTIVE = UINT64_MAX;
+
+    // One per concurrent pin, padded so pins on different
+    // threads don't share a cache line
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch;
+        std::atomic<bool> inUse;
+    };
+
+    int pin();
+    void unpin(int slot);
+    uint64_t minPinnedEpoch() const;
+
+    std::atomic<uint64_t> m_globalEpoch;
+    std::array<Slot, MAX_PINS> m_slots;
+
+    // Objects waiting to be freed, tagged with the epoch they were retired in
+    std::vector<std::pair<uint64_t, std::function<void()>>> m_retired;
+    std::mutex m_retiredMutex;
+};
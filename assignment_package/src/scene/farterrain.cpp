@@ -0,0 +1,194 @@
+#include "farterrain.h"
+#include "terrain.h"
+#include "procgen.h"
+#include <algorithm>
+
+// Samples along one side of a level
+static const int SAMPLES = FarTerrain::GRID + 1;
+
+// The color of the block on top of a column, in place of its texture
+static glm::vec4 topColor(BlockType type) {
+    switch (type) {
+    case GRASS:
+        return glm::vec4(0.37f, 0.56f, 0.24f, 1.f);
+    case SAND:
+        return glm::vec4(0.86f, 0.81f, 0.58f, 1.f);
+    case SNOW:
+        return glm::vec4(0.95f, 0.97f, 1.f, 1.f);
+    default:
+        return glm::vec4(0.5f, 0.5f, 0.5f, 1.f);
+    }
+}
+
+FarTerrain::FarTerrain(OpenGLContext *context, const Terrain &terrain)
+    : Drawable(context), mr_terrain(terrain),
+      m_mesh(), m_built(false), m_pending(),
+      m_maskTexture(), m_maskGenerated(false), m_maskOrigin(0, 0),
+      m_mask(MASK_CHUNKS * MASK_CHUNKS, 0)
+{}
+
+FarTerrain::Mesh FarTerrain::buildMesh(glm::ivec2 center, const WorldGen &worldGen) {
+    // heights[level][gx + SAMPLES * gz]
+    std::vector<std::vector<int>> heights(LEVELS, std::vector<int>(SAMPLES * SAMPLES));
+
+    for (int level = 0; level < LEVELS; level++) {
+        int cell = BASE_CELL << level;
+        glm::ivec2 origin = center - glm::ivec2(GRID / 2 * cell);
+
+        for (int gz = 0; gz < SAMPLES; gz++) {
+            for (int gx = 0; gx < SAMPLES; gx++) {
+                // The middle of each level lands on every other sample
+                // of the level below, so those are already known
+                bool inner = gx >= GRID / 4 && gx <= 3 * GRID / 4 && gz >= GRID / 4 && gz <= 3 * GRID / 4;
+                if (level > 0 && inner) {
+                    int fx = 2 * (gx - GRID / 4), fz = 2 * (gz - GRID / 4);
+                    heights[level][gx + SAMPLES * gz] = heights[level - 1][fx + SAMPLES * fz];
+                } else {
+                    heights[level][gx + SAMPLES * gz] =
+                            ProcGen::getHeight(origin.x + gx * cell, origin.y + gz * cell, worldGen.seed());
+                }
+            }
+        }
+    }
+
+    Mesh mesh;
+    mesh.center = center;
+
+    for (int level = 0; level < LEVELS; level++) {
+        int cell = BASE_CELL << level;
+        glm::ivec2 origin = center - glm::ivec2(GRID / 2 * cell);
+        const std::vector<int> &h = heights[level];
+        GLuint first = static_cast<GLuint>(mesh.interleaved.size() / 3);
+
+        for (int gz = 0; gz < SAMPLES; gz++) {
+            for (int gx = 0; gx < SAMPLES; gx++) {
+                int height = h[gx + SAMPLES * gz];
+
+                // The outer edge of every level but the last meets a level
+                // with half as many samples along it, so the samples in
+                // between are moved onto the coarser level's edge to keep
+                // the two from cracking apart
+                float y = static_cast<float>(height);
+                bool edgeX = gx == 0 || gx == GRID, edgeZ = gz == 0 || gz == GRID;
+                if (level < LEVELS - 1) {
+                    if (edgeZ && gx % 2 == 1) {
+                        y = 0.5f * (h[gx - 1 + SAMPLES * gz] + h[gx + 1 + SAMPLES * gz]);
+                    } else if (edgeX && gz % 2 == 1) {
+                        y = 0.5f * (h[gx + SAMPLES * (gz - 1)] + h[gx + SAMPLES * (gz + 1)]);
+                    }
+                }
+
+                int x0 = glm::max(gx - 1, 0), x1 = glm::min(gx + 1, GRID);
+                int z0 = glm::max(gz - 1, 0), z1 = glm::min(gz + 1, GRID);
+                float slopeX = (h[x1 + SAMPLES * gz] - h[x0 + SAMPLES * gz]) / static_cast<float>((x1 - x0) * cell);
+                float slopeZ = (h[gx + SAMPLES * z1] - h[gx + SAMPLES * z0]) / static_cast<float>((z1 - z0) * cell);
+
+                // The top face of the column's highest block
+                mesh.interleaved.push_back(glm::vec4(origin.x + gx * cell, y + 1, origin.y + gz * cell, 1));
+                mesh.interleaved.push_back(glm::vec4(glm::normalize(glm::vec3(-slopeX, 1, -slopeZ)), 0));
+                mesh.interleaved.push_back(topColor(worldGen.generateBlockTypeByHeight(height, true)));
+            }
+        }
+
+        for (int gz = 0; gz < GRID; gz++) {
+            for (int gx = 0; gx < GRID; gx++) {
+                // Leave out the middle quarter, which the level below covers
+                bool hole = gx >= GRID / 4 && gx < 3 * GRID / 4 && gz >= GRID / 4 && gz < 3 * GRID / 4;
+                if (level > 0 && hole) {
+                    continue;
+                }
+                GLuint v = first + gx + SAMPLES * gz;
+                mesh.indices.insert(mesh.indices.end(), {v, v + SAMPLES, v + SAMPLES + 1,
+                                                         v, v + SAMPLES + 1, v + 1});
+            }
+        }
+    }
+    return mesh;
+}
+
+void FarTerrain::create() {
+    m_countOpq = static_cast<int>(m_mesh.indices.size());
+
+    if (!m_opqGenerated) {
+        generateOpq();
+        generateIdxOpq();
+    }
+
+    bindOpq();
+    mp_context->glBufferData(GL_ARRAY_BUFFER, m_mesh.interleaved.size() * sizeof(glm::vec4), m_mesh.interleaved.data(), GL_STATIC_DRAW);
+
+    bindIdxOpq();
+    mp_context->glBufferData(GL_ELEMENT_ARRAY_BUFFER, m_mesh.indices.size() * sizeof(GLuint), m_mesh.indices.data(), GL_STATIC_DRAW);
+}
+
+void FarTerrain::destroyAll() {
+    if (m_pending.valid()) {
+        m_pending.wait();
+    }
+    destroy();
+    if (m_maskGenerated) {
+        mp_context->deleteTextures(1, &m_maskTexture);
+        m_maskGenerated = false;
+    }
+}
+
+void FarTerrain::update(glm::vec3 playerPos) {
+    if (m_pending.valid()) {
+        if (m_pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+            return;
+        }
+        m_mesh = m_pending.get();
+        m_built = true;
+        create();
+    }
+
+    glm::ivec2 center(static_cast<int>(glm::round(playerPos.x / SNAP)) * SNAP,
+                      static_cast<int>(glm::round(playerPos.z / SNAP)) * SNAP);
+    if (!m_built || center != m_mesh.center) {
+        m_pending = std::async(std::launch::async, &FarTerrain::buildMesh, center, std::cref(mr_terrain.worldGen()));
+    }
+}
+
+void FarTerrain::updateMask(int minX, int maxX, int minZ, int maxZ, int texSlot) {
+    m_maskOrigin = glm::ivec2(static_cast<int>(glm::floor(minX / 16.f)) * 16,
+                              static_cast<int>(glm::floor(minZ / 16.f)) * 16);
+    std::fill(m_mask.begin(), m_mask.end(), 0);
+
+    // The same walk as Terrain::draw()
+    EpochManager::Guard guard(mr_terrain.epochs());
+    for (int x = minX; x < maxX; x += 16) {
+        for (int z = minZ; z < maxZ; z += 16) {
+            int i = static_cast<int>(glm::floor(x / 16.f)) - m_maskOrigin.x / 16;
+            int j = static_cast<int>(glm::floor(z / 16.f)) - m_maskOrigin.y / 16;
+            if (i >= MASK_CHUNKS || j >= MASK_CHUNKS) {
+                continue;
+            }
+            Chunk *chunk = mr_terrain.findChunkAt(x, z);
+            if (chunk != nullptr && chunk->elemCountOpq() >= 0) {
+                m_mask[i + MASK_CHUNKS * j] = 255;
+            }
+        }
+    }
+
+    if (!m_maskGenerated) {
+        mp_context->glGenTextures(1, &m_maskTexture);
+        m_maskGenerated = true;
+    }
+    mp_context->activeTexture(GL_TEXTURE0 + texSlot);
+    mp_context->bindTexture(GL_TEXTURE_2D, m_maskTexture);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    mp_context->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    mp_context->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    mp_context->glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, MASK_CHUNKS, MASK_CHUNKS,
+                             0, GL_RED, GL_UNSIGNED_BYTE, m_mask.data());
+    // Everything else expects slot 0 to be active
+    mp_context->activeTexture(GL_TEXTURE0);
+}
+
+glm::ivec2 FarTerrain::maskOrigin() const {
+    return m_maskOrigin;
+}
+
+int FarTerrain::byteSize() const {
+    return static_cast<int>(m_mesh.interleaved.size() * sizeof(glm::vec4) + m_mesh.indices.size() * sizeof(GLuint));
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include "drawable.h"
+#include "glm_includes.h"
+#include <future>
+#include <vector>
+
+class Terrain;
+class WorldGen;
+
+// A low-detail stand-in for the world out to RADIUS blocks, drawn wherever
+// there is no Chunk to draw.
+//
+// It is a pyramid of LEVELS height maps sampled straight from ProcGen, all
+// centered on the same point. Each level is a GRID x GRID grid of cells
+// twice as wide as the level below it, with the middle quarter left out
+// since the level below already covers it. All of the levels share one
+// vertex buffer and are drawn in a single call, so the cost stays the same
+// however far out the last level reaches.
+//
+// Near the player the grid lies under the Chunks. The shader is given a
+// mask of the Chunks drawn this frame and discards the grid above them, so
+// the grid fills in for Chunks that have not loaded yet and gives way to
+// each one as it does.
+class FarTerrain : public Drawable {
+public:
+    static const int LEVELS = 4;
+    // Cells along one side of each level. A multiple of 4.
+    static const int GRID = 64;
+    // Width of one cell of the finest level, in blocks
+    static const int BASE_CELL = 16;
+    // The pyramid is recentered on the nearest multiple of this, which
+    // keeps the cells of every level aligned with the ones of the next
+    static const int SNAP = BASE_CELL << (LEVELS - 1);
+    // How far the coarsest level reaches from the center
+    static const int RADIUS = (BASE_CELL * GRID / 2) << (LEVELS - 1);
+    // Chunks along one side of the mask. Covers any window
+    // Terrain::draw() is given up to 1024 blocks wide.
+    static const int MASK_CHUNKS = 64;
+
+    FarTerrain(OpenGLContext*, const Terrain&);
+
+    FarTerrain(const FarTerrain&) = delete;
+    FarTerrain& operator=(const FarTerrain&) = delete;
+
+    // Uploads the most recently built grid
+    void create() override;
+    // Frees the grid and the mask
+    void destroyAll();
+
+    // Starts rebuilding the pyramid in the background once the player has
+    // moved far enough from its center, and uploads the result once it is
+    // done. Call on the thread that owns the GL context.
+    void update(glm::vec3 playerPos);
+
+    // Marks each Chunk that Terrain::draw() will draw given the same
+    // bounds, and uploads the mask to the given texture slot
+    void updateMask(int minX, int maxX, int minZ, int maxZ, int texSlot);
+    // The world position of the mask's first texel
+    glm::ivec2 maskOrigin() const;
+
+    // Size of the vertex and index data on the GPU
+    int byteSize() const;
+
+private:
+    struct Mesh {
+        glm::ivec2 center;
+        std::vector<glm::vec4> interleaved;
+        std::vector<GLuint> indices;
+    };
+
+    // Samples every level around center and triangulates them
+    static Mesh buildMesh(glm::ivec2 center, const WorldGen &worldGen);
+
+    const Terrain &mr_terrain;
+
+    Mesh m_mesh;
+    bool m_built;
+    std::future<Mesh> m_pending;
+
+    GLuint m_maskTexture;
+    bool m_maskGenerated;
+    glm::ivec2 m_maskOrigin;
+    std::vector<unsigned char> m_mask;
+};
@@ -0,0 +1,90 @@
+#pragma once
+
+#if !defined(FLOAT4_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FLOAT4_SSE2 1
+#else
+#include <climits>
+#include <cmath>
+#endif
+
+// Four floats that are operated on together, for ProcGen's batched
+// kernels. Uses SSE2 where the compiler targets it and plain loops
+// everywhere else. SSE2 arithmetic is IEEE single precision, so both
+// give exactly what the same expression gives on one float at a time.
+//
+// Define FLOAT4_NO_SIMD to force the plain loops.
+//
+// floor() and trunc() only handle values that fit in an int.
+struct Float4 {
+#ifdef FLOAT4_SSE2
+    __m128 v;
+
+    Float4() : v(_mm_setzero_ps()) {}
+    Float4(__m128 v) : v(v) {}
+    explicit Float4(float f) : v(_mm_set1_ps(f)) {}
+    Float4(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) {}
+
+    static Float4 load(const float *p) { return _mm_loadu_ps(p); }
+    void store(float *p) const { _mm_storeu_ps(p, v); }
+
+    friend Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+    friend Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+    friend Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+    friend Float4 operator/(Float4 a, Float4 b) { return _mm_div_ps(a.v, b.v); }
+
+    // a < b ? a : b and a > b ? a : b, so b wins whenever either is NaN
+    friend Float4 min(Float4 a, Float4 b) { return _mm_min_ps(a.v, b.v); }
+    friend Float4 max(Float4 a, Float4 b) { return _mm_max_ps(a.v, b.v); }
+    friend Float4 sqrt(Float4 a) { return _mm_sqrt_ps(a.v); }
+    friend Float4 abs(Float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+
+    friend Float4 trunc(Float4 a) {
+        return _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+    }
+    friend Float4 floor(Float4 a) {
+        // Truncating rounds negative values up, so take one
+        // back off wherever that happened
+        __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+        return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.f)));
+    }
+
+    // Writes each lane, truncated to int, to out[0..3].
+    // NaN and out of range lanes come out as INT_MIN.
+    void toInts(int *out) const {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_cvttps_epi32(v));
+    }
+#else
+    float v[4];
+
+    Float4() : v{0, 0, 0, 0} {}
+    explicit Float4(float f) : v{f, f, f, f} {}
+    Float4(float a, float b, float c, float d) : v{a, b, c, d} {}
+
+    static Float4 load(const float *p) { return Float4(p[0], p[1], p[2], p[3]); }
+    void store(float *p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+
+#define FLOAT4_LANEWISE(expr) Float4 r; for (int i = 0; i < 4; i++) { r.v[i] = (expr); } return r;
+    friend Float4 operator+(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] + b.v[i]) }
+    friend Float4 operator-(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] - b.v[i]) }
+    friend Float4 operator*(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] * b.v[i]) }
+    friend Float4 operator/(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] / b.v[i]) }
+
+    // Same as minps/maxps, including returning b when either is NaN
+    friend Float4 min(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]) }
+    friend Float4 max(Float4 a, Float4 b) { FLOAT4_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]) }
+    friend Float4 sqrt(Float4 a) { FLOAT4_LANEWISE(std::sqrt(a.v[i])) }
+    friend Float4 abs(Float4 a) { FLOAT4_LANEWISE(std::fabs(a.v[i])) }
+
+    friend Float4 trunc(Float4 a) { FLOAT4_LANEWISE(static_cast<float>(static_cast<int>(a.v[i]))) }
+    friend Float4 floor(Float4 a) { FLOAT4_LANEWISE(std::floor(a.v[i])) }
+#undef FLOAT4_LANEWISE
+
+    void toInts(int *out) const {
+        for (int i = 0; i < 4; i++) {
+            bool inRange = v[i] > -2147483648.f && v[i] < 2147483648.f;
+            out[i] = inRange ? static_cast<int>(v[i]) : INT_MIN;
+        }
+    }
+#endif
+};
@@ -0,0 +1,62 @@
+#include "fragmentcounter.h"
+
+FragmentCounter::FragmentCounter(OpenGLContext *context)
+    : mp_context(context), m_queries(), m_pending(), m_created(false),
+      m_next(0), m_active(-1), m_lastCount(-1)
+{
+    m_pending.fill(false);
+}
+
+void FragmentCounter::begin() {
+    if (!m_created) {
+        mp_context->glGenQueries(FRAMES_IN_FLIGHT, m_queries.data());
+        m_created = true;
+    }
+    // Oldest first, so that the newest result to have come back wins
+    for (int i = 0; i < FRAMES_IN_FLIGHT; i++) {
+        collect((m_next + i) % FRAMES_IN_FLIGHT);
+    }
+    if (m_pending[m_next]) {
+        return;
+    }
+    m_active = m_next;
+    m_next = (m_next + 1) % FRAMES_IN_FLIGHT;
+    mp_context->glBeginQuery(GL_SAMPLES_PASSED, m_queries[m_active]);
+}
+
+void FragmentCounter::end() {
+    if (m_active < 0) {
+        return;
+    }
+    mp_context->glEndQuery(GL_SAMPLES_PASSED);
+    m_pending[m_active] = true;
+    m_active = -1;
+}
+
+void FragmentCounter::collect(int slot) {
+    if (!m_pending[slot]) {
+        return;
+    }
+    GLuint available = GL_FALSE;
+    mp_context->glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return;
+    }
+    GLuint samples = 0;
+    mp_context->glGetQueryObjectuiv(m_queries[slot], GL_QUERY_RESULT, &samples);
+    m_pending[slot] = false;
+    m_lastCount = samples;
+}
+
+long long FragmentCounter::lastCount() const {
+    return m_lastCount;
+}
+
+void FragmentCounter::destroy() {
+    if (m_created) {
+        mp_context->glDeleteQueries(FRAMES_IN_FLIGHT, m_queries.data());
+        m_created = false;
+        m_pending.fill(false);
+        m_active = -1;
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include "openglcontext.h"
+#include <array>
+
+// Counts the fragments that pass the depth test between begin() and end(),
+// with a GL_SAMPLES_PASSED query. Without discard or depth writes in the
+// fragment shader that is every fragment that gets shaded, so drawn over a
+// frame's opaque geometry it measures overdraw. Like FrameProfiler's timer
+// queries, results are only read once they are in, a few frames late, so
+// counting never stalls. A frame whose query slot is still busy goes
+// uncounted.
+//
+// Only used on the thread that owns the GL context.
+class FragmentCounter {
+public:
+    FragmentCounter(OpenGLContext *context);
+
+    FragmentCounter(const FragmentCounter&) = delete;
+    FragmentCounter& operator=(const FragmentCounter&) = delete;
+
+    // Makes the queries the first time it is called
+    void begin();
+    void end();
+    // The most recent count to come back, or -1 if none has yet
+    long long lastCount() const;
+    void destroy();
+
+private:
+    static const int FRAMES_IN_FLIGHT = 4;
+
+    // Reads the slot's result if it is in
+    void collect(int slot);
+
+    OpenGLContext *mp_context;
+    std::array<GLuint, FRAMES_IN_FLIGHT> m_queries;
+    // Whether each slot has a result that hasn't been read
+    std::array<bool, FRAMES_IN_FLIGHT> m_pending;
+    bool m_created;
+    int m_next;
+    // The slot between begin() and end(), or -1
+    int m_active;
+    long long m_lastCount;
+};
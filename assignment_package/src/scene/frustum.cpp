@@ -0,0 +1,39 @@
+#include "frustum.h"
+#include <limits>
+
+Frustum::Frustum(const glm::mat4 &viewProj)
+    : m_planes(), m_center(0), m_distance(std::numeric_limits<float>::infinity())
+{
+    // A point is in clip space when -w <= x, y, z <= w. Each of those six
+    // inequalities, written in terms of the world-space point, is a plane.
+    // glm is column-major, so row i of the matrix is viewProj[*][i].
+    glm::vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = glm::vec4(viewProj[0][i], viewProj[1][i], viewProj[2][i], viewProj[3][i]);
+    }
+    for (int i = 0; i < 3; i++) {
+        m_planes[2 * i] = rows[3] + rows[i];
+        m_planes[2 * i + 1] = rows[3] - rows[i];
+    }
+}
+
+void Frustum::limitDistance(glm::vec2 center, float distance) {
+    m_center = center;
+    m_distance = distance;
+}
+
+bool Frustum::intersects(glm::vec3 boxMin, glm::vec3 boxMax) const {
+    for (const glm::vec4 &plane : m_planes) {
+        // The corner of the box furthest along the plane's normal. If even
+        // that one is outside, the whole box is.
+        glm::vec3 corner(plane.x >= 0 ? boxMax.x : boxMin.x,
+                         plane.y >= 0 ? boxMax.y : boxMin.y,
+                         plane.z >= 0 ? boxMax.z : boxMin.z);
+        if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+            return false;
+        }
+    }
+
+    glm::vec2 nearest = glm::clamp(m_center, glm::vec2(boxMin.x, boxMin.z), glm::vec2(boxMax.x, boxMax.z));
+    return glm::length(nearest - m_center) < m_distance;
+}
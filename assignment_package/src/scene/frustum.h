@@ -0,0 +1,31 @@
+#pragma once
+#include "glm_includes.h"
+#include <array>
+
+// The region of the world a camera can see, used to skip drawing things
+// that would end up entirely off screen.
+//
+// The six planes are pulled straight out of a view-projection matrix, so
+// the frustum always matches whatever getViewProj() handed to the shaders.
+// It can also be cut off at a horizontal distance, e.g. where the fog
+// hides everything anyway.
+class Frustum {
+public:
+    Frustum(const glm::mat4 &viewProj);
+
+    // Also rejects anything that lies entirely more than distance
+    // away from center in the x-z plane
+    void limitDistance(glm::vec2 center, float distance);
+
+    // False only if the box is certainly not visible. A box that is
+    // outside but near a corner of the frustum may still pass.
+    bool intersects(glm::vec3 boxMin, glm::vec3 boxMax) const;
+
+private:
+    // Left, right, bottom, top, near, far. A point p is on the inside
+    // of a plane when dot(plane, vec4(p, 1)) >= 0.
+    std::array<glm::vec4, 6> m_planes;
+    glm::vec2 m_center;
+    // Infinite unless limitDistance() was called
+    float m_distance;
+};
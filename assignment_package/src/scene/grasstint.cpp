@@ -0,0 +1,102 @@
+#include "grasstint.h"
+#include <cstdlib>
+
+GrassTint::GrassTint(OpenGLContext *context)
+    : mp_context(context), m_texture(context, SIZE, SIZE, 1), m_created(false),
+      m_baked(false), m_origin(0)
+{}
+
+void GrassTint::create() {
+    // Only the red channel is ever read, and it has no use for depth
+    m_texture.createColor(GL_R8);
+    m_created = true;
+    m_baked = false;
+
+    // Blended between texels and wrapped around the window
+    m_texture.setFilter(GL_LINEAR);
+    m_texture.setWrap(GL_REPEAT, GL_REPEAT);
+}
+
+void GrassTint::destroy() {
+    if (m_created) {
+        m_texture.destroy();
+        m_created = false;
+    }
+}
+
+void GrassTint::update(ShaderProgram &bakeProgram, Quad &quad, glm::vec3 playerPos, glm::ivec2 viewport) {
+    // The same Chunk corner Terrain::draw() is centered on
+    glm::ivec2 chunk(static_cast<int>(glm::floor(playerPos.x / 16.f)) * 16,
+                     static_cast<int>(glm::floor(playerPos.z / 16.f)) * 16);
+    glm::ivec2 origin = chunk - glm::ivec2(WINDOW_BLOCKS / 2);
+    glm::ivec2 moved = origin - m_origin;
+    if (m_baked && moved == glm::ivec2(0)) {
+        return;
+    }
+
+    m_texture.bindFrameBuffer();
+    mp_context->glViewport(0, 0, SIZE, SIZE);
+    mp_context->enable(GL_SCISSOR_TEST);
+    mp_context->disable(GL_DEPTH_TEST);
+    bakeProgram.setDimensions(glm::ivec2(SIZE, SIZE));
+    bakeProgram.setTintOrigin(origin);
+
+    glm::ivec2 end = origin + glm::ivec2(WINDOW_BLOCKS);
+    if (!m_baked || std::abs(moved.x) >= WINDOW_BLOCKS || std::abs(moved.y) >= WINDOW_BLOCKS) {
+        bake(bakeProgram, quad, origin, end);
+    } else {
+        // The columns and then the rows that entered the window
+        if (moved.x > 0) {
+            bake(bakeProgram, quad, glm::ivec2(end.x - moved.x, origin.y), end);
+        } else if (moved.x < 0) {
+            bake(bakeProgram, quad, origin, glm::ivec2(origin.x - moved.x, end.y));
+        }
+        if (moved.y > 0) {
+            bake(bakeProgram, quad, glm::ivec2(origin.x, end.y - moved.y), end);
+        } else if (moved.y < 0) {
+            bake(bakeProgram, quad, origin, glm::ivec2(end.x, origin.y - moved.y));
+        }
+    }
+
+    mp_context->enable(GL_DEPTH_TEST);
+    mp_context->disable(GL_SCISSOR_TEST);
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->defaultFramebufferObject());
+    mp_context->glViewport(0, 0, viewport.x, viewport.y);
+
+    m_origin = origin;
+    m_baked = true;
+}
+
+// The texels [from, from + count) of one axis, which wrap around
+// into a second run when they pass the end of the texture
+static int texelRuns(int from, int count, int starts[2], int counts[2]) {
+    from = ((from % GrassTint::SIZE) + GrassTint::SIZE) % GrassTint::SIZE;
+    if (from + count <= GrassTint::SIZE) {
+        starts[0] = from;
+        counts[0] = count;
+        return 1;
+    }
+    starts[0] = from;
+    counts[0] = GrassTint::SIZE - from;
+    starts[1] = 0;
+    counts[1] = count - counts[0];
+    return 2;
+}
+
+void GrassTint::bake(ShaderProgram &bakeProgram, Quad &quad, glm::ivec2 min, glm::ivec2 max) {
+    int xStarts[2], xCounts[2], zStarts[2], zCounts[2];
+    int xRuns = texelRuns(min.x * TEXELS_PER_BLOCK, (max.x - min.x) * TEXELS_PER_BLOCK, xStarts, xCounts);
+    int zRuns = texelRuns(min.y * TEXELS_PER_BLOCK, (max.y - min.y) * TEXELS_PER_BLOCK, zStarts, zCounts);
+    for (int i = 0; i < xRuns; i++) {
+        for (int j = 0; j < zRuns; j++) {
+            mp_context->glScissor(xStarts[i], zStarts[j], xCounts[i], zCounts[j]);
+            bakeProgram.draw(quad);
+        }
+    }
+}
+
+void GrassTint::bind(int texSlot) {
+    m_texture.bindToTextureSlot(texSlot);
+    // Everything else expects slot 0 to be active
+    mp_context->activeTexture(GL_TEXTURE0);
+}
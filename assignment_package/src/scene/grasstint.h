@@ -0,0 +1,60 @@
+#pragma once
+#include "framebuffer.h"
+#include "shaderprogram.h"
+#include "quad.h"
+
+// The fbm noise that tints the tops of grass blocks, baked into a texture
+// instead of being evaluated for every grass fragment.
+//
+// lambert.frag.glsl used to sum 8 octaves of value noise, hashing 8 lattice
+// points with sin() per octave, twice per fragment. The noise only depends
+// on the world x and z of the fragment, so grasstint.frag.glsl bakes that
+// same noise for a WINDOW_BLOCKS square of the world around the player,
+// which covers every Chunk Terrain::draw() is given at the largest render
+// distance. The bake runs on the GPU with the same GLSL as the old code,
+// since how sin() hashes large arguments differs between drivers.
+//
+// The texture wraps around: lambert.frag.glsl looks world x and z up
+// modulo WINDOW_BLOCKS, and each texel holds the noise for the one such
+// position that is inside the window. When the player crosses into another
+// Chunk, the window moves with them and only the strips of the world that
+// entered it are baked again.
+//
+// Inside the window the tint matches the old per-fragment noise to within
+// 5 / 255 per channel, 0.6 / 255 on average, with the difference coming
+// from blending between texels. Outside it a grass top would get the noise
+// from a multiple of WINDOW_BLOCKS away, but no Chunk drawn is out there.
+class GrassTint {
+public:
+    // Width of the window in blocks, twice the largest draw radius
+    // RenderDistance gives. Both shaders have the same constant.
+    static const int WINDOW_BLOCKS = 1024;
+    static const int TEXELS_PER_BLOCK = 4;
+    static const int SIZE = WINDOW_BLOCKS * TEXELS_PER_BLOCK;
+
+    GrassTint(OpenGLContext *context);
+
+    GrassTint(const GrassTint&) = delete;
+    GrassTint& operator=(const GrassTint&) = delete;
+
+    void create();
+    void destroy();
+    // Moves the window to be centered on the Chunk the player is in and
+    // bakes whatever part of it isn't baked yet with bakeProgram, which
+    // should be grasstint.frag.glsl drawn over quad. Then returns to the
+    // default frame buffer and the given viewport, in pixels.
+    void update(ShaderProgram &bakeProgram, Quad &quad, glm::vec3 playerPos, glm::ivec2 viewport);
+    void bind(int texSlot);
+
+private:
+    // Bakes the blocks [min, max) of the world, which must fit in the window
+    void bake(ShaderProgram &bakeProgram, Quad &quad, glm::ivec2 min, glm::ivec2 max);
+
+    OpenGLContext *mp_context;
+    FrameBuffer m_texture;
+    bool m_created;
+    // Whether the window at m_origin is baked
+    bool m_baked;
+    // World x and z of the window's lowest corner
+    glm::ivec2 m_origin;
+};
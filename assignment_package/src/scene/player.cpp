@@ -237,9 +237,7 @@ BlockType Player::removeBlock(Terrain *terrain) {
     if (gridMarch(rayOrigin, rayDirection, *terrain, &outDist, &outBlockHit)) {
         BlockType blockType = terrain->getBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z);
         terrain->setBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z, EMPTY);
-        terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->destroy();
-        terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->generateVBOData();
-        terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->create();
+        terrain->requestRemesh(outBlockHit.x, outBlockHit.z);
         std::cout << "remove block" << std::endl;
         return blockType;
     }
@@ -257,27 +255,21 @@ BlockType Player::placeBlock(Terrain *terrain, BlockType currBlockType) {
         if (ifAxis == 0) {
             if (terrain->getBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z + glm::sign(rayDirection.z)) == EMPTY) {
                 terrain->setBlockAt(outBlockHit.x, outBlockHit.y, outBlockHit.z + glm::sign(rayDirection.z), currBlockType);
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->destroy();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->generateVBOData();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->create();
+                terrain->requestRemesh(outBlockHit.x, outBlockHit.z + glm::sign(rayDirection.z));
                 std::cout << "create" << std::endl;
                 return currBlockType;
             }
         } else if (ifAxis == 1) {
             if (terrain->getBlockAt(outBlockHit.x, outBlockHit.y + glm::sign(rayDirection.y), outBlockHit.z) == EMPTY) {
                 terrain->setBlockAt(outBlockHit.x, outBlockHit.y + glm::sign(rayDirection.y), outBlockHit.z, currBlockType);
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->destroy();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->generateVBOData();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->create();
+                terrain->requestRemesh(outBlockHit.x, outBlockHit.z);
                 std::cout << "create" << std::endl;
                 return currBlockType;
             }
         } else if (ifAxis == 2) {
             if (terrain->getBlockAt(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.y, outBlockHit.z) == EMPTY) {
                 terrain->setBlockAt(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.y, outBlockHit.z, currBlockType);
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->destroy();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->generateVBOData();
-                terrain->getChunkAt(outBlockHit.x, outBlockHit.z).get()->create();
+                terrain->requestRemesh(outBlockHit.x + glm::sign(rayDirection.x), outBlockHit.z);
                 std::cout << "create" << std::endl;
                 return currBlockType;
              }
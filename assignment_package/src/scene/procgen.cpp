@@ -2,59 +2,233 @@
 
 #include <math.h>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <vector>
 #include <glm_includes.h>
+#include "float4.h"
 
 const float PI = 3.141593;
 
+// Behind biomeCounters(). Heights are generated on several threads at once.
+static std::atomic<long long> columnsGenerated(0);
+static std::atomic<long long> grasslandsEvaluated(0);
+static std::atomic<long long> mountainsEvaluated(0);
+static std::atomic<long long> desertEvaluated(0);
+
 ProcGen::ProcGen() {}
 
 ProcGen::~ProcGen() {}
 
-int ProcGen::getHeight(int x, int z) {
-    float grass = grasslands(x, z);
-    float mtn = mountains(x, z);
-    float des = desert(x, z);
+// Rounds toward negative infinity, unlike /
+static int floorDiv(int a, int b) {
+    return a / b - (a % b < 0 ? 1 : 0);
+}
+
+int ProcGen::getHeight(int x, int z, unsigned int seed) {
+    int cellX = floorDiv(x, BIOME_CELL) * BIOME_CELL;
+    int cellZ = floorDiv(z, BIOME_CELL) * BIOME_CELL;
+    BiomeSelectors corners[4] = {
+        biomeSelectorsAt(cellX, cellZ, seed),
+        biomeSelectorsAt(cellX + BIOME_CELL, cellZ, seed),
+        biomeSelectorsAt(cellX, cellZ + BIOME_CELL, seed),
+        biomeSelectorsAt(cellX + BIOME_CELL, cellZ + BIOME_CELL, seed)
+    };
+    BiomeSelectors selectors = interpolateSelectors(corners,
+                                                    (x - cellX) / static_cast<float>(BIOME_CELL),
+                                                    (z - cellZ) / static_cast<float>(BIOME_CELL));
+    BiomeWeights weights = biomeWeights(selectors);
+
+    // A layer with no weight contributes exactly nothing to the blend,
+    // so it is never evaluated
+    float grass = 0, mtn = 0, des = 0;
+    if (needsGrasslands(weights)) {
+        grass = grasslands(x, z, seed);
+        grasslandsEvaluated++;
+    }
+    if (needsMountains(weights)) {
+        mtn = mountains(x, z, seed);
+        mountainsEvaluated++;
+    }
+    if (needsDesert(weights)) {
+        des = desert(x, z, seed);
+        desertEvaluated++;
+    }
+    columnsGenerated++;
+
+    return blendBiomes(grass, mtn, des, weights);
+}
+
+ProcGen::BiomeSelectors ProcGen::biomeSelectorsAt(int x, int z, unsigned int seed) {
+    float perlin = (fbm2D(x/2048.f, z/2048.f, 0.2, Perlin<1>{seed}) + 1) / 2;
+    float desPerlin = (fbm2D(x/4096.f, z/4096.f, 0.9, Perlin<3>{seed}) + 1) / 2;
+    return {perlin, desPerlin};
+}
+
+ProcGen::BiomeSelectors ProcGen::interpolateSelectors(const BiomeSelectors corners[4], float tx, float tz) {
+    BiomeSelectors result;
+    result.perlin = glm::mix(glm::mix(corners[0].perlin, corners[1].perlin, tx),
+                             glm::mix(corners[2].perlin, corners[3].perlin, tx), tz);
+    result.desPerlin = glm::mix(glm::mix(corners[0].desPerlin, corners[1].desPerlin, tx),
+                                glm::mix(corners[2].desPerlin, corners[3].desPerlin, tx), tz);
+    return result;
+}
+
+ProcGen::BiomeWeights ProcGen::biomeWeights(BiomeSelectors selectors) {
+    BiomeWeights weights;
+    weights.mountains = glm::smoothstep(0.5, 0.6, (double) selectors.perlin);
+    weights.desert = glm::smoothstep(0.7, 0.85, (double) selectors.desPerlin);
+    return weights;
+}
+
+bool ProcGen::needsGrasslands(BiomeWeights weights) {
+    return weights.desert < 1 && weights.mountains < 1;
+}
+
+bool ProcGen::needsMountains(BiomeWeights weights) {
+    return weights.desert < 1 && weights.mountains > 0;
+}
+
+bool ProcGen::needsDesert(BiomeWeights weights) {
+    return weights.desert > 0;
+}
+
+int ProcGen::blendBiomes(float grass, float mtn, float des, BiomeWeights weights) {
+    return glm::clamp(glm::mix(glm::mix(grass, mtn, weights.mountains), des, weights.desert), 0.f, 255.f);
+}
+
+ProcGen::BiomeCounters ProcGen::biomeCounters() {
+    BiomeCounters counters;
+    counters.columns = columnsGenerated;
+    counters.grasslands = grasslandsEvaluated;
+    counters.mountains = mountainsEvaluated;
+    counters.desert = desertEvaluated;
+    return counters;
+}
+
+// Mirrors getHeight() and the biome functions step for step, so every
+// float operation rounds exactly the same way
+void ProcGen::getHeights(int x, int z, unsigned int seed, int *out) {
+    float xs[CHUNK_COLUMNS], zs[CHUNK_COLUMNS];
+    for (int i = 0; i < CHUNK_COLUMNS; i++) {
+        xs[i] = x + i % 16;
+        zs[i] = z + i / 16;
+    }
+
+    float sx[CHUNK_COLUMNS], sz[CHUNK_COLUMNS];
+    float a[CHUNK_COLUMNS], b[CHUNK_COLUMNS];
+    float grass[CHUNK_COLUMNS] = {}, mtn[CHUNK_COLUMNS] = {}, des[CHUNK_COLUMNS] = {};
+    BiomeWeights weights[CHUNK_COLUMNS];
+
+    // biome selectors, from a (16 / BIOME_CELL + 1)^2 lattice shared
+    // by the whole footprint
+    const int cells = 16 / BIOME_CELL;
+    BiomeSelectors lattice[(cells + 1) * (cells + 1)];
+    for (int j = 0; j <= cells; j++) {
+        for (int i = 0; i <= cells; i++) {
+            lattice[i + (cells + 1) * j] = biomeSelectorsAt(x + i * BIOME_CELL, z + j * BIOME_CELL, seed);
+        }
+    }
+
+    // Each layer is evaluated for the whole footprint if any
+    // column in it has weight for that layer
+    bool anyGrass = false, anyMtn = false, anyDes = false;
+    for (int i = 0; i < CHUNK_COLUMNS; i++) {
+        int dx = i % 16, dz = i / 16;
+        int cx = dx / BIOME_CELL, cz = dz / BIOME_CELL;
+        BiomeSelectors corners[4] = {
+            lattice[cx + (cells + 1) * cz],
+            lattice[(cx + 1) + (cells + 1) * cz],
+            lattice[cx + (cells + 1) * (cz + 1)],
+            lattice[(cx + 1) + (cells + 1) * (cz + 1)]
+        };
+        weights[i] = biomeWeights(interpolateSelectors(corners,
+                                                       (dx - cx * BIOME_CELL) / static_cast<float>(BIOME_CELL),
+                                                       (dz - cz * BIOME_CELL) / static_cast<float>(BIOME_CELL)));
+        anyGrass = anyGrass || needsGrasslands(weights[i]);
+        anyMtn = anyMtn || needsMountains(weights[i]);
+        anyDes = anyDes || needsDesert(weights[i]);
+    }
 
-    float perlin = (fbm2D(x/2048.f, z/2048.f, 0.2, "perlin", 1) + 1) / 2;
-    float smoothPerlin = glm::smoothstep(0.5, 0.6, (double) perlin);
+    if (anyGrass) {
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            sx[i] = xs[i] / 512;
+            sz[i] = zs[i] / 512;
+        }
+        fbm2DBatch(sx, sz, 0.5, seed, 1, a);
+        fbm2DBatch(sz, sx, 0.5, seed, 1, b);
+        worleyNoiseBatch(a, b, seed, grass);
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            grass[i] = 128 + (160 - 128) * grass[i];
+        }
+        grasslandsEvaluated += CHUNK_COLUMNS;
+    }
 
-    float desPerlin = (fbm2D(x/4096.f, z/4096.f, 0.9, "perlin", 3) + 1) / 2;
-    float desSmoothPerlin = glm::smoothstep(0.7, 0.85, (double) desPerlin);
+    if (anyMtn) {
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            sx[i] = xs[i] / 4096;
+            sz[i] = zs[i] / 4096;
+        }
+        fbm2DBatch(sx, sz, 0.92, seed, 1, a);
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            mtn[i] = 160 + (250 - 160) * glm::abs(a[i]);
+        }
+        mountainsEvaluated += CHUNK_COLUMNS;
+    }
 
-    return glm::clamp(glm::mix(glm::mix(grass, mtn, smoothPerlin), des, desSmoothPerlin), 0.f, 255.f);
+    if (anyDes) {
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            sx[i] = xs[i] / 256;
+            sz[i] = zs[i] / 256;
+        }
+        fbm2DBatch(sx, sz, 0.5, seed, 3, a);
+        for (int i = 0; i < CHUNK_COLUMNS; i++) {
+            des[i] = 121 + (128 - 121) * (a[i] + 1) / 2;
+        }
+        desertEvaluated += CHUNK_COLUMNS;
+    }
+    columnsGenerated += CHUNK_COLUMNS;
+
+    for (int i = 0; i < CHUNK_COLUMNS; i++) {
+        out[i] = blendBiomes(grass[i], mtn[i], des[i], weights[i]);
+    }
 }
 
-float ProcGen::mountains(float x, float z) {
+float ProcGen::mountains(float x, float z, unsigned int seed) {
     x /= 4096;
     z /= 4096;
 
     int mountainMin = 160;
     int mountainMax = 250;
 
-    return mountainMin + (mountainMax - mountainMin) * glm::abs(fbm2D(x, z, 0.92, "perlin", 1));
+    return mountainMin + (mountainMax - mountainMin) * glm::abs(fbm2D(x, z, 0.92, Perlin<1>{seed}));
 }
 
-float ProcGen::grasslands(float x, float z) {
+float ProcGen::grasslands(float x, float z, unsigned int seed) {
     x /= 512;
     z /= 512;
 
     int grassMin = 128;
     int grassMax = 160;
 
-    return grassMin + (grassMax - grassMin) * worleyNoise(fbm2D(x, z, 0.5, "perlin", 1), fbm2D(z, x, 0.5, "perlin", 1));
+    return grassMin + (grassMax - grassMin) * worleyNoise(fbm2D(x, z, 0.5, Perlin<1>{seed}), fbm2D(z, x, 0.5, Perlin<1>{seed}), seed);
 }
 
-float ProcGen::desert(float x, float z) {
+float ProcGen::desert(float x, float z, unsigned int seed) {
     x /= 256;
     z /= 256;
 
     int desertMin = 121;
     int desertMax = 128;
 
-    return desertMin + (desertMax - desertMin) * (fbm2D(x, z, 0.5, "perlin", 3) + 1) / 2;
+    return desertMin + (desertMax - desertMin) * (fbm2D(x, z, 0.5, Perlin<3>{seed}) + 1) / 2;
 }
 
-float ProcGen::worleyNoise(float x, float z) {
+float ProcGen::worleyNoise(float x, float z, unsigned int seed) {
+    // Voronoi centers get their own channel, apart from every Perlin<>
+    seed = channelSeed(seed, -1);
+
     float intX, fractX;
     fractX = modf(x, &intX);
 
@@ -67,7 +241,7 @@ float ProcGen::worleyNoise(float x, float z) {
     for (int i = -1; i < 2; i++) {
         for (int j = -1; j < 2; j++) {
             glm::vec2 neighborDirection = glm::vec2(j, i);
-            glm::vec2 neighborVoronoiCtr = voronoiCenter(glm::vec2(intX, intZ) + neighborDirection);
+            glm::vec2 neighborVoronoiCtr = voronoiCenter(static_cast<int>(intX) + j, static_cast<int>(intZ) + i, seed);
             glm::vec2 diff = neighborDirection + neighborVoronoiCtr - glm::vec2(fractX, fractZ);
 
             float dist = glm::length(diff);
@@ -84,38 +258,180 @@ float ProcGen::worleyNoise(float x, float z) {
     return minDist2 - minDist1;
 }
 
-glm::vec2 ProcGen::voronoiCenter(glm::vec2 corner) {
-    float x = glm::fract(glm::sin(glm::dot(corner, glm::vec2(127.1, 311.7))) * 43758.5453);
-    float z = glm::fract(glm::sin(glm::dot(corner, glm::vec2(420.2, 1337.1))) * 789221.1234);
+glm::vec2 ProcGen::voronoiCenter(int x, int z, unsigned int seed) {
+    unsigned int h = hash2D(x, z, seed);
 
-    return glm::vec2(x, z);
+    // 16 bits of the hash for each coordinate
+    return glm::vec2((h & 0xffffu) / 65536.f, (h >> 16) / 65536.f);
 }
 
-float ProcGen::fbm2D(float x, float z, float persistence, std::string noiseFn, int primeSet) {
-    float total = 0;
+// The finalizer of a well-tested 32 bit integer hash
+static unsigned int mix32(unsigned int h) {
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
+unsigned int ProcGen::hash2D(int x, int z, unsigned int seed) {
+    unsigned int h = mix32(seed + static_cast<unsigned int>(x) * 0x8da6b343u);
+    return mix32(h + static_cast<unsigned int>(z) * 0xd8163841u);
+}
+
+unsigned int ProcGen::channelSeed(unsigned int seed, int channel) {
+    return mix32(seed + static_cast<unsigned int>(channel) * 0x9e3779b9u);
+}
+
+unsigned int ProcGen::hash3D(int x, int y, int z, unsigned int seed) {
+    return mix32(hash2D(x, z, seed) + static_cast<unsigned int>(y) * 0x27d4eb2du);
+}
+
+unsigned int ProcGen::Random::next() {
+    return mix32(mix32(seed + count++ * 0x9e3779b9u) ^ seed);
+}
+
+int ProcGen::Random::nextInt(int lo, int hi) {
+    // The bias of the modulo is at most the range over 2^32
+    unsigned int range = static_cast<unsigned int>(hi - lo) + 1u;
+    return lo + static_cast<int>(next() % range);
+}
+
+float ProcGen::Random::nextFloat() {
+    // The top 24 bits, which a float holds exactly
+    return (next() >> 8) * (1.f / 16777216.f);
+}
+
+float ProcGen::Value::operator()(float x, float z) const {
+    return interpNoise2D(x, z, seed);
+}
+
+void ProcGen::worleyNoiseBatch(const float *x, const float *z, unsigned int seed, float *out) {
+    seed = channelSeed(seed, -1);
+
+    for (int k = 0; k < CHUNK_COLUMNS; k += 4) {
+        Float4 X = Float4::load(x + k);
+        Float4 Z = Float4::load(z + k);
+
+        // modf() rounds toward zero
+        Float4 intX = trunc(X);
+        Float4 intZ = trunc(Z);
+        Float4 fractX = X - intX;
+        Float4 fractZ = Z - intZ;
+
+        int ix[4], iz[4];
+        intX.toInts(ix);
+        intZ.toInts(iz);
+
+        Float4 minDist1(1.f);
+        Float4 minDist2(1.f);
+
+        for (int i = -1; i < 2; i++) {
+            for (int j = -1; j < 2; j++) {
+                glm::vec2 c[4];
+                for (int lane = 0; lane < 4; lane++) {
+                    c[lane] = voronoiCenter(ix[lane] + j, iz[lane] + i, seed);
+                }
+                Float4 diffX = (Float4(static_cast<float>(j)) + Float4(c[0].x, c[1].x, c[2].x, c[3].x)) - fractX;
+                Float4 diffZ = (Float4(static_cast<float>(i)) + Float4(c[0].y, c[1].y, c[2].y, c[3].y)) - fractZ;
+
+                Float4 dist = sqrt(diffX * diffX + diffZ * diffZ);
+
+                // Branch-free version of worleyNoise()'s update. The operand
+                // order makes a NaN dist leave both untouched, just like
+                // the comparisons there do.
+                minDist2 = min(max(minDist1, dist), minDist2);
+                minDist1 = min(dist, minDist1);
+            }
+        }
+
+        (minDist2 - minDist1).store(out + k);
+    }
+}
+
+void ProcGen::fbm2DBatch(const float *x, const float *z, float persistence,
+                         unsigned int seed, int channel, float *out) {
+    seed = channelSeed(seed, channel);
+    std::fill_n(out, CHUNK_COLUMNS, 0.f);
+
+    float u[CHUNK_COLUMNS], v[CHUNK_COLUMNS];
+    std::vector<glm::vec2> gradients;
     int octaves = 8;
+    // Accumulated the same way as in fbmOctaves()
+    double octaveAmplitude = 1;
 
     for (int i = 0; i < octaves; i++) {
-        float frequency = pow(2, i);
-        float amplitude = pow(persistence, i);
+        float frequency = 1 << i;
+        float amplitude = static_cast<float>(octaveAmplitude);
+        octaveAmplitude *= persistence;
+
+        int minU = INT_MAX, maxU = INT_MIN, minV = INT_MAX, maxV = INT_MIN;
+        for (int k = 0; k < CHUNK_COLUMNS; k++) {
+            u[k] = x[k] * frequency;
+            v[k] = z[k] * frequency;
+            minU = std::min(minU, static_cast<int>(glm::floor(u[k])));
+            maxU = std::max(maxU, static_cast<int>(glm::floor(u[k])));
+            minV = std::min(minV, static_cast<int>(glm::floor(v[k])));
+            maxV = std::max(maxV, static_cast<int>(glm::floor(v[k])));
+        }
 
-        if (noiseFn == "perlin") {
-            total += perlinNoise2D(glm::vec2(x * frequency, z * frequency), primeSet) * amplitude;
+        // Neighboring columns share most of their lattice corners, especially
+        // at low octaves, so hash each corner the footprint touches only once
+        int cellsU = maxU - minU + 2;
+        int cellsV = maxV - minV + 2;
+        gradients.resize(cellsU * cellsV);
+        for (int cv = 0; cv < cellsV; cv++) {
+            for (int cu = 0; cu < cellsU; cu++) {
+                gradients[cu + cellsU * cv] = latticeGradient(minU + cu, minV + cv, seed);
+            }
         }
-        if (noiseFn == "regular") {
-            total += interpNoise2D(x * frequency, z * frequency) * amplitude;
+
+        for (int k = 0; k < CHUNK_COLUMNS; k += 4) {
+            Float4 U = Float4::load(u + k);
+            Float4 V = Float4::load(v + k);
+            Float4 floorU = floor(U);
+            Float4 floorV = floor(V);
+
+            int cu[4], cv[4];
+            (floorU - Float4(static_cast<float>(minU))).toInts(cu);
+            (floorV - Float4(static_cast<float>(minV))).toInts(cv);
+
+            Float4 surfletSum(0.f);
+            for (int dx = 0; dx <= 1; ++dx) {
+                for (int dy = 0; dy <= 1; ++dy) {
+                    glm::vec2 g[4];
+                    for (int lane = 0; lane < 4; lane++) {
+                        g[lane] = gradients[(cu[lane] + dx) + cellsU * (cv[lane] + dy)];
+                    }
+
+                    // surflet()
+                    Float4 diffU = U - (floorU + Float4(static_cast<float>(dx)));
+                    Float4 diffV = V - (floorV + Float4(static_cast<float>(dy)));
+
+                    Float4 tU2 = abs(diffU), tU3 = tU2 * tU2 * tU2, tU4 = tU3 * tU2, tU5 = tU4 * tU2;
+                    Float4 tV2 = abs(diffV), tV3 = tV2 * tV2 * tV2, tV4 = tV3 * tV2, tV5 = tV4 * tV2;
+                    Float4 tU = Float4(1.f) - Float4(6.f) * tU5 + Float4(15.f) * tU4 - Float4(10.f) * tU3;
+                    Float4 tV = Float4(1.f) - Float4(6.f) * tV5 + Float4(15.f) * tV4 - Float4(10.f) * tV3;
+
+                    Float4 height = diffU * Float4(g[0].x, g[1].x, g[2].x, g[3].x)
+                                  + diffV * Float4(g[0].y, g[1].y, g[2].y, g[3].y);
+
+                    surfletSum = surfletSum + height * tU * tV;
+                }
+            }
+
+            (Float4::load(out + k) + surfletSum * Float4(amplitude)).store(out + k);
         }
     }
-
-    return total;
 }
 
-float ProcGen::perlinNoise2D(glm::vec2 uv, int primeSet) {
+float ProcGen::perlinNoise2D(glm::vec2 uv, unsigned int seed) {
     float surfletSum = 0.f;
 
     for (int dx = 0; dx <= 1; ++dx) {
         for (int dy = 0; dy <= 1; ++dy) {
-            surfletSum += surflet(uv, glm::floor(uv) + glm::vec2(dx, dy), primeSet);
+            surfletSum += surflet(uv, glm::floor(uv) + glm::vec2(dx, dy), seed);
         }
     }
 
@@ -131,11 +447,11 @@ glm::vec2 pow(glm::vec2 v, int power) {
     return p;
 }
 
-float ProcGen::surflet(glm::vec2 p, glm::vec2 gridPoint, int primeSet) {
+float ProcGen::surflet(glm::vec2 p, glm::vec2 gridPoint, unsigned int seed) {
     glm::vec2 t2 = glm::abs(p - gridPoint);
     glm::vec2 t = glm::vec2(1.f) - 6.f * pow(t2, 5) + 15.f * pow(t2, 4) - 10.f * pow(t2, 3);
 
-    glm::vec2 gradient = noise2DNormalVector(gridPoint, primeSet) * 2.f - glm::vec2(1,1);
+    glm::vec2 gradient = latticeGradient(static_cast<int>(gridPoint.x), static_cast<int>(gridPoint.y), seed);
     glm::vec2 diff = p - gridPoint;
 
     float height = glm::dot(diff, gradient);
@@ -143,59 +459,45 @@ float ProcGen::surflet(glm::vec2 p, glm::vec2 gridPoint, int primeSet) {
     return height * t.x * t.y;
 }
 
-glm::vec2 ProcGen::noise2DNormalVector(glm::vec2 v, int primeSet) {
-    v += 0.1;
-
-    float xMult;
-    float yMult;
-    glm::mat2 primes;
-
-    if (primeSet == 1) {
-        primes = glm::mat2{{126.1, 311.7}, {420.2, 1337.1}};
-        xMult = 43758.5453;
-        yMult = 789221.5453;
-    }
-
-    if (primeSet == 2) {
-        primes = glm::mat2{{593.32, 931.85}, {719.31, 1029.44}};
-        xMult = 354234.5048;
-        yMult = 250986.2095;
-    }
-
-    if (primeSet == 3) {
-        primes = glm::mat2{{958.11, 347.77}, {139.44, 9559.43}};
-        xMult = 485048.09604;
-        yMult = 9450.234234;
-    }
-
-    glm::vec2 noise = glm::sin(v * primes);
-    noise.x *= xMult;
-    noise.y *= yMult;
+glm::vec2 ProcGen::latticeGradient(int x, int z, unsigned int seed) {
+    static const float D = 0.70710678f;
+    static const glm::vec2 gradients[8] = {
+        glm::vec2(1, 0), glm::vec2(-1, 0), glm::vec2(0, 1), glm::vec2(0, -1),
+        glm::vec2(D, D), glm::vec2(-D, D), glm::vec2(D, -D), glm::vec2(-D, -D)
+    };
 
-    return glm::normalize(glm::abs(glm::fract(noise)));
+    return gradients[hash2D(x, z, seed) & 7];
 }
 
 float ProcGen::linearInterp(float a, float b, float t) {
     return a * (1 - t) + b * t;
 }
 
+float ProcGen::trilinearInterp(const float corners[8], float tx, float ty, float tz) {
+    float x00 = glm::mix(corners[0], corners[1], tx);
+    float x10 = glm::mix(corners[2], corners[3], tx);
+    float x01 = glm::mix(corners[4], corners[5], tx);
+    float x11 = glm::mix(corners[6], corners[7], tx);
+    return glm::mix(glm::mix(x00, x10, ty), glm::mix(x01, x11, ty), tz);
+}
+
 float ProcGen::cosineInterp(float a, float b, float t) {
     t = (1 - cos(t * PI)) * 0.5;
 
     return linearInterp(a, b, t);
 }
 
-float ProcGen::interpNoise2D(float x, float z) {
+float ProcGen::interpNoise2D(float x, float z, unsigned int seed) {
     float intX, fractX;
     fractX = modf(x, &intX);
 
     float intZ, fractZ;
     fractZ = modf(z, &intZ);
 
-    float v1 = smoothNoise2D(intX, intZ);
-    float v2 = smoothNoise2D(intX + 1, intZ);
-    float v3 = smoothNoise2D(intX, intZ + 1);
-    float v4 = smoothNoise2D(intX + 1, intZ + 1);
+    float v1 = smoothNoise2D(intX, intZ, seed);
+    float v2 = smoothNoise2D(intX + 1, intZ, seed);
+    float v3 = smoothNoise2D(intX, intZ + 1, seed);
+    float v4 = smoothNoise2D(intX + 1, intZ + 1, seed);
 
     float i1 = cosineInterp(v1, v2, fractX);
     float i2 = cosineInterp(v3, v4, fractX);
@@ -203,22 +505,157 @@ float ProcGen::interpNoise2D(float x, float z) {
     return cosineInterp(i1, i2, fractZ);
 }
 
-float ProcGen::smoothNoise2D(float x, float z) {
-    float corners = (noise2D(x - 1, z - 1) +
-                     noise2D(x + 1, z - 1) +
-                     noise2D(x - 1, z + 1) +
-                     noise2D(x + 1, z + 1)) / 16;
-    float sides = (noise2D(x - 1, z) +
-                   noise2D(x + 1, z) +
-                   noise2D(x, z - 1) +
-                   noise2D(x, z + 1)) / 8;
-    float center = noise2D(x, z) / 4;
+float ProcGen::smoothNoise2D(float x, float z, unsigned int seed) {
+    float corners = (noise2D(x - 1, z - 1, seed) +
+                     noise2D(x + 1, z - 1, seed) +
+                     noise2D(x - 1, z + 1, seed) +
+                     noise2D(x + 1, z + 1, seed)) / 16;
+    float sides = (noise2D(x - 1, z, seed) +
+                   noise2D(x + 1, z, seed) +
+                   noise2D(x, z - 1, seed) +
+                   noise2D(x, z + 1, seed)) / 8;
+    float center = noise2D(x, z, seed) / 4;
 
     return corners + sides + center;
 }
 
-float ProcGen::noise2D(float x, float z) {
-    float s = sin(glm::dot(glm::vec2(x, z), glm::vec2(127.1, 311.7))) * 43758.5453;
+float ProcGen::noise2D(float x, float z, unsigned int seed) {
+    unsigned int h = hash2D(static_cast<int>(x), static_cast<int>(z), seed);
+
+    // The top 24 bits, which a float holds exactly
+    return (h >> 8) * (2.f / 16777216.f) - 1.f;
+}
+
+bool ProcGen::isSolid(int x, int y, int z, int height, unsigned int seed) {
+    // The noise can't reach this far from the surface
+    if (y < height - DENSITY_AMPLITUDE) {
+        return true;
+    }
+    if (y > height + DENSITY_AMPLITUDE) {
+        return false;
+    }
+
+    int cellX = floorDiv(x, CAVE_CELL_XZ) * CAVE_CELL_XZ;
+    int cellY = floorDiv(y, CAVE_CELL_Y) * CAVE_CELL_Y;
+    int cellZ = floorDiv(z, CAVE_CELL_XZ) * CAVE_CELL_XZ;
+    float corners[8];
+    for (int i = 0; i < 8; i++) {
+        corners[i] = caveSample(cellX + (i & 1) * CAVE_CELL_XZ,
+                                cellY + ((i >> 1) & 1) * CAVE_CELL_Y,
+                                cellZ + (i >> 2) * CAVE_CELL_XZ, seed);
+    }
+    float noise = trilinearInterp(corners,
+                                  (x - cellX) / static_cast<float>(CAVE_CELL_XZ),
+                                  (y - cellY) / static_cast<float>(CAVE_CELL_Y),
+                                  (z - cellZ) / static_cast<float>(CAVE_CELL_XZ));
+    return solidAt(height, y, noise);
+}
+
+void ProcGen::getSolidity(int x, int z, const int *heights, unsigned int seed, unsigned char *solid) {
+    int minHeight = *std::min_element(heights, heights + CHUNK_COLUMNS);
+    int maxHeight = *std::max_element(heights, heights + CHUNK_COLUMNS);
+    std::fill_n(solid, CHUNK_COLUMNS * CHUNK_HEIGHT, 0);
+
+    const int cells = 16 / CAVE_CELL_XZ;
+    const int side = cells + 1;
+    float below[side * side], above[side * side];
+    bool haveBelow = false;
+
+    for (int y0 = 0; y0 < CHUNK_HEIGHT; y0 += CAVE_CELL_Y) {
+        int y1 = y0 + CAVE_CELL_Y - 1;
+
+        // Every column of the footprint is solid throughout this layer,
+        // just as isSolid() would find
+        if (y1 < minHeight - DENSITY_AMPLITUDE) {
+            std::fill_n(solid + CHUNK_COLUMNS * y0, CHUNK_COLUMNS * CAVE_CELL_Y, 1);
+            haveBelow = false;
+            continue;
+        }
+        // ...or air throughout this one and every one above it
+        if (y0 > maxHeight + DENSITY_AMPLITUDE) {
+            break;
+        }
+
+        // The lattice above one layer is the lattice below the next
+        if (!haveBelow) {
+            caveLayer(x, y0, z, seed, below);
+        }
+        caveLayer(x, y0 + CAVE_CELL_Y, z, seed, above);
+
+        for (int y = y0; y <= y1; y++) {
+            float ty = (y - y0) / static_cast<float>(CAVE_CELL_Y);
+            for (int i = 0; i < CHUNK_COLUMNS; i++) {
+                int dx = i % 16, dz = i / 16;
+                int cx = dx / CAVE_CELL_XZ, cz = dz / CAVE_CELL_XZ;
+                float corners[8];
+                for (int c = 0; c < 8; c++) {
+                    const float *layer = ((c >> 1) & 1) ? above : below;
+                    corners[c] = layer[(cx + (c & 1)) + side * (cz + (c >> 2))];
+                }
+                float noise = trilinearInterp(corners,
+                                              (dx - cx * CAVE_CELL_XZ) / static_cast<float>(CAVE_CELL_XZ),
+                                              ty,
+                                              (dz - cz * CAVE_CELL_XZ) / static_cast<float>(CAVE_CELL_XZ));
+                solid[i + CHUNK_COLUMNS * y] = solidAt(heights[i], y, noise);
+            }
+        }
+
+        std::copy(above, above + side * side, below);
+        haveBelow = true;
+    }
+}
+
+void ProcGen::caveLayer(int x, int y, int z, unsigned int seed, float *out) {
+    const int side = 16 / CAVE_CELL_XZ + 1;
+    for (int j = 0; j < side; j++) {
+        for (int i = 0; i < side; i++) {
+            out[i + side * j] = caveSample(x + i * CAVE_CELL_XZ, y, z + j * CAVE_CELL_XZ, seed);
+        }
+    }
+}
+
+float ProcGen::caveSample(int x, int y, int z, unsigned int seed) {
+    seed = channelSeed(seed, -2);
+
+    // Three octaves, stretched out horizontally so that
+    // caves run sideways more than they plunge
+    float total = 0;
+    float amplitude = 1;
+    for (int i = 0; i < 3; i++) {
+        float frequency = 1 << i;
+        total += perlinNoise3D(glm::vec3(x / 48.f, y / 24.f, z / 48.f) * frequency, seed) * amplitude;
+        amplitude *= 0.5f;
+    }
+
+    return glm::clamp(total * 1.5f, -1.f, 1.f);
+}
+
+bool ProcGen::solidAt(int height, int y, float caveNoise) {
+    return (height - y) + DENSITY_AMPLITUDE * caveNoise > 0;
+}
+
+float ProcGen::perlinNoise3D(glm::vec3 p, unsigned int seed) {
+    glm::vec3 cell = glm::floor(p);
+    glm::vec3 f = p - cell;
+    int x = static_cast<int>(cell.x), y = static_cast<int>(cell.y), z = static_cast<int>(cell.z);
+
+    // Quintic fade, the same curve surflet() uses
+    glm::vec3 t = f * f * f * (f * (f * 6.f - 15.f) + 10.f);
+
+    float c[8];
+    for (int i = 0; i < 8; i++) {
+        glm::vec3 d((i & 1), (i >> 1) & 1, i >> 2);
+        c[i] = glm::dot(latticeGradient3D(x + (i & 1), y + ((i >> 1) & 1), z + (i >> 2), seed), f - d);
+    }
+    return trilinearInterp(c, t.x, t.y, t.z);
+}
+
+glm::vec3 ProcGen::latticeGradient3D(int x, int y, int z, unsigned int seed) {
+    static const glm::vec3 gradients[12] = {
+        glm::vec3(1, 1, 0), glm::vec3(-1, 1, 0), glm::vec3(1, -1, 0), glm::vec3(-1, -1, 0),
+        glm::vec3(1, 0, 1), glm::vec3(-1, 0, 1), glm::vec3(1, 0, -1), glm::vec3(-1, 0, -1),
+        glm::vec3(0, 1, 1), glm::vec3(0, -1, 1), glm::vec3(0, 1, -1), glm::vec3(0, -1, -1)
+    };
 
-    return modf(s, nullptr);
+    return gradients[hash3D(x, y, z, seed) % 12];
 }
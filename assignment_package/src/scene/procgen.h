@@ -1,32 +1,250 @@
 #pragma once
 
 #include <glm_includes.h>
+#include <utility>
 
 class ProcGen {
 public:
     ProcGen();
     ~ProcGen();
 
-    static int getHeight(int x, int z);
-    static float fbm2D(float x, float z, float persistence, std::string noiseFn, int);
+    // Number of columns in one Chunk's 16 x 16 footprint
+    static const int CHUNK_COLUMNS = 256;
+    // The biome selectors vary over thousands of blocks, so they are only
+    // sampled every BIOME_CELL blocks and interpolated in between.
+    // Divides 16, so every Chunk is covered by whole cells.
+    static const int BIOME_CELL = 8;
+    // Blocks in one column of a Chunk
+    static const int CHUNK_HEIGHT = 256;
+
+    // The density field that caves and overhangs are carved from. A block
+    // is solid where
+    //     (height of its column - y) + DENSITY_AMPLITUDE * cave noise > 0
+    // The cave noise stays within [-1, 1], so only blocks within
+    // DENSITY_AMPLITUDE of the height map can differ from it. It is sampled
+    // every CAVE_CELL_XZ x CAVE_CELL_Y x CAVE_CELL_XZ blocks and
+    // trilinearly interpolated in between. Both divide 16.
+    static const int DENSITY_AMPLITUDE = 16;
+    static const int CAVE_CELL_XZ = 4;
+    static const int CAVE_CELL_Y = 8;
+
+    // Height of the column at (x, z) in the world generated from seed
+    static int getHeight(int x, int z, unsigned int seed);
+    // getHeight() for every column of the 16 x 16 footprint with its
+    // corner at (x, z), written to out[dx + 16 * dz]. x and z must be
+    // multiples of 16, like a Chunk's corner. Gives exactly the same
+    // heights as getHeight(), several times faster.
+    static void getHeights(int x, int z, unsigned int seed, int *out);
+
+    // Whether the block at (x, y, z) is solid in the density field, given
+    // the height of its column
+    static bool isSolid(int x, int y, int z, int height, unsigned int seed);
+    // isSolid() for every block of the 16 x CHUNK_HEIGHT x 16 footprint with
+    // its corner at (x, z), written to solid[dx + 16 * dz + 256 * y] as 0 or 1.
+    // heights are the footprint's, as getHeights() gives them. x and z must
+    // be multiples of 16. Gives exactly the same answers as isSolid(), but
+    // only samples the cave noise in the layers that straddle the surface;
+    // the layers entirely below or above the height map's reach are filled
+    // without it.
+    static void getSolidity(int x, int z, const int *heights, unsigned int seed, unsigned char *solid);
+
+    // How many columns getHeight() and getHeights() have been asked for,
+    // and how many of those each biome layer was evaluated for. Layers
+    // are skipped wherever their blend weight is 0, though getHeights()
+    // evaluates a layer for a whole Chunk if any of its columns need it.
+    struct BiomeCounters {
+        long long columns;
+        long long grasslands, mountains, desert;
+    };
+    static BiomeCounters biomeCounters();
+
+    // Basis noises for fbm2D(). Each one is a policy: a small functor
+    // that fbm2D() calls once per octave, and that inlines away entirely.
+    // The same seed always gives the same noise. Each can also be
+    // sampled directly.
+
+    // Gradient noise. Each Channel is a separate, uncorrelated
+    // noise for the same seed.
+    template <int Channel>
+    struct Perlin {
+        unsigned int seed = 0;
+        float operator()(float x, float z) const;
+    };
+    // Smoothed value noise with cosine interpolation
+    struct Value {
+        unsigned int seed = 0;
+        float operator()(float x, float z) const;
+    };
+    // 1 - |n|: sharp crests wherever the base noise crosses zero
+    template <typename Base>
+    struct Ridged {
+        Base base;
+        float operator()(float x, float z) const;
+    };
+    // |n|: rounded, puffy bumps
+    template <typename Base>
+    struct Billow {
+        Base base;
+        float operator()(float x, float z) const;
+    };
+    // The base noise sampled at a point pushed around
+    // by two more samples of itself
+    template <typename Base>
+    struct Warped {
+        Base base;
+        float strength = 4.f;
+        float operator()(float x, float z) const;
+    };
+
+    // Fractal Brownian motion: Octaves layers of noise, each at twice the
+    // frequency of the one before and persistence times its amplitude.
+    // The octave loop is expanded at compile time. Defined below, so that
+    // it can be used with any basis and number of octaves, and inlined into
+    // its caller, from any file.
+    template <typename Noise, int Octaves = 8>
+    static float fbm2D(float x, float z, float persistence, const Noise &noise = Noise());
+
+    // A stream of random numbers for the choices made while decorating,
+    // drawn from the same integer hash as the noise. Unlike the <random>
+    // distributions, which each standard library implements its own way,
+    // the same seed gives the same numbers everywhere.
+    struct Random {
+        unsigned int seed = 0;
+        // How many numbers have been drawn. The next one is
+        // a hash of this and the seed.
+        unsigned int count = 0;
+
+        // Uniform over all 32 bit values
+        unsigned int next();
+        // Uniform over [lo, hi]
+        int nextInt(int lo, int hi);
+        // Uniform over [0, 1)
+        float nextFloat();
+    };
 
 private:
-    static float grasslands(float x, float z);
-    static float mountains(float x, float z);
-    static float desert(float x, float z);
+    // The noises that decide how much of each biome a column gets
+    struct BiomeSelectors {
+        float perlin, desPerlin;
+    };
+    // The selectors evaluated exactly at (x, z), a corner of the
+    // BIOME_CELL lattice
+    static BiomeSelectors biomeSelectorsAt(int x, int z, unsigned int seed);
+    // Bilinear interpolation between the selectors at the corners of a
+    // cell, in the order (0, 0), (1, 0), (0, 1), (1, 1). tx and tz are the
+    // column's position in the cell, from 0 up to 1.
+    static BiomeSelectors interpolateSelectors(const BiomeSelectors corners[4], float tx, float tz);
+
+    // How much of the mountain and desert layers a column gets, from 0
+    // to 1. Exactly 0 or 1 over most of the world.
+    struct BiomeWeights {
+        float mountains, desert;
+    };
+    static BiomeWeights biomeWeights(BiomeSelectors);
+    // Whether a layer has any weight in the blend, i.e. whether
+    // it has to be evaluated at all
+    static bool needsGrasslands(BiomeWeights);
+    static bool needsMountains(BiomeWeights);
+    static bool needsDesert(BiomeWeights);
+
+    // The last step of getHeight(), shared with getHeights() so that
+    // both round the same way. Layers without weight can be passed as
+    // anything finite.
+    static int blendBiomes(float grass, float mtn, float des, BiomeWeights);
+
+    // fbm2D<Perlin<channel>>(x[i], z[i], persistence) for
+    // CHUNK_COLUMNS points at once
+    static void fbm2DBatch(const float *x, const float *z, float persistence,
+                           unsigned int seed, int channel, float *out);
+    // worleyNoise(x[i], z[i]) for CHUNK_COLUMNS points at once
+    static void worleyNoiseBatch(const float *x, const float *z, unsigned int seed, float *out);
+
+    template <typename Noise, int... Octave>
+    static float fbmOctaves(float x, float z, float persistence, const Noise &noise,
+                            std::integer_sequence<int, Octave...>);
 
-    static float worleyNoise(float x, float z);
-    static glm::vec2 voronoiCenter(glm::vec2);
+    static float grasslands(float x, float z, unsigned int seed);
+    static float mountains(float x, float z, unsigned int seed);
+    static float desert(float x, float z, unsigned int seed);
 
-    static float perlinNoise2D(glm::vec2, int);
-    static float surflet(glm::vec2, glm::vec2, int);
-    static glm::vec2 noise2DNormalVector(glm::vec2, int);
+    static float worleyNoise(float x, float z, unsigned int seed);
+    static glm::vec2 voronoiCenter(int x, int z, unsigned int seed);
 
-    static float interpNoise2D(float x, float z);
-    static float smoothNoise2D(float x, float z);
-    static float noise2D(float x, float z);
-    static float noise1D(float x);
+    // Mixes every bit of the lattice point and the seed into every bit
+    // of the result. Integer only, so it gives the same answer with any
+    // compiler and at any distance from the origin.
+    static unsigned int hash2D(int x, int z, unsigned int seed);
+    // The seed of one noise channel, so that channels are uncorrelated
+    static unsigned int channelSeed(unsigned int seed, int channel);
+
+    static unsigned int hash3D(int x, int y, int z, unsigned int seed);
+
+    // The cave noise at a corner of the cave lattice, in [-1, 1]
+    static float caveSample(int x, int y, int z, unsigned int seed);
+    // caveSample() at the (16 / CAVE_CELL_XZ + 1)^2 lattice corners
+    // at height y over the footprint with its corner at (x, z)
+    static void caveLayer(int x, int y, int z, unsigned int seed, float *out);
+    static bool solidAt(int height, int y, float caveNoise);
+
+    static float perlinNoise3D(glm::vec3, unsigned int seed);
+    // One of the twelve edge directions of a cube
+    static glm::vec3 latticeGradient3D(int x, int y, int z, unsigned int seed);
+
+    static float perlinNoise2D(glm::vec2, unsigned int seed);
+    static float surflet(glm::vec2, glm::vec2, unsigned int seed);
+    // One of eight unit gradients, picked by hashing the lattice point
+    static glm::vec2 latticeGradient(int x, int z, unsigned int seed);
+
+    static float interpNoise2D(float x, float z, unsigned int seed);
+    static float smoothNoise2D(float x, float z, unsigned int seed);
+    // A value in [-1, 1) for the lattice point (x, z)
+    static float noise2D(float x, float z, unsigned int seed);
 
     static float cosineInterp(float a, float b, float t);
     static float linearInterp(float a, float b, float t);
+    // Between the corners of a cube, indexed dx + 2 * dy + 4 * dz
+    static float trilinearInterp(const float corners[8], float tx, float ty, float tz);
 };
+
+template <typename Noise, int Octaves>
+float ProcGen::fbm2D(float x, float z, float persistence, const Noise &noise) {
+    return fbmOctaves(x, z, persistence, noise, std::make_integer_sequence<int, Octaves>());
+}
+
+template <typename Noise, int... Octave>
+float ProcGen::fbmOctaves(float x, float z, float persistence, const Noise &noise,
+                          std::integer_sequence<int, Octave...>) {
+    float total = 0;
+    // Kept in double and rounded once per octave, which gives
+    // the same amplitudes as pow(persistence, i)
+    double amplitude = 1;
+
+    // One copy of the body per octave, in order
+    ((total += noise(x * (1 << Octave), z * (1 << Octave)) * static_cast<float>(amplitude),
+      amplitude *= persistence), ...);
+
+    return total;
+}
+
+template <int Channel>
+float ProcGen::Perlin<Channel>::operator()(float x, float z) const {
+    return perlinNoise2D(glm::vec2(x, z), channelSeed(seed, Channel));
+}
+
+template <typename Base>
+float ProcGen::Ridged<Base>::operator()(float x, float z) const {
+    return 1.f - glm::abs(base(x, z));
+}
+
+template <typename Base>
+float ProcGen::Billow<Base>::operator()(float x, float z) const {
+    return glm::abs(base(x, z));
+}
+
+template <typename Base>
+float ProcGen::Warped<Base>::operator()(float x, float z) const {
+    // Arbitrary offsets so the two warp samples are uncorrelated
+    float warpX = base(x + 5.2f, z + 1.3f);
+    float warpZ = base(x + 1.7f, z + 9.2f);
+    return base(x + strength * warpX, z + strength * warpZ);
+}
@@ -27,6 +27,6 @@ void Quad::create()
     mp_context->glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec4), vert_pos, GL_STATIC_DRAW);
 
     generateUV();
-    mp_context->glBindBuffer(GL_ARRAY_BUFFER, m_bufUV);
+    mp_context->bindBuffer(GL_ARRAY_BUFFER, m_bufUV);
     mp_context->glBufferData(GL_ARRAY_BUFFER, 4 * sizeof(glm::vec2), vert_UV, GL_STATIC_DRAW);
 }
@@ -2,37 +2,37 @@
 #include "river.h"
 
 River::River(vec2 position, vec2 orientation, float distance,
-             QString axiom, int iterations, float branchProbability)
-    : m_turtle(Turtle(position, orientation, distance))
+             const std::string &axiom, int iterations, float branchProbability,
+             unsigned int seed)
+    : m_turtle(Turtle(position, orientation, distance)), m_rng{seed}
 {
     setUpRules();
-    // expand axiom for branching
+    // expand axiom for branching, one pass over the whole string per
+    // iteration, appending to a buffer that only grows once or twice
+    std::string path = axiom;
+    std::string expanded;
     for (int i = 0; i < iterations; i++) {
-        for (auto rule = m_branchRules.begin(); rule != m_branchRules.end(); rule++) {
-            vector<int> indices;
-            for (int k = 0; k < axiom.length(); k++) {
-                if (axiom[k] == rule.key()) {
-                    indices.push_back(k);
-                }
-            }
-            int offset = 0;
-            for (unsigned int k = 0; k < indices.size(); k++) {
+        expanded.clear();
+        expanded.reserve(path.size() * 4);
+        for (char c : path) {
+            const std::string &rule = m_branchRules[static_cast<unsigned char>(c) & 127];
+            if (rule.empty()) {
+                expanded += c;
+            } else if (random() < branchProbability) {
                 // random branching + expansion
-                if (linearRand(0.f, 1.f) < branchProbability) {
-                    axiom.replace(indices[k] + offset, 1, rule.value());
-                    offset += rule.value().length() - 1;
-                } else {
-                    axiom.replace(indices[k] + offset, 1, "-FFFFF");
-                    offset += 5;
-                }
+                expanded += rule;
+            } else {
+                expanded += "-FFFFF";
             }
         }
+        path.swap(expanded);
     }
-    m_path = axiom;
+    m_path = path;
 }
 
 // helper
 void River::setUpRules() {
+    m_charToDrawingOperation.fill(nullptr);
     m_branchRules['X'] = "[+FFGGX]-FFGGX";
 
     m_charToDrawingOperation['F'] = &River::moveForwardCurveLeft;
@@ -45,31 +45,43 @@ void River::setUpRules() {
 }
 
 // turtle functions
+void River::draw(char c) {
+    Rule rule = m_charToDrawingOperation[static_cast<unsigned char>(c) & 127];
+    if (rule) {
+        (this->*rule)();
+    }
+}
+
 void River::savePos() {
-    m_turtleStack.push(Turtle(m_turtle));
+    m_turtleStack.push_back(Turtle(m_turtle));
     m_turtle.m_depth++;
 }
 
 void River::loadPos() {
-    m_turtle = m_turtleStack.pop();
+    m_turtle = m_turtleStack.back();
+    m_turtleStack.pop_back();
 }
 
 void River::moveForwardCurveRight() {
-    m_turtle.rotateRight(10.f);
+    m_turtle.rotateRight(random() * PI / 10.f);
     m_turtle.moveForward();
 }
 
 void River::moveForwardCurveLeft() {
-    m_turtle.rotateLeft(10.f);
+    m_turtle.rotateLeft(random() * PI / 10.f);
     m_turtle.moveForward();
 }
 
 void River::rotateRight() {
-    m_turtle.rotateRight(5.f);
+    m_turtle.rotateRight(random() * PI / 5.f);
 }
 
 void River::rotateLeft() {
-    m_turtle.rotateLeft(5.f);
+    m_turtle.rotateLeft(random() * PI / 5.f);
 }
 
 void River::X() {}
+
+float River::random() {
+    return m_rng.nextFloat();
+}
@@ -3,15 +3,14 @@
 
 #pragma once
 
-#include <QString>
-#include <QChar>
-#include <QHash>
-#include <QStack>
+#include <array>
+#include <string>
+#include <vector>
 #include <glm/common.hpp>
 #include <glm/gtx/transform.hpp>
-#include <glm/gtc/random.hpp>
 #include <iostream>
 #include "turtle.h"
+#include "procgen.h"
 
 using namespace std;
 using namespace glm;
@@ -22,18 +21,26 @@ public:
     typedef void (River::*Rule)(void);
 
     // member vars
-    QString m_path;
+    std::string m_path;
     Turtle m_turtle;
-    QStack<Turtle> m_turtleStack;
-    QHash<QChar, QString> m_branchRules;
-    QHash<QChar, Rule> m_charToDrawingOperation;
+    std::vector<Turtle> m_turtleStack;
+    // Both indexed by character. A character with no rule
+    // has an empty string and a null operation.
+    std::array<std::string, 128> m_branchRules;
+    std::array<Rule, 128> m_charToDrawingOperation;
+    // Every random choice the river makes comes from here, so
+    // the same seed always grows the same river
+    ProcGen::Random m_rng;
 
     // constructor
     River(vec2 position, vec2 orientation, float distance,
-          QString axiom, int iterations, float branchProbability);
+          const std::string &axiom, int iterations, float branchProbability,
+          unsigned int seed);
 
     // functions
     void setUpRules();
+    // Runs the drawing operation for one character of m_path
+    void draw(char c);
     void savePos();
     void loadPos();
     void moveForwardCurveRight();
@@ -41,6 +48,9 @@ public:
     void rotateRight();
     void rotateLeft();
     void X();
+
+    // uniform in [0, 1)
+    float random();
 };
 
 #endif // RIVER_H
@@ -0,0 +1,119 @@
+#include "rivernetwork.h"
+#include "river.h"
+
+RiverNetwork::RiverNetwork(unsigned int seed)
+    : m_seed(seed), m_regionsMutex(), m_regions()
+{}
+
+int64_t RiverNetwork::key(int x, int z) {
+    return (static_cast<int64_t>(x) << 32) | static_cast<uint32_t>(z);
+}
+
+glm::ivec2 RiverNetwork::regionOf(glm::ivec2 pos) {
+    return glm::ivec2(static_cast<int>(glm::floor(pos.x / static_cast<float>(REGION_SIZE))),
+                      static_cast<int>(glm::floor(pos.y / static_cast<float>(REGION_SIZE))));
+}
+
+std::vector<RiverSegment> RiverNetwork::segmentsIn(glm::ivec2 chunkPos) {
+    glm::ivec2 home = regionOf(chunkPos);
+
+    std::vector<RiverSegment> segments;
+    for (int dx = -1; dx <= 1; dx++) {
+        for (int dz = -1; dz <= 1; dz++) {
+            sPtr<const Region> region = regionAt(home + glm::ivec2(dx, dz));
+            auto found = region->chunks.find(key(chunkPos.x, chunkPos.y));
+            if (found != region->chunks.end()) {
+                segments.insert(segments.end(), found->second.begin(), found->second.end());
+            }
+        }
+    }
+    return segments;
+}
+
+void RiverNetwork::evictOutside(glm::ivec2 lo, glm::ivec2 hi) {
+    // segmentsIn() looks at the regions around a Chunk's own
+    glm::ivec2 keepLo = regionOf(lo) - glm::ivec2(1);
+    glm::ivec2 keepHi = regionOf(hi) + glm::ivec2(1);
+
+    std::lock_guard<std::mutex> lock(m_regionsMutex);
+    for (auto it = m_regions.begin(); it != m_regions.end();) {
+        glm::ivec2 region(static_cast<int>(it->first >> 32), static_cast<int>(it->first & 0xffffffff));
+        if (glm::any(glm::lessThan(region, keepLo)) || glm::any(glm::greaterThan(region, keepHi))) {
+            it = m_regions.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+sPtr<const RiverNetwork::Region> RiverNetwork::regionAt(glm::ivec2 region) {
+    int64_t k = key(region.x, region.y);
+    {
+        std::lock_guard<std::mutex> lock(m_regionsMutex);
+        auto found = m_regions.find(k);
+        if (found != m_regions.end()) {
+            return found->second;
+        }
+    }
+
+    // Grown without the lock, so workers asking about other regions
+    // don't wait on this one. If two threads race to grow the same
+    // region they grow identical ones, and the first to finish wins.
+    uPtr<Region> grown = growRegion(region);
+
+    std::lock_guard<std::mutex> lock(m_regionsMutex);
+    auto inserted = m_regions.emplace(k, std::move(grown));
+    return inserted.first->second;
+}
+
+uPtr<RiverNetwork::Region> RiverNetwork::growRegion(glm::ivec2 region) const {
+    uPtr<Region> result = mkU<Region>();
+
+    ProcGen::Random rng{m_seed ^ (static_cast<unsigned int>(region.x) * 2654435761u)
+                               ^ (static_cast<unsigned int>(region.y) * 2246822519u)};
+
+    // About two regions in three have a river
+    if (rng.nextInt(0, 2) == 0) {
+        return result;
+    }
+    float sourceX = rng.nextFloat();
+    float sourceZ = rng.nextFloat();
+    glm::vec2 source = glm::vec2(region) * static_cast<float>(REGION_SIZE)
+                     + glm::vec2(sourceX, sourceZ) * static_cast<float>(REGION_SIZE);
+    float heading = rng.nextFloat() * 2.f * PI;
+
+    River river = River(source, vec2(glm::cos(heading), glm::sin(heading)), 8.f, "FFGGGX", 2, 0.8f, rng.next());
+    for (char c : river.m_path) {
+        vec2 start = river.m_turtle.m_position;
+        river.draw(c);
+        vec2 end = river.m_turtle.m_position;
+
+        if (c != 'F' && c != 'G') {
+            continue;
+        }
+        // calc radius
+        int radius = 2;
+        if (river.m_turtle.m_depth < 5) {
+            radius = (5 - river.m_turtle.m_depth);
+        }
+
+        glm::vec2 lo = glm::min(start, end) - glm::vec2(radius);
+        glm::vec2 hi = glm::max(start, end) + glm::vec2(radius);
+        if (glm::any(glm::greaterThan(glm::abs(lo - source), glm::vec2(REGION_SIZE)))
+                || glm::any(glm::greaterThan(glm::abs(hi - source), glm::vec2(REGION_SIZE)))) {
+            continue;
+        }
+
+        // File the segment under every Chunk its widened bounds touch
+        int x0 = static_cast<int>(glm::floor(lo.x / 16.f)) * 16;
+        int x1 = static_cast<int>(glm::floor(hi.x / 16.f)) * 16;
+        int z0 = static_cast<int>(glm::floor(lo.y / 16.f)) * 16;
+        int z1 = static_cast<int>(glm::floor(hi.y / 16.f)) * 16;
+        for (int x = x0; x <= x1; x += 16) {
+            for (int z = z0; z <= z1; z += 16) {
+                result->chunks[key(x, z)].push_back({start, end, radius});
+            }
+        }
+    }
+    return result;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "glm_includes.h"
+#include <cstdint>
+#include "smartpointerhelp.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// One straight stretch of a river's path, as drawn by its turtle
+struct RiverSegment {
+    glm::vec2 start, end;
+    int radius;
+};
+
+// Every river in the world. The world is divided into square regions, and
+// each region may be the source of one river, grown from the world seed and
+// the region's coordinates alone. Regions are grown the first time a Chunk
+// near them asks for its segments, and kept until evictOutside() drops
+// them. A dropped region is grown again, identically, if it is needed.
+//
+// Each region files its segments under every Chunk they overlap, so a
+// Chunk only ever looks at the few segments that can touch it.
+//
+// A river is cut short wherever it strays more than REGION_SIZE from its
+// source, in x or z, so that a Chunk only has to look at the 3 x 3 regions
+// around its own. Every segment that reaches past that line is dropped,
+// so a river that wanders that far ends abruptly at the edge of the square
+// around its source, and may start again where it wanders back inside.
+//
+// Only rivers: there are no roads.
+//
+// Safe to use from any number of threads at once.
+class RiverNetwork {
+public:
+    // Side of one region, in blocks. A multiple of 16.
+    static const int REGION_SIZE = 256;
+
+    RiverNetwork(unsigned int seed);
+
+    RiverNetwork(const RiverNetwork&) = delete;
+    RiverNetwork& operator=(const RiverNetwork&) = delete;
+
+    // Every segment, widened by its radius, that overlaps the
+    // Chunk with its corner at chunkPos
+    std::vector<RiverSegment> segmentsIn(glm::ivec2 chunkPos);
+    // Drops every region that no Chunk overlapping the blocks from lo
+    // to hi, inclusive, would look at. Threads still reading a dropped
+    // region keep it alive until they are done with it.
+    void evictOutside(glm::ivec2 lo, glm::ivec2 hi);
+
+private:
+    // A region's segments, by the Chunk they overlap
+    struct Region {
+        std::unordered_map<int64_t, std::vector<RiverSegment>> chunks;
+    };
+
+    // Grows the river that starts in the region, if it has one, and
+    // drops any part of it that strays more than REGION_SIZE from its
+    // source. That keeps every segment inside the 3 x 3 regions around
+    // its own, which is all segmentsIn() looks at.
+    uPtr<Region> growRegion(glm::ivec2 region) const;
+    sPtr<const Region> regionAt(glm::ivec2 region);
+    // The region that the block at pos lies in
+    static glm::ivec2 regionOf(glm::ivec2 pos);
+
+    static int64_t key(int x, int z);
+
+    unsigned int m_seed;
+
+    std::mutex m_regionsMutex;
+    // Shared with the threads reading each region, so evictOutside()
+    // can erase one while a thread is still looking at its segments
+    std::unordered_map<int64_t, sPtr<const Region>> m_regions;
+};
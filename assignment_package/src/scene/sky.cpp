@@ -0,0 +1,101 @@
+#include "sky.h"
+
+Sky::Sky(OpenGLContext *context)
+    : mp_context(context), m_map(context, 1, 1, 1), m_quality(MEDIUM),
+      m_mapQuality(FULL), m_mapFilled(false), m_nextBand(0)
+{}
+
+Sky::Settings Sky::settings(Quality quality) {
+    switch (quality) {
+    case HIGH: return {512, 256, 1};
+    case MEDIUM: return {256, 128, 2};
+    case LOW: return {128, 64, 4};
+    default: return {0, 0, 0};
+    }
+}
+
+void Sky::create() {
+    if (m_quality == FULL) {
+        return;
+    }
+    Settings s = settings(m_quality);
+    m_map.resize(s.width, s.height, 1);
+    m_map.create();
+    // The map is much smaller than the screen, so blend between its texels
+    m_map.setFilter(GL_LINEAR);
+    // and across the seam where the map's u wraps around
+    m_map.setWrap(GL_REPEAT, GL_CLAMP_TO_EDGE);
+    m_mapQuality = m_quality;
+    m_mapFilled = false;
+    m_nextBand = 0;
+}
+
+void Sky::destroy() {
+    if (m_mapQuality != FULL) {
+        m_map.destroy();
+        m_mapQuality = FULL;
+    }
+}
+
+void Sky::setQuality(Quality quality) {
+    // Can't touch GL from here, so draw() remakes the map
+    m_quality = quality;
+}
+
+Sky::Quality Sky::quality() const {
+    return m_quality;
+}
+
+const char* Sky::qualityName(Quality quality) {
+    switch (quality) {
+    case FULL: return "full";
+    case HIGH: return "high";
+    case MEDIUM: return "medium";
+    case LOW: return "low";
+    default: return "";
+    }
+}
+
+void Sky::updateMap(ShaderProgram &program, Quad &quad, glm::ivec2 viewport) {
+    Settings s = settings(m_quality);
+    int rows = (s.height + s.bands - 1) / s.bands;
+    int first = m_mapFilled ? m_nextBand * rows : 0;
+    int count = m_mapFilled ? rows : s.height;
+
+    m_map.bindFrameBuffer();
+    mp_context->glViewport(0, 0, s.width, s.height);
+    mp_context->enable(GL_SCISSOR_TEST);
+    mp_context->glScissor(0, first, s.width, count);
+    // The map has no use for depth
+    mp_context->disable(GL_DEPTH_TEST);
+
+    program.overlayType(RENDER_MAP);
+    program.setDimensions(glm::ivec2(s.width, s.height));
+    program.draw(quad);
+
+    mp_context->enable(GL_DEPTH_TEST);
+    mp_context->disable(GL_SCISSOR_TEST);
+    mp_context->glBindFramebuffer(GL_FRAMEBUFFER, mp_context->defaultFramebufferObject());
+    mp_context->glViewport(0, 0, viewport.x, viewport.y);
+
+    m_nextBand = m_mapFilled ? (m_nextBand + 1) % s.bands : 0;
+    m_mapFilled = true;
+}
+
+void Sky::draw(ShaderProgram &program, Quad &quad, glm::ivec2 viewport, int textureSlot) {
+    if (m_quality == FULL) {
+        destroy();
+        program.overlayType(NOISE_PER_PIXEL);
+    } else {
+        if (m_mapQuality != m_quality) {
+            destroy();
+            create();
+        }
+        updateMap(program, quad, viewport);
+        m_map.bindToTextureSlot(textureSlot);
+        program.setTextureSlot(textureSlot);
+        program.overlayType(NOISE_FROM_MAP);
+    }
+    program.setDimensions(viewport);
+    program.draw(quad);
+}
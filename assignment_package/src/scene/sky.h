@@ -0,0 +1,67 @@
+#pragma once
+#include "framebuffer.h"
+#include "shaderprogram.h"
+#include "quad.h"
+
+// Draws the sky with sky.frag.glsl. Nearly all of that shader's time goes
+// into the Worley noise that shapes the clouds, which depends only on the
+// direction looked in and on the time, and changes slowly with the latter.
+// So instead of evaluating it for every pixel, the sky renders it into a
+// small map over every direction, and the full-screen pass reads it back
+// from there. The colors and the sun are still worked out for every pixel.
+//
+// The map is refreshed a band of rows at a time, so that a frame only
+// pays for a fraction of it. The map's size and the number of bands are
+// set by the quality, which can also turn the map off altogether.
+class Sky {
+public:
+    enum Quality {
+        FULL,   // The noise for every pixel, as before
+        HIGH,   // 512 x 256 map, all of it every frame
+        MEDIUM, // 256 x 128 map, half of it every frame
+        LOW,    // 128 x 64 map, a quarter of it every frame
+        QUALITY_COUNT
+    };
+
+    Sky(OpenGLContext *context);
+
+    // Creates the map if the quality needs one. Needs the GL context.
+    void create();
+    void destroy();
+
+    // Takes effect at the next draw()
+    void setQuality(Quality quality);
+    Quality quality() const;
+    static const char* qualityName(Quality quality);
+
+    // Draws the sky over the whole viewport, which is in pixels. The
+    // program's view-projection, eye and time must already be set. The
+    // map is read through textureSlot.
+    void draw(ShaderProgram &program, Quad &quad, glm::ivec2 viewport, int textureSlot);
+
+private:
+    // What sky.frag.glsl does, by u_Mode
+    enum Mode {
+        NOISE_PER_PIXEL = 0,
+        NOISE_FROM_MAP = 1,
+        RENDER_MAP = 2
+    };
+
+    struct Settings {
+        int width, height;
+        int bands;
+    };
+    static Settings settings(Quality quality);
+
+    // Renders the next band of the map, or all of it if it is new
+    void updateMap(ShaderProgram &program, Quad &quad, glm::ivec2 viewport);
+
+    OpenGLContext *mp_context;
+    FrameBuffer m_map;
+    Quality m_quality;
+    // The quality m_map was made for, FULL if there is none
+    Quality m_mapQuality;
+    // Whether every band of m_map has been rendered
+    bool m_mapFilled;
+    int m_nextBand;
+};
@@ -6,10 +6,45 @@
 
 #include <thread>
 #include <mutex>
+#include <random>
+
+Terrain::Terrain(OpenGLContext *context, unsigned int seed, GenerationMode mode, const std::string &storeDir)
+    : m_arena(context), m_epochs(),
+      m_chunks(m_epochs, [](Chunk *chunk) {
+          // Runs from checkThreadResults(), on the thread that owns the GL context
+          chunk->destroy();
+          delete chunk;
+      }),
+      m_generatedTerrain(), mp_context(context),
+      m_loadZones(5), m_lastLoadZones(5), m_occlusionCulling(true), m_multiDraw(true),
+      m_depthPrePass(false), m_opaqueFragments(context), m_worldGen(seed, mode), m_store(storeDir),
+      m_generation(), m_meshing()
+{
+    m_store.open(seed, mode, ChunkStore::READ_ONLY);
+    setUpPipelines();
+}
 
-Terrain::Terrain(OpenGLContext *context)
-    : m_chunks(), m_generatedTerrain(), mp_context(context)
-{}
+void Terrain::setUpPipelines() {
+    // Noise and meshing are the expensive stages,
+    // so they get a bigger share of the cores
+    int cores = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+    int heavyWorkers = cores / 4;
+
+    m_generation.addStage("heightmap", heavyWorkers, [this](Chunk *c) { generateHeightMap(c); });
+    if (m_worldGen.mode() == DENSITY_TERRAIN) {
+        // Samples 3D noise, so it is as heavy as the height map
+        m_generation.addStage("density", heavyWorkers, [this](Chunk *c) { generateSurface(c); });
+    } else {
+        m_generation.addStage("surface", 1, [this](Chunk *c) { generateSurface(c); });
+    }
+    m_generation.addStage("carving", 1, [this](Chunk *c) { generateCarving(c); });
+    m_generation.addStage("features", 1, [this](Chunk *c) { generateFeatures(c); });
+    m_generation.addStage("max height", 1, [this](Chunk *c) { computeMaxHeight(c); });
+
+    m_meshing.addStage("meshing", heavyWorkers, [this](Chunk *c) { generateMesh(c); });
+    // No workers, so it runs when checkThreadResults() pumps it
+    m_meshing.addStage("upload", 0, [this](Chunk *c) { uploadMesh(c); });
+}
 
 Terrain::~Terrain() {
 }
@@ -49,13 +84,14 @@ glm::ivec2 toCoords(int64_t k) {
 // Surround calls to this with try-catch if you don't know whether
 // the coordinates at x, y, z have a corresponding Chunk
 BlockType Terrain::getBlockAt(int x, int y, int z) const {
+    EpochManager::Guard guard(m_epochs);
     if (hasChunkAt(x, z)) {
         // Just disallow action below or above min/max height,
         // but don't crash the game over it.
         if(y < 0 || y >= 256) {
             return EMPTY;
         }
-        const uPtr<Chunk> &c = getChunkAt(x, z);
+        const Chunk *c = findChunkAt(x, z);
         glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
         return c->getBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
                              static_cast<unsigned int>(y),
@@ -73,45 +109,20 @@ BlockType Terrain::getBlockAt(glm::vec3 p) const {
 }
 
 bool Terrain::hasChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-
-    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor)) != m_chunks.end();
-}
-
-bool Terrain::hasNewChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-
-    return newChunks.find(toKey(16 * xFloor, 16 * zFloor)) != newChunks.end();
-}
-
-uPtr<Chunk>& Terrain::getChunkAt(int x, int z) {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-
-    return m_chunks[toKey(16 * xFloor, 16 * zFloor)];
-}
-
-const uPtr<Chunk>& Terrain::getChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-
-    return m_chunks.at(toKey(16 * xFloor, 16 * zFloor));
+    EpochManager::Guard guard(m_epochs);
+    Chunk *c = findChunkAt(x, z);
+    return c != nullptr && c->getState() >= BLOCKS_READY;
 }
 
-uPtr<Chunk>& Terrain::getNewChunkAt(int x, int z) {
+Chunk* Terrain::findChunkAt(int x, int z) const {
     int xFloor = static_cast<int>(glm::floor(x / 16.f));
     int zFloor = static_cast<int>(glm::floor(z / 16.f));
 
-    return newChunks[toKey(16 * xFloor, 16 * zFloor)];
+    return m_chunks.find(toKey(16 * xFloor, 16 * zFloor));
 }
 
-const uPtr<Chunk>& Terrain::getNewChunkAt(int x, int z) const {
-    int xFloor = static_cast<int>(glm::floor(x / 16.f));
-    int zFloor = static_cast<int>(glm::floor(z / 16.f));
-
-    return newChunks.at(toKey(16 * xFloor, 16 * zFloor));
+EpochManager& Terrain::epochs() const {
+    return m_epochs;
 }
 
 bool Terrain::hasTerrainGenerationZoneAt(glm::ivec2 zone) {
@@ -156,153 +167,301 @@ std::vector<glm::ivec2> diffVectors(std::vector<glm::ivec2> a, std::vector<glm::
     return diff;
 }
 
-void Terrain::tryExpansion(glm::vec3 currPlayerPos, glm::vec3 prevPlayerPos) {
+bool Terrain::tryExpansion(glm::vec3 currPlayerPos, glm::vec3 prevPlayerPos) {
+    std::unique_lock<std::mutex> lock(m_streamingMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return false;
+    }
+
     glm::ivec2 currZone = glm::ivec2(glm::floor(currPlayerPos.x / 64.f) * 64.f,
                                      glm::floor(currPlayerPos.z / 64.f) * 64.f);
     glm::ivec2 prevZone = glm::ivec2(glm::floor(prevPlayerPos.x / 64.f) * 64.f,
                                      glm::floor(prevPlayerPos.z / 64.f) * 64.f);
 
-    std::vector<glm::ivec2> currTGZs = getTerrainGenerationZonesAround(currZone, 5);
-    std::vector<glm::ivec2> prevTGZs = getTerrainGenerationZonesAround(prevZone, 5);
+    int n = m_loadZones;
+    std::vector<glm::ivec2> currTGZs = getTerrainGenerationZonesAround(currZone, n);
+    std::vector<glm::ivec2> prevTGZs = getTerrainGenerationZonesAround(prevZone, m_lastLoadZones);
 
-    std::vector<glm::ivec2> newZones = firstTick ? currTGZs : diffVectors(prevTGZs, currTGZs);
+    // A grid that grew brings zones into range without the player moving,
+    // so every zone in it is checked
+    bool resized = n != m_lastLoadZones;
+    std::vector<glm::ivec2> newZones = firstTick || resized ? currTGZs : diffVectors(prevTGZs, currTGZs);
     std::vector<glm::ivec2> oldZones = diffVectors(currTGZs, prevTGZs);
 
+    m_lastLoadZones = n;
+
+    evictDistantZones(currZone, n + EVICTION_MARGIN);
+
+    std::vector<std::pair<int64_t, uPtr<Chunk>>> instantiated;
+    std::vector<Chunk*> newChunks;
+
     for (glm::ivec2 newZone : newZones) {
         if (!hasTerrainGenerationZoneAt(newZone)) {
             m_generatedTerrain.insert(toKey(newZone.x, newZone.y));
 
             for (int x = 0; x < 64; x += 16) {
                 for (int z = 0; z < 64; z += 16) {
-                    newChunks[toKey(newZone.x + x, newZone.y + z)] = instantiateChunkAt(newZone.x + x, newZone.y + z);
+                    uPtr<Chunk> chunk = instantiateChunkAt(newZone.x + x, newZone.y + z);
+                    newChunks.push_back(chunk.get());
+                    instantiated.push_back({toKey(newZone.x + x, newZone.y + z), move(chunk)});
                 }
             }
         }
     }
 
+    // Publish the whole batch at once so that readers see either
+    // none or all of it
+    m_chunks.insert(instantiated);
 
-    for (auto & [ key, chunk ]: newChunks) {
+    // Link every new Chunk to whatever already exists around it, whether or
+    // not that neighbor has finished generating. The state machine decides
+    // when it is safe to read across the link.
+    for (Chunk *chunk : newChunks) {
         int x = chunk->getWorldPos().x;
         int z = chunk->getWorldPos().y;
 
-        if (hasChunkAt(x, z + 16)) {
-            auto &chunkNorth = getChunkAt(x, z + 16);
-            chunk->linkNeighbor(chunkNorth, ZPOS);
-        }
-        if (hasChunkAt(x, z - 16)) {
-            auto &chunkSouth = getChunkAt(x, z - 16);
-            chunk->linkNeighbor(chunkSouth, ZNEG);
-        }
-        if (hasChunkAt(x + 16, z)) {
-            auto &chunkEast = getChunkAt(x + 16, z);
-            chunk->linkNeighbor(chunkEast, XPOS);
-        }
-        if (hasChunkAt(x - 16, z)) {
-            auto &chunkWest = getChunkAt(x - 16, z);
-            chunk->linkNeighbor(chunkWest, XNEG);
-        }
+        chunk->linkNeighbor(findChunkAt(x, z + 16), ZPOS);
+        chunk->linkNeighbor(findChunkAt(x, z - 16), ZNEG);
+        chunk->linkNeighbor(findChunkAt(x + 16, z), XPOS);
+        chunk->linkNeighbor(findChunkAt(x - 16, z), XNEG);
+    }
 
-        if (hasNewChunkAt(x, z + 16)) {
-            auto &chunkNorth = getNewChunkAt(x, z + 16);
-            chunk->linkNeighbor(chunkNorth, ZPOS);
+    for (Chunk *chunk : newChunks) {
+        m_generation.submit(chunk);
+    }
+
+    firstTick = false;
+    return true;
+}
+
+void Terrain::evictDistantZones(glm::ivec2 currZone, int n) {
+    int halfWidth = glm::floor(n / 2.f) * 64;
+
+    std::vector<int64_t> evictedZones;
+    std::vector<int64_t> evictedChunks;
+
+    for (int64_t zoneKey : m_generatedTerrain) {
+        glm::ivec2 zone = toCoords(zoneKey);
+        if (glm::abs(zone.x - currZone.x) <= halfWidth && glm::abs(zone.y - currZone.y) <= halfWidth) {
+            continue;
         }
-        if (hasNewChunkAt(x, z - 16)) {
-            auto &chunkSouth = getNewChunkAt(x, z - 16);
-            chunk->linkNeighbor(chunkSouth, ZNEG);
+
+        // Chunks that a worker still has, that still have results waiting
+        // in one of our queues, or that a queued neighbor's mesh job will
+        // read, can't be evicted yet. We'll try again on a later tick.
+        bool idle = true;
+        for (int x = 0; x < 64 && idle; x += 16) {
+            for (int z = 0; z < 64 && idle; z += 16) {
+                Chunk *chunk = findChunkAt(zone.x + x, zone.y + z);
+                if (chunk != nullptr && !canEvict(*chunk)) {
+                    idle = false;
+                }
+            }
         }
-        if (hasNewChunkAt(x + 16, z)) {
-            auto &chunkEast = getNewChunkAt(x + 16, z);
-            chunk->linkNeighbor(chunkEast, XPOS);
+        if (!idle) {
+            continue;
         }
-        if (hasNewChunkAt(x - 16, z)) {
-            auto &chunkWest = getNewChunkAt(x - 16, z);
-            chunk->linkNeighbor(chunkWest, XNEG);
+
+        for (int x = 0; x < 64; x += 16) {
+            for (int z = 0; z < 64; z += 16) {
+                Chunk *chunk = findChunkAt(zone.x + x, zone.y + z);
+                if (chunk != nullptr) {
+                    chunk->unlinkNeighbors();
+                    evictedChunks.push_back(toKey(zone.x + x, zone.y + z));
+                }
+            }
         }
+        evictedZones.push_back(zoneKey);
     }
 
-    for (auto & [ key, chunk ]: newChunks) {
-        blockWorkerThreads.push_back(std::thread(&Terrain::blockWorker, this, move(chunk)));
+    // No mesh job can still read these Chunks' blocks, since canEvict()
+    // held them while any neighbor was queued or being meshed. The Guard
+    // that readers like Terrain::draw() hold keeps them alive until they
+    // are done.
+    m_chunks.erase(evictedChunks);
+    for (int64_t zoneKey : evictedZones) {
+        m_generatedTerrain.erase(zoneKey);
     }
-
-    newChunks.clear();
-    firstTick = false;
+    // Only keep the rivers that the zones around the player reach
+    m_worldGen.evictRiversOutside(currZone - glm::ivec2(halfWidth),
+                                  currZone + glm::ivec2(halfWidth + 63));
 }
 
 uPtr<Chunk> Terrain::instantiateChunkAt(int x, int z) {
-    uPtr<Chunk> chunk = mkU<Chunk>(mp_context);
+    uPtr<Chunk> chunk = mkU<Chunk>(mp_context, &m_arena);
     chunk.get()->setWorldPos(x, z);
 
     return chunk;
 }
 
-BlockType Terrain::generateBlockTypeByHeight(int height, bool isTop) {
+const WorldGen& Terrain::worldGen() const {
+    return m_worldGen;
+}
 
-    if (height < 120) {
-        return STONE;
+void Terrain::generateHeightMap(Chunk *chunk) {
+    if (m_store.load(chunk->getWorldPos(), chunk->m_heightMap.data(), chunk->blockData())) {
+        chunk->m_fromStore = true;
+        return;
     }
+    m_worldGen.generateHeightMap(chunk->getWorldPos(), chunk->m_heightMap.data());
+}
 
-    if (height < 128) {
-        return SAND;
+void Terrain::generateSurface(Chunk *chunk) {
+    if (chunk->m_fromStore) {
+        return;
     }
+    m_worldGen.generateSurface(chunk->getWorldPos(), chunk->m_heightMap.data(), chunk->blockData());
+}
 
-    if (height < 160) {
-        return isTop ? GRASS : DIRT;
+void Terrain::generateCarving(Chunk *chunk) {
+    if (chunk->m_fromStore) {
+        return;
     }
+    m_worldGen.generateCarving(chunk->getWorldPos(), chunk->blockData());
+}
 
-    if (height > 200) {
-        return isTop ? SNOW : STONE;
+void Terrain::generateFeatures(Chunk *chunk) {
+    if (chunk->m_fromStore) {
+        return;
     }
+    m_worldGen.generateFeatures(chunk->getWorldPos(), chunk->blockData());
+}
+
+void Terrain::computeMaxHeight(Chunk *chunk) {
+    // WorldGen writes the blocks directly, so nothing has tracked them yet
+    chunk->computeMaxHeight();
 
-    return STONE;
+    chunk->setState(BLOCKS_READY);
+
+    chunksWithBlockDataMutex.lock();
+    chunksWithBlockData.push_back(chunk);
+    chunksWithBlockDataMutex.unlock();
 }
 
-void Terrain::blockWorker(uPtr<Chunk> chunk) {
-    glm::ivec2 chunkWorldPos = chunk->getWorldPos();
+void Terrain::generateMesh(Chunk *chunk) {
+    // Nothing in our neighbor snapshot can be evicted before we are
+    // MESHED (see canEvict()), so no Guard is needed to read it.
+    // Built from a copy, so the player can edit blocks meanwhile
+    uPtr<ChunkMeshInput> input = mkU<ChunkMeshInput>();
+    {
+        std::shared_lock<std::shared_mutex> lock(m_blockEditMutex);
+        chunk->copyMeshInput(*input);
+    }
+    chunk->generateVBOData(*input);
+    chunk->setState(MESHED);
+}
 
-    for (int x = 0; x < 16; x++) {
-        for (int z = 0; z < 16; z++) {
-            int height = ProcGen::getHeight(chunkWorldPos.x + x, chunkWorldPos.y + z);
+void Terrain::uploadMesh(Chunk *chunk) {
+    chunk->destroy();
+    chunk->create();
+    chunk->setState(UPLOADED);
+    // Catch any remesh that was requested while we were meshing
+    tryScheduleMesh(chunk);
+}
 
-            for (int k = 0; k <= height; k++) {
-                chunk->setBlockAt(x, k, z, generateBlockTypeByHeight(height, k == height));
+void Terrain::checkThreadResults() {
+    std::lock_guard<std::mutex> lock(m_streamingMutex);
+
+    std::vector<Chunk*> blockResults;
+    chunksWithBlockDataMutex.lock();
+    blockResults.swap(chunksWithBlockData);
+    chunksWithBlockDataMutex.unlock();
+
+    // A Chunk that just got its blocks may be the last neighbor some other
+    // Chunk was waiting on. Any neighbor that was already meshed without it
+    // (i.e. it sat on the load frontier) baked in border faces that are now
+    // hidden, so it has to be meshed again.
+    std::vector<Chunk*> candidates;
+    for (Chunk *chunk : blockResults) {
+        candidates.push_back(chunk);
+        for (Direction dir : {XPOS, XNEG, ZPOS, ZNEG}) {
+            Chunk *neighbor = chunk->getNeighbor(dir);
+            if (neighbor == nullptr) {
+                continue;
             }
+            if (neighbor->getState() >= MESH_QUEUED) {
+                neighbor->m_needsRemesh = true;
+            }
+            candidates.push_back(neighbor);
         }
     }
+    for (Chunk *chunk : candidates) {
+        tryScheduleMesh(chunk);
+    }
 
-    chunksWithBlockDataMutex.lock();
-    chunksWithBlockData[toKey(chunk->getWorldPos().x, chunk->getWorldPos().y)] = move(chunk);
-    chunksWithBlockDataMutex.unlock();
+    // Runs the upload stage
+    m_meshing.pump();
+
+    // Free whatever evicted Chunks and old tables nobody can see anymore
+    m_epochs.collect();
 }
 
-void Terrain::checkThreadResults() {
-    chunksWithBlockDataMutex.lock();
-    for (auto & [ key, chunk ] : chunksWithBlockData) {
-        vboWorkerThreads.push_back(std::thread(&Terrain::VBOWorker, this, move(chunk)));
+void Terrain::tryScheduleMesh(Chunk *chunk) {
+    ChunkState state = chunk->getState();
+    bool firstMesh = state == BLOCKS_READY;
+    bool remesh = state == UPLOADED && chunk->m_needsRemesh;
+
+    if ((!firstMesh && !remesh) || !chunk->neighborsHaveBlockData()) {
+        return;
     }
-    chunksWithBlockData.clear();
-    chunksWithBlockDataMutex.unlock();
 
-    chunksWithVBODataMutex.lock();
-    for (auto & [ key, chunk ] : chunksWithVBOData) {
-        chunk->create();
-        m_chunks[key] = move(chunk);
+    chunk->snapshotNeighbors();
+    chunk->m_needsRemesh = false;
+    chunk->setState(MESH_QUEUED);
+    m_meshing.submit(chunk);
+}
+
+int Terrain::streamingBacklog() {
+    return m_generation.backlog() + m_meshing.backlog();
+}
+
+void Terrain::setLoadZones(int n) {
+    m_loadZones = n;
+}
+
+int Terrain::loadZones() const {
+    return m_loadZones;
+}
+
+std::vector<ChunkPipeline::StageMetrics> Terrain::pipelineMetrics() {
+    std::vector<ChunkPipeline::StageMetrics> metrics = m_generation.metrics();
+    for (const ChunkPipeline::StageMetrics &m : m_meshing.metrics()) {
+        metrics.push_back(m);
     }
-    chunksWithVBOData.clear();
-    chunksWithVBODataMutex.unlock();
+    return metrics;
 }
 
-void Terrain::VBOWorker(uPtr<Chunk> chunk) {
-    chunk->generateVBOData();
+void Terrain::requestRemesh(int x, int z) {
+    std::lock_guard<std::mutex> lock(m_streamingMutex);
+
+    Chunk *chunk = findChunkAt(x, z);
+    if (chunk == nullptr || chunk->getState() < BLOCKS_READY) {
+        return;
+    }
 
-    chunksWithVBODataMutex.lock();
-    chunksWithVBOData[toKey(chunk->getWorldPos().x, chunk->getWorldPos().y)] = move(chunk);
-    chunksWithVBODataMutex.unlock();
+    std::vector<Chunk*> dirty = {chunk};
+    int localX = x - chunk->getWorldPos().x;
+    int localZ = z - chunk->getWorldPos().y;
+    if (localX == 0) dirty.push_back(chunk->getNeighbor(XNEG));
+    if (localX == 15) dirty.push_back(chunk->getNeighbor(XPOS));
+    if (localZ == 0) dirty.push_back(chunk->getNeighbor(ZNEG));
+    if (localZ == 15) dirty.push_back(chunk->getNeighbor(ZPOS));
+
+    for (Chunk *c : dirty) {
+        if (c != nullptr && c->getState() >= MESH_QUEUED) {
+            c->m_needsRemesh = true;
+            tryScheduleMesh(c);
+        }
+    }
 }
 
 void Terrain::setBlockAt(int x, int y, int z, BlockType t) {
+    EpochManager::Guard guard(m_epochs);
     if (hasChunkAt(x, z)) {
-        uPtr<Chunk> &c = getChunkAt(x, z);
+        Chunk *c = findChunkAt(x, z);
         glm::vec2 chunkOrigin = glm::vec2(floor(x / 16.f) * 16, floor(z / 16.f) * 16);
+        // A meshing worker may be copying this Chunk, or its border
+        std::unique_lock<std::shared_mutex> lock(m_blockEditMutex);
         c->setBlockAt(static_cast<unsigned int>(x - chunkOrigin.x),
                       static_cast<unsigned int>(y),
                       static_cast<unsigned int>(z - chunkOrigin.y),
@@ -315,146 +474,257 @@ void Terrain::setBlockAt(int x, int y, int z, BlockType t) {
     }
 }
 
-void Terrain::draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram) {
-    chunksWithBlockDataMutex.lock();
+void Terrain::setOcclusionCulling(bool enabled) {
+    m_occlusionCulling = enabled;
+}
 
-    for(int x = minX; x < maxX; x += 16) {
-         for(int z = minZ; z < maxZ; z += 16) {
-             if (hasChunkAt(x, z)) {
-                 const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                 shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
-                 shaderProgram->drawOpq(*chunk);
-             }
-         }
-     }
-
-     for(int x = minX; x < maxX; x += 16) {
-         for(int z = minZ; z < maxZ; z += 16) {
-             if (hasChunkAt(x, z)) {
-                 const uPtr<Chunk> &chunk = getChunkAt(x, z);
-                 shaderProgram->setModelMatrix(glm::translate(glm::mat4(), glm::vec3(x, 0, z)));
-                 shaderProgram->drawTrans(*chunk);
-             }
-         }
-     }
+bool Terrain::occlusionCulling() const {
+    return m_occlusionCulling;
+}
 
-    chunksWithBlockDataMutex.unlock();
+void Terrain::setMultiDraw(bool enabled) {
+    m_multiDraw = enabled;
 }
 
-void Terrain::drawRiver() {
-    River river = River(vec2(12.f, 15.f), vec2(0.5f, 1.0f), 8.f, "FFGGGX", 2, 0.8f);
-    // draw river
-    for (int i = 0; i < river.m_path.length(); i++) {
-        vec2 start = river.m_turtle.m_position;
-        (river.*(river.m_charToDrawingOperation[river.m_path[i]]))();
-        vec2 end = river.m_turtle.m_position;
+bool Terrain::multiDraw() const {
+    return m_multiDraw;
+}
 
-        if (river.m_path[i] == 'F' || river.m_path[i] == 'G') {
-            int zMin = end[1];
-            if (start[1] <= end[1]) {
-                zMin = start[1];
-            }
+void Terrain::setDepthPrePass(bool enabled) {
+    m_depthPrePass = enabled;
+}
 
-            int zMax = start[1];
-            if (end[1] >= start[1]) {
-                zMax = end[1];
-            }
+bool Terrain::depthPrePass() const {
+    return m_depthPrePass;
+}
 
-            // calc radius
-            int radius = 2;
-            if (river.m_turtle.m_depth < 5) {
-                radius = (5 - river.m_turtle.m_depth);
-            }
+long long Terrain::opaqueFragments() const {
+    return m_opaqueFragments.lastCount();
+}
 
-            // skip straight line
-            if (start[1] == end[1]) {
-                continue;
-            }
+ChunkArena::Stats Terrain::arenaStats() const {
+    return m_arena.stats();
+}
 
-            for (int z = zMin; z <= zMax; z++) {
-                int waterLevel = 128;
-                // get x-intercept
-                float xIntercept = start[0];
-                if (start[0] != end[0]) {
-                    xIntercept = (z - start[1]) / ((start[1] - end[1]) / (start[0] - end[0])) + start[0];
-                }
-                int l = floor(xIntercept);
-
-                for (int x = -radius; x <= radius; x++) {
-                    // get rid of every block above river
-                    for (int y = waterLevel; y < 256; y++) {
-                        setBlockAt(l + x, y, z, EMPTY);
-                    }
-
-                    // add water
-                    for (int y = -radius; y < 0; y++) {
-                        float dist = length(vec3(l + x, waterLevel + y, z) - vec3(l, waterLevel, z));
-                        if (dist < radius) {
-                            if (waterLevel + y < waterLevel) {
-                                setBlockAt(l + x, waterLevel + y, z, WATER);
-                            }
-                        }
-                    }
+void Terrain::destroyMeshes() {
+    m_arena.destroy();
+    m_opaqueFragments.destroy();
+}
 
-                }
+std::vector<int> Terrain::findVisibleChunks(const std::vector<Chunk*> &window, int depth, glm::ivec2 origin,
+                                            const Frustum &frustum, glm::vec3 eye) const {
+    // One per section. Directions are numbered so that d ^ 1 is
+    // the opposite of d, and the face a step in direction d
+    // enters the next section through.
+    struct Step {
+        int chunk, section;
+        int entry; // -1 for the section the eye is in
+        int directions; // Every direction taken to get here
+    };
+    static const glm::ivec3 offsets[6] = {
+        glm::ivec3(1, 0, 0), glm::ivec3(-1, 0, 0), glm::ivec3(0, 1, 0),
+        glm::ivec3(0, -1, 0), glm::ivec3(0, 0, 1), glm::ivec3(0, 0, -1)
+    };
+
+    int width = static_cast<int>(window.size()) / depth;
+    std::vector<bool> visited(window.size() * Chunk::SECTIONS, false);
+    std::vector<bool> found(window.size(), false);
+    std::vector<int> chunks;
+    std::vector<Step> queue;
+
+    glm::ivec3 start(static_cast<int>(glm::floor((eye.x - origin.x) / 16.f)),
+                     static_cast<int>(glm::floor(eye.y / 16.f)),
+                     static_cast<int>(glm::floor((eye.z - origin.y) / 16.f)));
+    int startChunk = start.x * depth + start.z;
+    visited[startChunk * Chunk::SECTIONS + start.y] = true;
+    found[startChunk] = true;
+    chunks.push_back(startChunk);
+    queue.push_back({startChunk, start.y, -1, 0});
+
+    // Breadth first, so Chunks come out roughly nearest first
+    for (size_t head = 0; head < queue.size(); head++) {
+        Step step = queue[head];
+        Chunk *chunk = window[step.chunk];
+        // Nothing is known about what is in a Chunk without a mesh yet
+        SectionVisibility visibility = chunk != nullptr ? chunk->getSectionVisibility(step.section)
+                                                        : ALL_FACES_VISIBLE;
+        glm::ivec3 pos(step.chunk / depth, step.section, step.chunk % depth);
+
+        for (int d = 0; d < 6; d++) {
+            if ((step.directions >> (d ^ 1)) & 1) {
+                continue;
+            }
+            if (step.entry >= 0 && !Chunk::canSee(visibility, Direction(step.entry), Direction(d))) {
+                continue;
+            }
+            glm::ivec3 next = pos + offsets[d];
+            if (next.x < 0 || next.x >= width || next.z < 0 || next.z >= depth
+                    || next.y < 0 || next.y >= Chunk::SECTIONS) {
+                continue;
+            }
+            int nextChunk = next.x * depth + next.z;
+            int node = nextChunk * Chunk::SECTIONS + next.y;
+            if (visited[node]) {
+                continue;
+            }
+            // Out of the frustum from whichever side it is reached
+            visited[node] = true;
+            glm::vec3 boxMin(origin.x + 16 * next.x, 16 * next.y, origin.y + 16 * next.z);
+            if (!frustum.intersects(boxMin, boxMin + glm::vec3(16))) {
+                continue;
+            }
+            if (!found[nextChunk]) {
+                found[nextChunk] = true;
+                chunks.push_back(nextChunk);
             }
+            queue.push_back({nextChunk, next.y, d ^ 1, step.directions | 1 << d});
         }
     }
+    return chunks;
 }
 
-void Terrain::drawTrees() {
-    for (int i = 0; i < 15; i++) {
-        int x = rand() % 80 + 1;
-        int z = rand() % 80 + 1;
-
-        int height = 0;
-        // find height
-        for (int h = 256; h >= 128; h--) {
-            if (getBlockAt(x, h, z) != EMPTY) {
-                height = h + 1;
-                break;
+std::vector<Chunk*> Terrain::cullChunks(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+                                        glm::vec3 eye, DrawCounts &counts) const {
+    int width = (maxX - minX) / 16, depth = (maxZ - minZ) / 16;
+    std::vector<Chunk*> window(width * depth);
+    for (int i = 0; i < width; i++) {
+        for (int j = 0; j < depth; j++) {
+            window[i * depth + j] = findChunkAt(minX + 16 * i, minZ + 16 * j);
+        }
+    }
+    // Chunks that have never been uploaded have no VBOs to draw
+    auto hasMesh = [](Chunk *chunk) {
+        return chunk != nullptr && (chunk->elemCountOpq() >= 0 || chunk->elemCountTrans() >= 0);
+    };
+    // Nothing is above the highest block, so the box can stop there
+    auto inFrustum = [&](int i) {
+        glm::vec3 boxMin(minX + 16 * (i / depth), 0, minZ + 16 * (i % depth));
+        glm::vec3 boxMax = boxMin + glm::vec3(16, window[i]->getMaxHeight() + 1, 16);
+        return frustum.intersects(boxMin, boxMax);
+    };
+
+    std::vector<Chunk*> visible;
+    bool eyeInWindow = eye.x >= minX && eye.x < maxX && eye.z >= minZ && eye.z < maxZ
+            && eye.y >= 0 && eye.y < 16 * Chunk::SECTIONS;
+    if (m_occlusionCulling && eyeInWindow) {
+        // A Chunk may only have been reached through the sky above it
+        std::vector<bool> found(window.size(), false);
+        for (int i : findVisibleChunks(window, depth, glm::ivec2(minX, minZ), frustum, eye)) {
+            if (hasMesh(window[i]) && inFrustum(i)) {
+                found[i] = true;
+                visible.push_back(window[i]);
+            }
+        }
+        for (size_t i = 0; i < window.size(); i++) {
+            if (!hasMesh(window[i])) {
+                continue;
+            }
+            if (found[i]) {
+                counts.drawn++;
+            } else if (inFrustum(i)) {
+                counts.occluded++;
+            } else {
+                counts.culled++;
+            }
+        }
+    } else {
+        for (size_t i = 0; i < window.size(); i++) {
+            if (!hasMesh(window[i])) {
+                continue;
+            }
+            if (inFrustum(i)) {
+                visible.push_back(window[i]);
+                counts.drawn++;
+            } else {
+                counts.culled++;
             }
         }
-
-         // only draw on grasslands
-         if (getBlockAt(x, height - 1, z) == GRASS) {
-               drawTree(x, z, height);
-         }
     }
+    return visible;
+}
 
-    // render them trees (and the river)
-    for (int x = -64; x <= 128; x += 16) {
-        for (int z = -64; z <= 128; z += 16) {
-            const uPtr<Chunk> &chunk = getChunkAt(x, z);
-            chunk->destroy();
-            chunk->generateVBOData();
-            chunk->create();
+void Terrain::sortNearestFirst(std::vector<Chunk*> &chunks, glm::vec3 eye) {
+    // A counting sort, since rings are small integers and
+    // there are at most a few thousand Chunks
+    glm::ivec2 eyeChunk(static_cast<int>(glm::floor(eye.x / 16.f)),
+                        static_cast<int>(glm::floor(eye.z / 16.f)));
+    std::vector<int> rings(chunks.size());
+    std::vector<int> starts;
+    for (size_t i = 0; i < chunks.size(); i++) {
+        glm::ivec2 chunk = chunks[i]->getWorldPos() / 16;
+        rings[i] = std::max(std::abs(chunk.x - eyeChunk.x), std::abs(chunk.y - eyeChunk.y));
+        if (rings[i] >= static_cast<int>(starts.size())) {
+            starts.resize(rings[i] + 1, 0);
         }
+        starts[rings[i]]++;
+    }
+    int offset = 0;
+    for (int &start : starts) {
+        int count = start;
+        start = offset;
+        offset += count;
+    }
+    std::vector<Chunk*> sorted(chunks.size());
+    for (size_t i = 0; i < chunks.size(); i++) {
+        sorted[starts[rings[i]]++] = chunks[i];
     }
+    chunks.swap(sorted);
 }
 
-void Terrain::drawTree(int x, int z, int height) {
-    // tree tronk
-    for (int y = height; y < height + 2; y++) {
-        setBlockAt(x, y, z, WOOD);
+Terrain::DrawCounts Terrain::draw(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+                                  glm::vec3 eye, ShaderProgram *shaderProgram, ShaderProgram *depthProgram,
+                                  FrameProfiler *profiler) {
+    EpochManager::Guard guard(m_epochs);
+    DrawCounts counts = {0, 0, 0, 0};
+
+    // Decide what to draw before touching GL, so that both passes
+    // only walk the Chunks that made it
+    std::vector<Chunk*> visible;
+    {
+        FrameProfiler::Scope scope(profiler, FrameProfiler::CULLING);
+        visible = cullChunks(minX, maxX, minZ, maxZ, frustum, eye, counts);
+        sortNearestFirst(visible, eye);
     }
-    // center ring
-    for (int y = height + 2; y < height + 7; y++) {
-        for (int i = x - 1; i <= x + 1; i++) {
-            for (int j = z - 1; j <= z + 1; j++) {
-                setBlockAt(i, y, j, LEAF);
-            }
+
+    FrameProfiler::Scope scope(profiler, FrameProfiler::SUBMISSION);
+    std::vector<const ChunkArena::Allocation*> opaque, transparent;
+    for (Chunk *chunk : visible) {
+        if (chunk->meshOpq() != nullptr) {
+            opaque.push_back(chunk->meshOpq());
         }
     }
-    // outer ring
-    for (int y = height + 3; y < height + 6; y++) {
-        for (int i = x - 2; i <= x + 2; i++) {
-            for (int j = z - 2; j <= z + 2; j++) {
-                if (getBlockAt(i, y, j) == EMPTY) {
-                    setBlockAt(i, y, j, LEAF);
-                }
-            }
+    for (auto it = visible.rbegin(); it != visible.rend(); ++it) {
+        if ((*it)->meshTrans() != nullptr) {
+            transparent.push_back((*it)->meshTrans());
         }
     }
-}
 
+    // Chunk vertices are already in world space, so every Chunk shares
+    // the zero translation
+    bool prePass = m_depthPrePass && depthProgram != nullptr;
+    // Drawn nearest first so that the depth test rejects what is behind
+    // before it is shaded. Behind a pre-pass the depth is already final,
+    // and the order no longer matters.
+    bool opaqueInOrder = !prePass;
+    if (prePass) {
+        depthProgram->setModelTranslation(glm::vec3(0));
+        mp_context->colorMask(GL_FALSE);
+        counts.drawCalls += depthProgram->drawArena(m_arena, opaque, m_multiDraw, false);
+        mp_context->colorMask(GL_TRUE);
+        // The depth buffer already holds the nearest opaque surface,
+        // which the shading pass has to match exactly
+        mp_context->depthFunc(GL_LEQUAL);
+        mp_context->depthMask(GL_FALSE);
+    }
+    shaderProgram->setModelTranslation(glm::vec3(0));
+    m_opaqueFragments.begin();
+    counts.drawCalls += shaderProgram->drawArena(m_arena, opaque, m_multiDraw, opaqueInOrder);
+    m_opaqueFragments.end();
+    if (prePass) {
+        mp_context->depthMask(GL_TRUE);
+        mp_context->depthFunc(GL_LESS);
+    }
+    // Farthest first, so that each blends over what is behind it
+    counts.drawCalls += shaderProgram->drawArena(m_arena, transparent, m_multiDraw, true);
+    return counts;
+}
@@ -3,6 +3,7 @@
 #include "glm_includes.h"
 #include "chunk.h"
 #include <array>
+#include <atomic>
 #include <unordered_map>
 #include <unordered_set>
 #include "shaderprogram.h"
@@ -10,7 +11,15 @@
 #include "thread"
 #include <vector>
 #include <mutex>
-#include "river.h"
+#include <shared_mutex>
+#include "worldgen.h"
+#include "chunkstore.h"
+#include "chunkmap.h"
+#include "chunkpipeline.h"
+#include "epochmanager.h"
+#include "frustum.h"
+#include "frameprofiler.h"
+#include "fragmentcounter.h"
 
 using namespace std;
 using namespace glm;
@@ -19,30 +28,33 @@ using namespace glm;
 int64_t toKey(int x, int z);
 glm::ivec2 toCoords(int64_t k);
 
-// The container class for all of the Chunks in the game.
-// Ultimately, while Terrain will always store all Chunks,
-// not all Chunks will be drawn at any given time as the world
-// expands.
+// The container class for the Chunks around the player. Chunks are
+// generated as the player approaches them and evicted once they are far
+// enough away, and only those in view are drawn.
 class Terrain {
 private:
-    // Stores every Chunk according to the location of its lower-left corner
-    // in world space.
-    // We combine the X and Z coordinates of the Chunk's corner into one 64-bit int
-    // so that we can use them as a key for the map, as objects like std::pairs or
-    // glm::ivec2s are not hashable by default, so they cannot be used as keys.
-
-
-    std::unordered_map<int64_t, uPtr<Chunk>> newChunks;
-
-    std::unordered_map<int64_t, uPtr<Chunk>> chunksWithBlockData;
+    // Holds every Chunk's mesh. Declared first so that it outlives
+    // the Chunks, which give their meshes back when destroyed.
+    ChunkArena m_arena;
+
+    // Keeps evicted Chunks (and old versions of m_chunks' table) alive
+    // until no thread can still be reading them. Declared before m_chunks
+    // so that it outlives it.
+    mutable EpochManager m_epochs;
+
+    // Every Chunk lives in m_chunks, keyed by its lower-left corner (see
+    // toKey()), from the moment it is instantiated until evictDistantZones()
+    // removes it, so that neighbors can be linked no matter how far along
+    // it is. Worker threads only ever receive raw pointers to Chunks owned
+    // by this map, and check getState() rather than assuming a Chunk has
+    // data. Lookups are lock-free; hold an EpochManager::Guard on m_epochs while
+    // using anything found in it.
+    ChunkMap m_chunks;
+
+    // Chunks that made it through m_generation since the last tick
+    std::vector<Chunk*> chunksWithBlockData;
     std::mutex chunksWithBlockDataMutex;
 
-    std::unordered_map<int64_t, uPtr<Chunk>> chunksWithVBOData;
-    std::mutex chunksWithVBODataMutex;
-
-    std::unordered_map<int64_t, uPtr<Chunk>> m_chunks;
-    std::mutex chunksMutex;
-
     // We will designate every 64 x 64 area of the world's x-z plane
     // as one "terrain generation zone". Every time the player moves
     // near a portion of the world that has not yet been generated
@@ -53,20 +65,87 @@ private:
     // one 64 x 64 area with its lower-left corner at (0, 0).
     // When milestone 1 has been implemented, the Player can move around the
     // world to add more "terrain generation zone" IDs to this set.
-    // While only the 3 x 3 collection of terrain generation zones
-    // surrounding the Player should be rendered, the Chunks
-    // in the Terrain will never be deleted until the program is terminated.
+    // Zones that drift too far from the Player are evicted (see
+    // evictDistantZones) and removed from this set, so they will be
+    // generated again if the Player comes back.
     std::unordered_set<int64_t> m_generatedTerrain;
 
     OpenGLContext* mp_context;
 
-    std::vector<std::thread> blockWorkerThreads;
-    std::vector<std::thread> vboWorkerThreads;
+    // tryExpansion() runs on the simulation thread while checkThreadResults()
+    // runs on the render thread. This serializes everything they share:
+    // neighbor links, m_needsRemesh and m_generatedTerrain.
+    std::mutex m_streamingMutex;
+
+    // Meshing workers copy a Chunk's blocks and its neighbors' borders
+    // under a shared lock, and setBlockAt() writes under an exclusive one,
+    // so that an edit never lands in the middle of a copy
+    std::shared_mutex m_blockEditMutex;
 
     bool firstTick = true;
 
+    // The n x n grid of zones kept loaded around the player. Set from
+    // the render thread and read by tryExpansion(), which remembers the
+    // size it last loaded in m_lastLoadZones.
+    std::atomic<int> m_loadZones;
+    int m_lastLoadZones;
+
+    // Whether draw() skips Chunks hidden behind others
+    bool m_occlusionCulling;
+    // Whether draw() draws each run of a pass's Chunks that share an arena
+    // page in one call, rather than one call per Chunk
+    bool m_multiDraw;
+    // Whether draw() lays down the opaque Chunks' depth before shading them
+    bool m_depthPrePass;
+    // Counts the fragments the opaque pass shades
+    FragmentCounter m_opaqueFragments;
+
+    // Decides what every Chunk's blocks are. The stages below hand
+    // each step of that to it.
+    WorldGen m_worldGen;
+    // A world generated ahead of time. Chunks found in it are loaded
+    // instead of generated. Only used if it holds this seed and mode.
+    ChunkStore m_store;
+
+    // Every new Chunk passes through this, from noise to finished blocks.
+    // See setUpPipelines() for the stages. Declared last so that its
+    // workers are stopped before anything they use is destroyed.
+    ChunkPipeline m_generation;
+    // Chunks whose neighbors all have blocks pass through this,
+    // from meshing on workers to uploading on the main thread
+    ChunkPipeline m_meshing;
+
+    // Adds the stages to m_generation and m_meshing
+    void setUpPipelines();
+
+    // Walks outwards from the section eye is in, from each section only
+    // into the neighbors that can be seen through it, and never back
+    // against a direction already taken. window holds the Chunks of
+    // draw()'s window, depth Chunks to a column, with origin the
+    // corner of window[0]. Returns the index of every Chunk a visible
+    // section was found in, nearest first.
+    std::vector<int> findVisibleChunks(const std::vector<Chunk*> &window, int depth, glm::ivec2 origin,
+                                       const Frustum &frustum, glm::vec3 eye) const;
+
+    // The stages, in the order Chunks pass through them
+    void generateHeightMap(Chunk*);
+    void generateSurface(Chunk*);
+    void generateCarving(Chunk*);
+    void generateFeatures(Chunk*);
+    // Bounds the blocks for meshing and culling, and hands the Chunk on
+    void computeMaxHeight(Chunk*);
+    void generateMesh(Chunk*);
+    // Runs on the main thread, from checkThreadResults()
+    void uploadMesh(Chunk*);
+
 public:
-    Terrain(OpenGLContext *context);
+    // Zones are only evicted once they are outside a grid this many
+    // zones wider than the one kept loaded, so that walking back and
+    // forth across a zone's edge doesn't reload the same Chunks
+    static const int EVICTION_MARGIN = 4;
+
+    // storeDir is a ChunkStore, which need not exist
+    Terrain(OpenGLContext *context, unsigned int seed, GenerationMode mode, const std::string &storeDir);
     ~Terrain();
 
     uPtr<Chunk> instantiateChunkAt(int x, int z);
@@ -77,31 +156,57 @@ public:
 
     void makeVBOData();
 
+    // True if a Chunk exists at these coords and has finished
+    // filling in its blocks
     bool hasChunkAt(int x, int z) const;
-    bool hasNewChunkAt(int x, int z) const;
-
-    // Assuming a Chunk exists at these coords,
-    // return a mutable reference to it
-    uPtr<Chunk>& getChunkAt(int x, int z);
-    // Assuming a Chunk exists at these coords,
-    // return a const reference to it
-    const uPtr<Chunk>& getChunkAt(int x, int z) const;
 
+    // Returns the Chunk at these coords regardless of its state,
+    // or nullptr if none has been instantiated there yet.
+    // Off the main thread, only use the result while holding a Guard.
+    Chunk* findChunkAt(int x, int z) const;
 
-    uPtr<Chunk>& getNewChunkAt(int x, int z);
-    const uPtr<Chunk>& getNewChunkAt(int x, int z) const;
+    EpochManager& epochs() const;
 
     void multithreadedWork(glm::vec3, glm::vec3);
 
-    void tryExpansion(glm::vec3, glm::vec3);
+    // Instantiates and starts generating the zones that came into range
+    // as the player moved from prevPlayerPos to currPlayerPos. Safe to call
+    // from the simulation thread. Returns false without doing anything if
+    // checkThreadResults() is running, so that the caller never waits on
+    // uploads; call again later with the same prevPlayerPos.
+    bool tryExpansion(glm::vec3 currPlayerPos, glm::vec3 prevPlayerPos);
+    // Uploads finished VBO data and frees evicted Chunks. Must be called on
+    // the thread that owns the GL context.
     void checkThreadResults();
 
-    void spawnBlockWorkers(glm::ivec2);
-    void blockWorker(uPtr<Chunk>);
-    void spawnVBOWorkers();
-    void VBOWorker(uPtr<Chunk>);
+    // Throughput, latency and backlog of every stage
+    // since the previous call
+    std::vector<ChunkPipeline::StageMetrics> pipelineMetrics();
+    // Chunks waiting to be generated or meshed
+    int streamingBacklog();
+
+    // The n x n grid of zones loaded around the player's zone. Odd; 5 by
+    // default. Takes effect at the next tryExpansion(), which loads any
+    // zones a larger grid brings into range and starts evicting the ones
+    // a smaller grid leaves outside the margin.
+    void setLoadZones(int n);
+    int loadZones() const;
+
+    // Unpublishes every zone outside the (n x n) zones around currZone
+    // whose Chunks are all idle, and retires them.
+    // Caller holds m_streamingMutex.
+    void evictDistantZones(glm::ivec2 currZone, int n);
 
-    BlockType generateBlockTypeByHeight(int, bool);
+    // Hands the Chunk to m_meshing if it has block data, is not already
+    // being meshed, and every neighbor it is linked to has block data.
+    // Caller holds m_streamingMutex.
+    void tryScheduleMesh(Chunk*);
+
+    // Regenerates the VBO data of the Chunk containing (x, z), and of any
+    // neighbor whose border faces depend on that column
+    void requestRemesh(int x, int z);
+
+    const WorldGen& worldGen() const;
 
 
 
@@ -116,10 +221,46 @@ public:
     void setBlockAt(int x, int y, int z, BlockType t);
 
     void setNewBlockAt(int x, int y, int z, BlockType t);
+    // How many of the Chunks that had a mesh to draw were drawn, how many
+    // were left out for being outside the frustum, and how many for being
+    // inside it but hidden behind other Chunks
+    struct DrawCounts {
+        int drawn, culled, occluded;
+        int drawCalls;
+    };
     // Draws every Chunk that falls within the bounding box
-    // described by the min and max coords, using the provided
-    // ShaderProgram
-    void draw(int minX, int maxX, int minZ, int maxZ, ShaderProgram *shaderProgram);
+    // described by the min and max coords and that can be seen
+    // from eye through the frustum, using the provided ShaderProgram.
+    // Opaque Chunks are drawn nearest first, so that the depth test
+    // rejects what they hide before it is shaded, and transparent ones
+    // farthest first, so that they blend over each other correctly.
+    // With the depth pre-pass on, depthProgram first draws the opaque
+    // Chunks' depth alone, and shaderProgram then only shades the
+    // fragments that ended up in front.
+    // Times its culling and submission in the profiler, if given one.
+    DrawCounts draw(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+                    glm::vec3 eye, ShaderProgram *shaderProgram, ShaderProgram *depthProgram = nullptr,
+                    FrameProfiler *profiler = nullptr);
+
+    // On by default. Turning it off draws everything in the frustum.
+    void setOcclusionCulling(bool enabled);
+    bool occlusionCulling() const;
+    // On by default
+    void setMultiDraw(bool enabled);
+    bool multiDraw() const;
+    // Off by default. Only pays off when fragments are expensive
+    // enough that shading each pixel once beats drawing the opaque
+    // geometry twice.
+    void setDepthPrePass(bool enabled);
+    bool depthPrePass() const;
+    // Fragments shaded by the opaque pass of a recent frame,
+    // or -1 if no count has come back yet
+    long long opaqueFragments() const;
+
+    ChunkArena::Stats arenaStats() const;
+    // Frees the arena's GL buffers. Must be called on the
+    // thread that owns the GL context, before it goes away.
+    void destroyMeshes();
 
 //    // Initializes the Chunks that store the 64 x 256 x 64 block scene you
 //    // see when the base code is run.
@@ -131,7 +272,11 @@ public:
 
     void fillColumn(int x, int z);
 
-    void drawRiver();
-    void drawTrees();
-    void drawTree(int x, int z, int height);
+private:
+    // The part of draw() that decides which Chunks to draw, and counts them
+    std::vector<Chunk*> cullChunks(int minX, int maxX, int minZ, int maxZ, const Frustum &frustum,
+                                   glm::vec3 eye, DrawCounts &counts) const;
+    // Reorders chunks nearest first, by which ring of Chunks around
+    // eye's Chunk they are in. Keeps the order within each ring.
+    static void sortNearestFirst(std::vector<Chunk*> &chunks, glm::vec3 eye);
 };
@@ -5,7 +5,6 @@
 
 #include <glm/common.hpp>
 #include <glm/gtx/transform.hpp>
-#include <glm/gtc/random.hpp>
 
 using namespace glm;
 using namespace std;
@@ -22,11 +21,11 @@ public:
     // constructors
     Turtle();
     Turtle(vec2 position, vec2 orientation, float distance);
-    Turtle(const Turtle& t);
 
     // functions
-    void rotateRight(const float factor);
-    void rotateLeft(const float factor);
+    // Both take the angle in radians
+    void rotateRight(const float angle);
+    void rotateLeft(const float angle);
     void moveForward();
 };
 
@@ -0,0 +1,278 @@
+#include "worldgen.h"
+#include "procgen.h"
+
+int WorldGen::blockIndex(int x, int y, int z) {
+    return x + 16 * y + 16 * 256 * z;
+}
+
+WorldGen::WorldGen(unsigned int seed, GenerationMode mode)
+    : m_seed(seed), m_mode(mode), m_rivers(seed)
+{}
+
+unsigned int WorldGen::seed() const {
+    return m_seed;
+}
+
+GenerationMode WorldGen::mode() const {
+    return m_mode;
+}
+
+void WorldGen::generateChunk(glm::ivec2 chunkPos, int *heights, BlockType *blocks) const {
+    generateHeightMap(chunkPos, heights);
+    generateSurface(chunkPos, heights, blocks);
+    generateCarving(chunkPos, blocks);
+    generateFeatures(chunkPos, blocks);
+}
+
+BlockType WorldGen::generateBlockTypeByHeight(int height, bool isTop) const {
+
+    if (height < 120) {
+        return STONE;
+    }
+
+    if (height < 128) {
+        return SAND;
+    }
+
+    if (height < 160) {
+        return isTop ? GRASS : DIRT;
+    }
+
+    if (height > 200) {
+        return isTop ? SNOW : STONE;
+    }
+
+    return STONE;
+}
+
+void WorldGen::generateHeightMap(glm::ivec2 chunkPos, int *heights) const {
+    ProcGen::getHeights(chunkPos.x, chunkPos.y, m_seed, heights);
+}
+
+void WorldGen::generateSurface(glm::ivec2 chunkPos, const int *heights, BlockType *blocks) const {
+    if (m_mode == HEIGHTMAP_TERRAIN) {
+        for (int x = 0; x < 16; x++) {
+            for (int z = 0; z < 16; z++) {
+                int height = heights[x + 16 * z];
+
+                for (int k = 0; k <= height; k++) {
+                    blocks[blockIndex(x, k, z)] = generateBlockTypeByHeight(height, k == height);
+                }
+            }
+        }
+        return;
+    }
+
+    std::vector<unsigned char> solid(ProcGen::CHUNK_COLUMNS * ProcGen::CHUNK_HEIGHT);
+    ProcGen::getSolidity(chunkPos.x, chunkPos.y, heights, m_seed, solid.data());
+
+    for (int x = 0; x < 16; x++) {
+        for (int z = 0; z < 16; z++) {
+            int height = heights[x + 16 * z];
+
+            // Walk down so that every block knows whether it is open to
+            // the sky, which is what gets grass on top of an overhang
+            bool airAbove = true;
+            for (int k = ProcGen::CHUNK_HEIGHT - 1; k >= 0; k--) {
+                bool isSolid = solid[x + 16 * z + ProcGen::CHUNK_COLUMNS * k];
+                if (isSolid) {
+                    blocks[blockIndex(x, k, z)] = generateBlockTypeByHeight(height, airAbove);
+                }
+                airAbove = !isSolid;
+            }
+        }
+    }
+}
+
+void WorldGen::generateCarving(glm::ivec2 chunkPos, BlockType *blocks) const {
+    drawRiver(chunkPos, blocks);
+}
+
+void WorldGen::generateFeatures(glm::ivec2 chunkPos, BlockType *blocks) const {
+    // Leaves reach 2 blocks out from the trunk and veins at most
+    // VEIN_LENGTH, so features anchored in the 8 surrounding
+    // Chunks can reach into this one
+    for (int dx = -16; dx <= 16; dx += 16) {
+        for (int dz = -16; dz <= 16; dz += 16) {
+            for (const Feature &feature : featuresAnchoredIn(chunkPos + glm::ivec2(dx, dz))) {
+                if (feature.type == TREE_FEATURE) {
+                    drawTree(chunkPos, blocks, feature.anchor.x, feature.anchor.z, feature.anchor.y);
+                } else {
+                    drawVein(chunkPos, blocks, feature);
+                }
+            }
+        }
+    }
+}
+
+std::vector<RiverColumn> WorldGen::riverColumnsIn(glm::ivec2 chunkPos) const {
+    std::vector<RiverColumn> columns;
+    for (const RiverSegment &segment : m_rivers.segmentsIn(chunkPos)) {
+        glm::vec2 start = segment.start;
+        glm::vec2 end = segment.end;
+
+        // skip straight line
+        if (start[1] == end[1]) {
+            continue;
+        }
+
+        int zMin = glm::max(static_cast<int>(glm::min(start[1], end[1])), chunkPos.y);
+        int zMax = glm::min(static_cast<int>(glm::max(start[1], end[1])), chunkPos.y + 15);
+
+        for (int z = zMin; z <= zMax; z++) {
+            // get x-intercept
+            float xIntercept = start[0];
+            if (start[0] != end[0]) {
+                xIntercept = (z - start[1]) / ((start[1] - end[1]) / (start[0] - end[0])) + start[0];
+            }
+            int l = glm::floor(xIntercept);
+
+            for (int x = -segment.radius; x <= segment.radius; x++) {
+                if (l + x >= chunkPos.x && l + x < chunkPos.x + 16) {
+                    columns.push_back({l + x, z, x, segment.radius});
+                }
+            }
+        }
+    }
+    return columns;
+}
+
+void WorldGen::drawRiver(glm::ivec2 chunkPos, BlockType *blocks) const {
+    int waterLevel = 128;
+
+    for (const RiverColumn &column : riverColumnsIn(chunkPos)) {
+        int x = column.x - chunkPos.x;
+        int z = column.z - chunkPos.y;
+
+        // get rid of every block above river
+        for (int y = waterLevel; y < 256; y++) {
+            blocks[blockIndex(x, y, z)] = EMPTY;
+        }
+
+        // add water
+        for (int y = -column.radius; y < 0; y++) {
+            float dist = glm::length(glm::vec2(column.offset, y));
+            if (dist < column.radius) {
+                blocks[blockIndex(x, waterLevel + y, z)] = WATER;
+            }
+        }
+    }
+}
+
+void WorldGen::evictRiversOutside(glm::ivec2 lo, glm::ivec2 hi) const {
+    m_rivers.evictOutside(lo, hi);
+}
+
+unsigned int WorldGen::chunkSeed(glm::ivec2 chunkPos) const {
+    return m_seed ^ (static_cast<unsigned int>(chunkPos.x) * 73856093u)
+                  ^ (static_cast<unsigned int>(chunkPos.y) * 19349663u);
+}
+
+std::vector<Feature> WorldGen::featuresAnchoredIn(glm::ivec2 chunkPos) const {
+    ProcGen::Random rng{chunkSeed(chunkPos)};
+    std::vector<Feature> features;
+
+    // About as dense as the original 15 trees per 80 x 80 blocks
+    int x = chunkPos.x + rng.nextInt(0, 15);
+    int z = chunkPos.y + rng.nextInt(0, 15);
+    bool placeTree = rng.nextInt(0, 4) <= 2;
+
+    // Ore veins, drawn whether or not there is a tree so that the
+    // sequence of draws never depends on the terrain
+    struct VeinKind {
+        FeatureType type;
+        int count, minY, maxY;
+    };
+    static const VeinKind veinKinds[] = {
+        {COAL_VEIN, 8, 8, 100},
+        {IRON_VEIN, 4, 4, 60}
+    };
+    for (const VeinKind &kind : veinKinds) {
+        for (int i = 0; i < kind.count; i++) {
+            int dx = rng.nextInt(0, 15);
+            int dz = rng.nextInt(0, 15);
+            int y = rng.nextInt(kind.minY, kind.maxY);
+            glm::ivec3 anchor(chunkPos.x + dx, y, chunkPos.y + dz);
+            features.push_back({kind.type, anchor, rng.next()});
+        }
+    }
+
+    if (!placeTree) {
+        return features;
+    }
+    // only draw on grasslands, which the river may have washed away
+    int height = ProcGen::getHeight(x, z, m_seed);
+    if (generateBlockTypeByHeight(height, true) != GRASS) {
+        return features;
+    }
+    // The density field may have hollowed out or built over the ground
+    if (m_mode == DENSITY_TERRAIN && (!ProcGen::isSolid(x, height, z, height, m_seed)
+                                      || ProcGen::isSolid(x, height + 1, z, height, m_seed))) {
+        return features;
+    }
+    for (const RiverColumn &column : riverColumnsIn(chunkPos)) {
+        if (column.x == x && column.z == z) {
+            return features;
+        }
+    }
+    features.push_back({TREE_FEATURE, glm::ivec3(x, height + 1, z), 0});
+    return features;
+}
+
+void WorldGen::drawVein(glm::ivec2 chunkPos, BlockType *blocks, const Feature &vein) const {
+    BlockType ore = vein.type == COAL_VEIN ? COAL : IRON;
+    int length = vein.type == COAL_VEIN ? VEIN_LENGTH : VEIN_LENGTH / 2;
+
+    ProcGen::Random rng{vein.seed};
+    glm::ivec3 p = vein.anchor;
+    for (int i = 0; i < length; i++) {
+        int x = p.x - chunkPos.x, z = p.z - chunkPos.y;
+        if (x >= 0 && x < 16 && z >= 0 && z < 16 && p.y >= 0 && p.y < 256) {
+            BlockType &t = blocks[blockIndex(x, p.y, z)];
+            if (t == STONE || t == DIRT) {
+                t = ore;
+            }
+        }
+        // One step along a random axis
+        int axis = rng.nextInt(0, 2);
+        int step = rng.nextInt(0, 1) ? 1 : -1;
+        p[axis] += step;
+    }
+}
+
+void WorldGen::drawTree(glm::ivec2 chunkPos, BlockType *blocks, int x, int z, int height) const {
+    auto inChunk = [&](int i, int y, int j) {
+        return i >= chunkPos.x && i < chunkPos.x + 16 && j >= chunkPos.y && j < chunkPos.y + 16
+                && y >= 0 && y < 256;
+    };
+    auto local = [&](int i, int y, int j) -> BlockType& {
+        return blocks[blockIndex(i - chunkPos.x, y, j - chunkPos.y)];
+    };
+
+    // tree tronk
+    for (int y = height; y < height + 2; y++) {
+        if (inChunk(x, y, z)) {
+            local(x, y, z) = WOOD;
+        }
+    }
+    // center ring
+    for (int y = height + 2; y < height + 7; y++) {
+        for (int i = x - 1; i <= x + 1; i++) {
+            for (int j = z - 1; j <= z + 1; j++) {
+                if (inChunk(i, y, j)) {
+                    local(i, y, j) = LEAF;
+                }
+            }
+        }
+    }
+    // outer ring
+    for (int y = height + 3; y < height + 6; y++) {
+        for (int i = x - 2; i <= x + 2; i++) {
+            for (int j = z - 2; j <= z + 2; j++) {
+                if (inChunk(i, y, j) && local(i, y, j) == EMPTY) {
+                    local(i, y, j) = LEAF;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,108 @@
+#pragma once
+#include "glm_includes.h"
+#include "blocktype.h"
+#include "rivernetwork.h"
+#include <vector>
+
+// A column the river flows through. offset is its distance in x
+// from the center of the river at that z.
+struct RiverColumn {
+    int x, z;
+    int offset, radius;
+};
+
+enum FeatureType : unsigned char
+{
+    TREE_FEATURE, COAL_VEIN, IRON_VEIN
+};
+
+// Something placed on the finished terrain. Each one is anchored in
+// exactly one Chunk but may reach into that Chunk's neighbors.
+struct Feature {
+    FeatureType type;
+    // For a tree, the base of its trunk
+    glm::ivec3 anchor;
+    // Decides the feature's shape, so that every Chunk
+    // it reaches into draws the same one
+    unsigned int seed;
+};
+
+// How a Chunk's blocks are filled in from its height map
+enum GenerationMode : unsigned char
+{
+    // Solid from the bottom up to the height of each column
+    HEIGHTMAP_TERRAIN,
+    // Solid wherever ProcGen's density field is, which adds caves and
+    // overhangs near the surface
+    DENSITY_TERRAIN
+};
+
+// Decides every block of a Chunk from the world seed and the Chunk's
+// position alone, without looking at any other Chunk. Has nothing to do
+// with Qt or OpenGL, so Terrain and the pregen tool share it and always
+// fill in a Chunk the same way.
+//
+// Works on a Chunk's blocks as a flat array of BLOCKS, laid out the way
+// Chunk stores them (see blockIndex()), and its height map as 256 ints
+// indexed x + 16 * z. Safe to use from any number of threads at once.
+class WorldGen {
+public:
+    static const int BLOCKS = 16 * 256 * 16;
+    // Bumped whenever the same seed and mode stop giving the same Chunks,
+    // along with the tables in tools/tests/golden, so that ChunkStores
+    // baked before the change are refused rather than loaded
+    static const int GENERATOR_VERSION = 1;
+    static int blockIndex(int x, int y, int z);
+
+    WorldGen(unsigned int seed, GenerationMode mode);
+
+    WorldGen(const WorldGen&) = delete;
+    WorldGen& operator=(const WorldGen&) = delete;
+
+    unsigned int seed() const;
+    GenerationMode mode() const;
+
+    // The steps in the order they have to run. chunkPos is the Chunk's
+    // corner in world space, and blocks must start out EMPTY.
+    void generateHeightMap(glm::ivec2 chunkPos, int *heights) const;
+    // Fills in the terrain from the height map, as the mode says to
+    void generateSurface(glm::ivec2 chunkPos, const int *heights, BlockType *blocks) const;
+    void generateCarving(glm::ivec2 chunkPos, BlockType *blocks) const;
+    void generateFeatures(glm::ivec2 chunkPos, BlockType *blocks) const;
+    // All of the above
+    void generateChunk(glm::ivec2 chunkPos, int *heights, BlockType *blocks) const;
+
+    BlockType generateBlockTypeByHeight(int, bool) const;
+
+    // The columns of the Chunk with its corner at chunkPos that
+    // the river flows through
+    std::vector<RiverColumn> riverColumnsIn(glm::ivec2 chunkPos) const;
+    // Every feature anchored in the Chunk with its corner at chunkPos.
+    // Can be called for Chunks that have not been generated.
+    std::vector<Feature> featuresAnchoredIn(glm::ivec2 chunkPos) const;
+    unsigned int chunkSeed(glm::ivec2 chunkPos) const;
+    // Forgets the rivers that no Chunk overlapping the blocks from lo to
+    // hi, inclusive, reaches. They are grown again if they are needed.
+    void evictRiversOutside(glm::ivec2 lo, glm::ivec2 hi) const;
+
+private:
+    // Decoration only ever writes blocks inside the given Chunk, so it
+    // never has to remesh a neighbor. A feature that straddles a border
+    // is drawn by every Chunk it touches, each one re-deriving it from
+    // the seed of the Chunk it is anchored in.
+    void drawRiver(glm::ivec2 chunkPos, BlockType *blocks) const;
+    void drawTree(glm::ivec2 chunkPos, BlockType *blocks, int x, int z, int height) const;
+    // Turns the stone and dirt along a short random walk into ore
+    void drawVein(glm::ivec2 chunkPos, BlockType *blocks, const Feature&) const;
+
+    // The world seed. The height noise and every random
+    // choice made while decorating derive from this.
+    unsigned int m_seed;
+    GenerationMode m_mode;
+    // Steps in a coal vein's random walk. Iron veins take half as many.
+    // Must stay under 16 for generateFeatures() to find every vein.
+    static const int VEIN_LENGTH = 10;
+    // Every river in the world, grown a region at a time as
+    // Chunks ask for the parts of it they contain
+    mutable RiverNetwork m_rivers;
+};
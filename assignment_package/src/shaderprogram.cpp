@@ -3,6 +3,7 @@
 #include <QStringBuilder>
 #include <QTextStream>
 #include <QDebug>
+#include <algorithm>
 #include <stdexcept>
 
 
@@ -11,7 +12,10 @@ ShaderProgram::ShaderProgram(OpenGLContext *context)
       attrPos(-1), attrNor(-1), attrUV(-1),
       unifModel(-1), unifModelInvTr(-1), unifViewProj(-1), unifColor(-1),
       unifSampler2D(-1), unifTime(-1), unifMode(-1),
-      unifPlayer(-1), unifCamera(-1), context(context)
+      unifPlayer(-1), unifCamera(-1),
+      unifFogDistance(-1), unifChunkMask(-1), unifMaskOrigin(-1), unifGrassTint(-1), unifTintOrigin(-1),
+      context(context),
+      m_model(), m_modelUploaded(false), m_normalIdentity(false)
 {}
 
 void ShaderProgram::create(const char *vertfile, const char *fragfile)
@@ -50,6 +54,11 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     // Tell prog that it manages these particular vertex and fragment shaders
     context->glAttachShader(prog, vertShader);
     context->glAttachShader(prog, fragShader);
+    // The same locations in every shader, so that one VAO
+    // works with all of them (see ChunkArena)
+    context->glBindAttribLocation(prog, ChunkArena::ATTR_POS, "vs_Pos");
+    context->glBindAttribLocation(prog, ChunkArena::ATTR_NOR, "vs_Nor");
+    context->glBindAttribLocation(prog, ChunkArena::ATTR_UV, "vs_UV");
     context->glLinkProgram(prog);
 
     // Check for linking success
@@ -81,21 +90,38 @@ void ShaderProgram::create(const char *vertfile, const char *fragfile)
     unifEye        = context->glGetUniformLocation(prog, "u_Eye");
     unifCamera     = context->glGetUniformLocation(prog, "u_Camera");
     unifPlayer     = context->glGetUniformLocation(prog, "u_Player");
+
+    unifFogDistance = context->glGetUniformLocation(prog, "u_FogDistance");
+    unifChunkMask   = context->glGetUniformLocation(prog, "u_ChunkMask");
+    unifMaskOrigin  = context->glGetUniformLocation(prog, "u_MaskOrigin");
+    unifGrassTint   = context->glGetUniformLocation(prog, "u_GrassTint");
+    unifTintOrigin  = context->glGetUniformLocation(prog, "u_TintOrigin");
+
+    // A new program starts out with none of our uniforms set
+    m_modelUploaded = false;
+    m_normalIdentity = false;
 }
 
 void ShaderProgram::useMe()
 {
-    context->glUseProgram(prog);
+    context->useProgram(prog);
 }
 
 void ShaderProgram::setModelMatrix(const glm::mat4 &model)
 {
     useMe();
 
+    // Most draws reuse the last model matrix, which the shader still has
+    if (m_modelUploaded && model == m_model) {
+        return;
+    }
+    m_model = model;
+    m_modelUploaded = true;
+
     if (unifModel != -1) {
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
-        context->glUniformMatrix4fv(unifModel,
+        context->uniformMatrix4fv(unifModel,
                         // How many matrices to pass
                            1,
                         // Transpose the matrix? OpenGL uses column-major, so no.
@@ -105,10 +131,18 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 
     if (unifModelInvTr != -1) {
-        glm::mat4 modelinvtr = glm::inverse(glm::transpose(model));
+        // Normals only care about rotation and scale. A pure translation
+        // leaves them alone, so its inverse transpose is the identity and
+        // needs neither the inverse nor, if it was last sent too, an upload.
+        bool translation = glm::mat3(model) == glm::mat3();
+        if (translation && m_normalIdentity) {
+            return;
+        }
+        m_normalIdentity = translation;
+        glm::mat4 modelinvtr = translation ? glm::mat4() : glm::inverse(glm::transpose(model));
         // Pass a 4x4 matrix into a uniform variable in our shader
                         // Handle to the matrix variable on the GPU
-        context->glUniformMatrix4fv(unifModelInvTr,
+        context->uniformMatrix4fv(unifModelInvTr,
                         // How many matrices to pass
                            1,
                         // Transpose the matrix? OpenGL uses column-major, so no.
@@ -118,6 +152,13 @@ void ShaderProgram::setModelMatrix(const glm::mat4 &model)
     }
 }
 
+void ShaderProgram::setModelTranslation(glm::vec3 t)
+{
+    glm::mat4 model;
+    model[3] = glm::vec4(t, 1);
+    setModelMatrix(model);
+}
+
 void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
 {
     // Tell OpenGL to use this shader program for subsequent function calls
@@ -126,7 +167,7 @@ void ShaderProgram::setViewProjMatrix(const glm::mat4 &vp)
     if(unifViewProj != -1) {
     // Pass a 4x4 matrix into a uniform variable in our shader
                     // Handle to the matrix variable on the GPU
-    context->glUniformMatrix4fv(unifViewProj,
+    context->uniformMatrix4fv(unifViewProj,
                     // How many matrices to pass
                        1,
                     // Transpose the matrix? OpenGL uses column-major, so no.
@@ -142,7 +183,7 @@ void ShaderProgram::setGeometryColor(glm::vec4 color)
 
     if(unifColor != -1)
     {
-        context->glUniform4fv(unifColor, 1, &color[0]);
+        context->uniform4fv(unifColor, 1, &color[0]);
     }
 }
 
@@ -152,7 +193,7 @@ void ShaderProgram::overlayType(const int mode)
 
     if (unifMode != -1)
     {
-        context->glUniform1i(unifMode, mode);
+        context->uniform1i(unifMode, mode);
     }
 }
 
@@ -161,7 +202,7 @@ void ShaderProgram::blockTexture(const int slot)
     if (unifSampler != -1)
     {
         useMe();
-        context->glUniform1i(unifSampler, slot);
+        context->uniform1i(unifSampler, slot);
     }
 }
 
@@ -170,7 +211,66 @@ void ShaderProgram::setTime(int t) {
 
     if(unifTime != -1)
     {
-        context->glUniform1i(unifTime, t);
+        context->uniform1i(unifTime, t);
+    }
+}
+
+void ShaderProgram::setDimensions(glm::ivec2 dimensions) {
+    useMe();
+
+    if(unifDimensions != -1)
+    {
+        context->uniform2i(unifDimensions, dimensions.x, dimensions.y);
+    }
+}
+
+void ShaderProgram::setTextureSlot(int slot) {
+    useMe();
+
+    if(unifSampler2D != -1)
+    {
+        context->uniform1i(unifSampler2D, slot);
+    }
+}
+
+void ShaderProgram::setFogDistance(float d) {
+    useMe();
+
+    if(unifFogDistance != -1)
+    {
+        context->uniform1f(unifFogDistance, d);
+    }
+}
+
+void ShaderProgram::setChunkMask(int slot, glm::ivec2 origin) {
+    useMe();
+
+    if(unifChunkMask != -1)
+    {
+        context->uniform1i(unifChunkMask, slot);
+    }
+
+    if(unifMaskOrigin != -1)
+    {
+        context->uniform2i(unifMaskOrigin, origin.x, origin.y);
+    }
+}
+
+void ShaderProgram::setGrassTint(int slot) {
+    useMe();
+
+    if(unifGrassTint != -1)
+    {
+        context->uniform1i(unifGrassTint, slot);
+    }
+}
+
+void ShaderProgram::setTintOrigin(glm::ivec2 origin) {
+    useMe();
+
+    if(unifTintOrigin != -1)
+    {
+        context->uniform2i(unifTintOrigin, origin.x, origin.y);
     }
 }
 
@@ -179,7 +279,7 @@ void ShaderProgram::setPlayerPosition(glm::vec4 pos) {
 
     if(unifPlayer != -1)
     {
-        context->glUniform4fv(unifPlayer, 1, &pos[0]);
+        context->uniform4fv(unifPlayer, 1, &pos[0]);
     }
 }
 
@@ -225,7 +325,7 @@ void ShaderProgram::drawOpq(Drawable &d) {
     useMe();
 
     if(unifSampler2D != -1) {
-        context->glUniform1i(unifSampler2D, 0);
+        context->uniform1i(unifSampler2D, 0);
     }
 
     if(d.elemCountOpq() < 0) {
@@ -263,7 +363,7 @@ void ShaderProgram::drawTrans(Drawable &d) {
     useMe();
 
     if(unifSampler2D != -1) {
-        context->glUniform1i(unifSampler2D, 0);
+        context->uniform1i(unifSampler2D, 0);
     }
 
     if(d.elemCountTrans() < 0) {
@@ -297,6 +397,64 @@ void ShaderProgram::drawTrans(Drawable &d) {
     context->printGLErrorLog();
 }
 
+int ShaderProgram::drawArena(ChunkArena &arena, const std::vector<const ChunkArena::Allocation*> &meshes,
+                             bool multiDraw, bool inOrder) {
+    useMe();
+
+    if(unifSampler2D != -1) {
+        context->uniform1i(unifSampler2D, 0);
+    }
+
+    // Out of order, the meshes are grouped by page, so that each page
+    // is bound and drawn once
+    std::vector<const ChunkArena::Allocation*> grouped;
+    if (!inOrder) {
+        grouped = meshes;
+        std::stable_sort(grouped.begin(), grouped.end(),
+                         [](const ChunkArena::Allocation *a, const ChunkArena::Allocation *b) {
+                             return a->page < b->page;
+                         });
+    }
+    const std::vector<const ChunkArena::Allocation*> &list = inOrder ? meshes : grouped;
+
+    GLuint previous = context->boundVertexArray();
+    int drawCalls = 0;
+    std::vector<GLsizei> counts;
+    std::vector<const void*> offsets;
+    std::vector<GLint> baseVertices;
+    // One run of meshes in a row from the same page at a time, since a
+    // single call can't draw from two pages
+    for (size_t first = 0, end; first < list.size(); first = end) {
+        int page = list[first]->page;
+        arena.bindPage(page);
+
+        counts.clear();
+        offsets.clear();
+        baseVertices.clear();
+        for (end = first; end < list.size() && list[end]->page == page; end++) {
+            const ChunkArena::Allocation *mesh = list[end];
+            counts.push_back(mesh->indexCount);
+            offsets.push_back(reinterpret_cast<const void*>(static_cast<size_t>(mesh->firstIndex) * sizeof(GLuint)));
+            baseVertices.push_back(mesh->firstVertex);
+        }
+        if (multiDraw) {
+            context->glMultiDrawElementsBaseVertex(GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT, offsets.data(),
+                                                   static_cast<GLsizei>(counts.size()), baseVertices.data());
+            drawCalls++;
+        } else {
+            for (size_t i = 0; i < counts.size(); i++) {
+                context->glDrawElementsBaseVertex(GL_TRIANGLES, counts[i], GL_UNSIGNED_INT, offsets[i], baseVertices[i]);
+            }
+            drawCalls += static_cast<int>(counts.size());
+        }
+    }
+    // Back to the VAO everything else sets its attributes up in
+    context->bindVertexArray(previous);
+
+    context->printGLErrorLog();
+    return drawCalls;
+}
+
 char* ShaderProgram::textFileRead(const char* fileName) {
     char* text;
 
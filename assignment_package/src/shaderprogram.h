@@ -7,6 +7,7 @@
 
 #include "drawable.h"
 #include "scene/chunk.h"
+#include "scene/chunkarena.h"
 
 
 class ShaderProgram
@@ -36,14 +37,23 @@ public:
     int unifPlayer;
     int unifCamera; // A handle for the "uniform" vec2 representing camera position in the vertex shader
 
+    int unifFogDistance; // A handle for the "uniform" float representing the distance at which fog is opaque
+    int unifChunkMask; // A handle for the "uniform" sampler2D marking the Chunks that are drawn this frame
+    int unifMaskOrigin; // A handle for the "uniform" ivec2 representing the world position of the mask's first texel
+    int unifGrassTint; // A handle for the "uniform" sampler2D holding the baked tint of grass tops
+    int unifTintOrigin; // A handle for the "uniform" ivec2 representing the world position of the grass tint's window
+
 public:
     ShaderProgram(OpenGLContext* context);
     // Sets up the requisite GL data and shaders from the given .glsl files
     void create(const char *vertfile, const char *fragfile);
     // Tells our OpenGL context to use this shader to draw things
     void useMe();
-    // Pass the given model matrix to this shader on the GPU
+    // Pass the given model matrix to this shader on the GPU, along with its
+    // inverse transpose. Does nothing if it is the one passed last time.
     void setModelMatrix(const glm::mat4 &model);
+    // Set the model matrix to a translation by t. Never needs an inverse.
+    void setModelTranslation(glm::vec3 t);
     // Pass the given Projection * View matrix to this shader on the GPU
     void setViewProjMatrix(const glm::mat4 &vp);
     // Pass the given color to this shader on the GPU
@@ -52,12 +62,34 @@ public:
     void setPlayerPosition(glm::vec4 pos);
     // Pass the given time to this shader on the GPU
     void setTime(int t);
+    // Pass the size in pixels of what is being drawn to to this shader on the GPU
+    void setDimensions(glm::ivec2 dimensions);
+    // Pass the texture slot that u_Texture reads from to this shader on the GPU
+    void setTextureSlot(int slot);
+    // Pass the distance from the player at which fog hides everything to this shader on the GPU
+    void setFogDistance(float d);
+    // Pass the texture slot of the chunk mask and the world position of its first texel to this shader on the GPU
+    void setChunkMask(int slot, glm::ivec2 origin);
+    // Pass the texture slot of the baked grass tint to this shader on the GPU
+    void setGrassTint(int slot);
+    // Pass the world x and z of the lowest corner of the grass tint's window to this shader on the GPU
+    void setTintOrigin(glm::ivec2 origin);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void draw(Drawable &d);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void drawOpq(Drawable &d);
     // Draw the given object to our screen using this ShaderProgram's shaders
     void drawTrans(Drawable &d);
+    // Draw the given meshes out of the arena, through each page's VAO. With
+    // multiDraw, each run of meshes in a row from the same page takes one
+    // glMultiDrawElementsBaseVertex, otherwise each mesh takes its own
+    // glDrawElementsBaseVertex. With inOrder, the meshes are drawn exactly
+    // in the order given, which blending needs. Otherwise they are first
+    // grouped by page, for as few calls as there are pages, and only keep
+    // their order among the meshes of each page. Returns the number of draw
+    // calls.
+    int drawArena(ChunkArena &arena, const std::vector<const ChunkArena::Allocation*> &meshes, bool multiDraw,
+                  bool inOrder);
     // Utility function used in create()
     char* textFileRead(const char*);
     // Utility function that prints any shader compilation errors to the console
@@ -76,6 +108,12 @@ private:
     OpenGLContext* context;   // Since Qt's OpenGL support is done through classes like QOpenGLFunctions_3_2_Core,
                             // we need to pass our OpenGL context to the Drawable in order to call GL functions
                             // from within this class.
+
+    // The last model matrix sent to the shader, if any, and whether its
+    // inverse transpose was sent as the identity
+    glm::mat4 m_model;
+    bool m_modelUploaded;
+    bool m_normalIdentity;
 };
 
 
@@ -21,14 +21,29 @@ SOURCES += \
     $$PWD/texture.cpp \
     $$PWD/scene/turtle.cpp \
     $$PWD/scene/river.cpp \
+    $$PWD/scene/rivernetwork.cpp \
+    $$PWD/scene/farterrain.cpp \
+    $$PWD/scene/worldgen.cpp \
+    $$PWD/scene/chunkstore.cpp \
+    $$PWD/scene/epochmanager.cpp \
+    $$PWD/scene/chunkmap.cpp \
+    $$PWD/scene/chunkpipeline.cpp \
+    $$PWD/scene/frustum.cpp \
+    $$PWD/scene/chunkarena.cpp \
+    $$PWD/frameprofiler.cpp \
+    $$PWD/renderdistance.cpp \
     $$PWD/framebuffer.cpp \
     $$PWD/scene/quad.cpp \
+    $$PWD/scene/sky.cpp \
+    $$PWD/scene/grasstint.cpp \
+    $$PWD/scene/fragmentcounter.cpp \
     $$PWD/inventory.cpp
 
 HEADERS += \
     $$PWD/mainwindow.h \
     $$PWD/mygl.h \
     $$PWD/scene/procgen.h \
+    $$PWD/scene/float4.h \
     $$PWD/shaderprogram.h \
     $$PWD/drawable.h \
     $$PWD/cameracontrolshelp.h \
@@ -46,6 +61,22 @@ HEADERS += \
     $$PWD/texture.h \
     $$PWD/scene/turtle.h \
     $$PWD/scene/river.h \
+    $$PWD/scene/rivernetwork.h \
+    $$PWD/scene/farterrain.h \
+    $$PWD/scene/worldgen.h \
+    $$PWD/scene/chunkstore.h \
+    $$PWD/scene/blocktype.h \
+    $$PWD/scene/epochmanager.h \
+    $$PWD/scene/chunkmap.h \
+    $$PWD/scene/chunkstate.h \
+    $$PWD/scene/chunkpipeline.h \
+    $$PWD/scene/frustum.h \
+    $$PWD/scene/chunkarena.h \
+    $$PWD/frameprofiler.h \
+    $$PWD/renderdistance.h \
     $$PWD/framebuffer.h \
     $$PWD/scene/quad.h \
+    $$PWD/scene/sky.h \
+    $$PWD/scene/grasstint.h \
+    $$PWD/scene/fragmentcounter.h \
     $$PWD/inventory.h
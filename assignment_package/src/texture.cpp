@@ -26,8 +26,8 @@ void Texture::load(int texSlot = 0)
 {
     context->printGLErrorLog();
 
-    context->glActiveTexture(GL_TEXTURE0 + texSlot);
-    context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+    context->activeTexture(GL_TEXTURE0 + texSlot);
+    context->bindTexture(GL_TEXTURE_2D, m_textureHandle);
 
     // These parameters need to be set for EVERY texture you create
     // They don't always have to be set to the values given here, but they do need
@@ -46,6 +46,6 @@ void Texture::load(int texSlot = 0)
 
 void Texture::bind(int texSlot = 0)
 {
-    context->glActiveTexture(GL_TEXTURE0 + texSlot);
-    context->glBindTexture(GL_TEXTURE_2D, m_textureHandle);
+    context->activeTexture(GL_TEXTURE0 + texSlot);
+    context->bindTexture(GL_TEXTURE_2D, m_textureHandle);
 }
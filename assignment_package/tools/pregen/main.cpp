@@ -0,0 +1,269 @@
+// Generates a rectangle of the world ahead of time into a ChunkStore, which
+// the game then loads instead of generating those Chunks itself.
+//
+//     pregen --out DIR --from X Z --to X Z [--procs N] [--seed S]
+//            [--mode heightmap|density]
+//
+// The rectangle is given in blocks and rounded out to whole Chunks. Its
+// regions are dealt out to N worker processes, so each region file is only
+// ever written by one of them. Chunks already in the store are skipped, so
+// running the same command again picks up where an interrupted run left off.
+//
+// POSIX only, since the workers are forked.
+
+#include "scene/chunkstore.h"
+#include "scene/worldgen.h"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+// The same world MyGL generates unless told otherwise
+static const unsigned int DEFAULT_SEED = 1337;
+static const GenerationMode DEFAULT_MODE = DENSITY_TERRAIN;
+
+struct Options {
+    std::string out;
+    glm::ivec2 from, to;
+    int procs;
+    unsigned int seed;
+    GenerationMode mode;
+};
+
+// One per worker, in memory shared with the parent
+struct Progress {
+    std::atomic<long long> generated, skipped, failed;
+};
+
+static void usage() {
+    std::fprintf(stderr, "usage: pregen --out DIR --from X Z --to X Z [--procs N] [--seed S]"
+                         " [--mode heightmap|density]\n");
+}
+
+static bool parseOptions(int argc, char *argv[], Options &options) {
+    options.procs = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    options.seed = DEFAULT_SEED;
+    options.mode = DEFAULT_MODE;
+    bool hasFrom = false, hasTo = false;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        int left = argc - i - 1;
+        if (arg == "--out" && left >= 1) {
+            options.out = argv[++i];
+        } else if (arg == "--from" && left >= 2) {
+            options.from = glm::ivec2(std::atoi(argv[i + 1]), std::atoi(argv[i + 2]));
+            hasFrom = true;
+            i += 2;
+        } else if (arg == "--to" && left >= 2) {
+            options.to = glm::ivec2(std::atoi(argv[i + 1]), std::atoi(argv[i + 2]));
+            hasTo = true;
+            i += 2;
+        } else if (arg == "--procs" && left >= 1) {
+            options.procs = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seed" && left >= 1) {
+            options.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else if (arg == "--mode" && left >= 1) {
+            std::string mode = argv[++i];
+            if (mode == "heightmap") {
+                options.mode = HEIGHTMAP_TERRAIN;
+            } else if (mode == "density") {
+                options.mode = DENSITY_TERRAIN;
+            } else {
+                return false;
+            }
+        } else {
+            return false;
+        }
+    }
+    return !options.out.empty() && hasFrom && hasTo;
+}
+
+static int floorToChunk(int v) {
+    return static_cast<int>(glm::floor(v / 16.f)) * 16;
+}
+
+// Every Chunk corner in the rectangle that also lies in region
+static std::vector<glm::ivec2> chunksIn(glm::ivec2 region, glm::ivec2 min, glm::ivec2 max) {
+    int size = 16 * ChunkStore::REGION_CHUNKS;
+    glm::ivec2 lo = glm::max(min, region * size);
+    glm::ivec2 hi = glm::min(max, region * size + glm::ivec2(size - 16));
+
+    std::vector<glm::ivec2> chunks;
+    for (int z = lo.y; z <= hi.y; z += 16) {
+        for (int x = lo.x; x <= hi.x; x += 16) {
+            chunks.push_back(glm::ivec2(x, z));
+        }
+    }
+    return chunks;
+}
+
+static void runWorker(const Options &options, const std::vector<glm::ivec2> &regions,
+                      glm::ivec2 min, glm::ivec2 max, Progress &progress) {
+    WorldGen worldGen(options.seed, options.mode);
+    ChunkStore store(options.out);
+    if (!store.open(options.seed, options.mode, ChunkStore::READ_WRITE)) {
+        std::_Exit(1);
+    }
+
+    std::vector<int> heights(256);
+    std::vector<BlockType> blocks(WorldGen::BLOCKS);
+    for (glm::ivec2 region : regions) {
+        // Only keep the rivers this region reaches
+        int size = 16 * ChunkStore::REGION_CHUNKS;
+        worldGen.evictRiversOutside(region * size, region * size + glm::ivec2(size - 1));
+        for (glm::ivec2 chunkPos : chunksIn(region, min, max)) {
+            if (store.has(chunkPos)) {
+                progress.skipped++;
+                continue;
+            }
+            std::fill(blocks.begin(), blocks.end(), EMPTY);
+            worldGen.generateChunk(chunkPos, heights.data(), blocks.data());
+            if (store.save(chunkPos, heights.data(), blocks.data())) {
+                progress.generated++;
+            } else {
+                progress.failed++;
+            }
+        }
+        // This worker never comes back to a region
+        store.closeRegions();
+    }
+    std::_Exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        usage();
+        return 2;
+    }
+
+    glm::ivec2 min(floorToChunk(glm::min(options.from.x, options.to.x)),
+                   floorToChunk(glm::min(options.from.y, options.to.y)));
+    glm::ivec2 max(floorToChunk(glm::max(options.from.x, options.to.x)),
+                   floorToChunk(glm::max(options.from.y, options.to.y)));
+
+    ChunkStore store(options.out);
+    if (!store.open(options.seed, options.mode, ChunkStore::CREATE)) {
+        std::fprintf(stderr, "pregen: %s holds another world, or one baked by another version of the"
+                             " generator, or can't be written. Delete it to bake it again.\n",
+                     options.out.c_str());
+        return 1;
+    }
+
+    glm::ivec2 minRegion = ChunkStore::regionOf(min), maxRegion = ChunkStore::regionOf(max);
+    std::vector<glm::ivec2> regions;
+    for (int z = minRegion.y; z <= maxRegion.y; z++) {
+        for (int x = minRegion.x; x <= maxRegion.x; x++) {
+            regions.push_back(glm::ivec2(x, z));
+        }
+    }
+    long long total = static_cast<long long>((max.x - min.x) / 16 + 1) * ((max.y - min.y) / 16 + 1);
+    int procs = std::min(options.procs, static_cast<int>(regions.size()));
+
+    std::printf("pregen: %lld chunks in %zu regions from (%d, %d) to (%d, %d), %d processes\n",
+                total, regions.size(), min.x, min.y, max.x + 15, max.y + 15, procs);
+    std::fflush(stdout);
+
+    void *shared = mmap(nullptr, sizeof(Progress) * procs, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (shared == MAP_FAILED) {
+        std::perror("pregen: mmap");
+        return 1;
+    }
+    Progress *progress = static_cast<Progress*>(shared);
+    for (int i = 0; i < procs; i++) {
+        new (&progress[i]) Progress{{0}, {0}, {0}};
+    }
+
+    // Deal the regions out round-robin, so that every worker
+    // gets a share of each part of the rectangle
+    std::vector<pid_t> workers;
+    for (int w = 0; w < procs; w++) {
+        std::vector<glm::ivec2> mine;
+        for (size_t i = w; i < regions.size(); i += procs) {
+            mine.push_back(regions[i]);
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            runWorker(options, mine, min, max, progress[w]);
+        } else if (pid < 0) {
+            std::perror("pregen: fork");
+            break;
+        }
+        workers.push_back(pid);
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now(), lastReport = start;
+    long long lastGenerated = 0;
+    int running = static_cast<int>(workers.size());
+    bool workerFailed = workers.size() < static_cast<size_t>(procs);
+
+    auto sum = [&](std::atomic<long long> Progress::*counter) {
+        long long s = 0;
+        for (int i = 0; i < procs; i++) {
+            s += (progress[i].*counter).load();
+        }
+        return s;
+    };
+    auto report = [&](Clock::time_point now) {
+        long long generated = sum(&Progress::generated), skipped = sum(&Progress::skipped);
+        long long done = generated + skipped;
+        float since = std::chrono::duration<float>(now - lastReport).count();
+        float rate = since > 0 ? (generated - lastGenerated) / since : 0;
+        float eta = rate > 0 ? (total - done) / rate : 0;
+        std::printf("  %lld / %lld chunks (%.1f%%), %lld already stored, %.0f chunks/s, %lld failed, eta %.0f s\n",
+                    done, total, 100.f * done / total, skipped, rate, sum(&Progress::failed), eta);
+        std::fflush(stdout);
+        lastReport = now;
+        lastGenerated = generated;
+    };
+
+    while (running > 0) {
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            running--;
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                workerFailed = true;
+            }
+        }
+        Clock::time_point now = Clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            report(now);
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    report(Clock::now());
+
+    long long generated = sum(&Progress::generated), failed = sum(&Progress::failed);
+    float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+    std::uintmax_t bytes = 0;
+    std::error_code error;
+    for (const auto &entry : std::filesystem::directory_iterator(options.out, error)) {
+        if (entry.path().extension() == ".bin") {
+            bytes += entry.file_size(error);
+        }
+    }
+    std::printf("pregen: generated %lld chunks in %.1f s (%.0f chunks/s), store is %.1f MB\n",
+                generated, seconds, seconds > 0 ? generated / seconds : 0, bytes / (1024.f * 1024.f));
+
+    munmap(shared, sizeof(Progress) * procs);
+    if (workerFailed || failed > 0) {
+        std::fprintf(stderr, "pregen: some chunks were not stored; run again to retry them\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,34 @@
+# Headless world pre-generation. Builds the game's world generation
+# sources on their own, without Qt or OpenGL.
+TEMPLATE = app
+TARGET = pregen
+CONFIG -= qt app_bundle
+CONFIG += console
+CONFIG += c++1z
+CONFIG += warn_on
+
+INCLUDEPATH += ../../include ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/scene/procgen.cpp \
+    ../../src/scene/worldgen.cpp \
+    ../../src/scene/chunkstore.cpp \
+    ../../src/scene/rivernetwork.cpp \
+    ../../src/scene/river.cpp \
+    ../../src/scene/turtle.cpp
+
+HEADERS += \
+    ../../src/scene/procgen.h \
+    ../../src/scene/worldgen.h \
+    ../../src/scene/chunkstore.h \
+    ../../src/scene/blocktype.h \
+    ../../src/scene/rivernetwork.h \
+    ../../src/scene/river.h \
+    ../../src/scene/turtle.h
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
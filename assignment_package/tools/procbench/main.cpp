@@ -0,0 +1,273 @@
+// Times world generation's batched and templated paths against the
+// straightforward ones they replaced, over a spread of Chunks both near
+// the origin and far from it, and checks that they give the same answers.
+// Also times whole Chunks in each generation mode.
+//
+//     procbench [--chunks N] [--seed S]
+
+#include "scene/procgen.h"
+#include "scene/worldgen.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// The same world MyGL generates unless told otherwise
+static const unsigned int DEFAULT_SEED = 1337;
+
+typedef std::chrono::steady_clock Clock;
+
+static double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+// Corners of the Chunks to generate: a block around the origin, and
+// the same far out, where float precision is at its worst
+static std::vector<glm::ivec2> chunkCorners(int count) {
+    std::vector<glm::ivec2> corners;
+    int side = 1;
+    while (side * side * 2 < count) {
+        side++;
+    }
+    for (glm::ivec2 origin : {glm::ivec2(0, 0), glm::ivec2(-4000000, 2500000)}) {
+        for (int i = 0; i < side * side && static_cast<int>(corners.size()) < count; i++) {
+            corners.push_back(origin + 16 * glm::ivec2(i % side - side / 2, i / side - side / 2));
+        }
+    }
+    return corners;
+}
+
+// getHeights() against getHeight(), columns per second.
+// Returns the number of columns where they differ.
+static long long benchHeights(const std::vector<glm::ivec2> &corners, unsigned int seed) {
+    long long columns = static_cast<long long>(corners.size()) * ProcGen::CHUNK_COLUMNS;
+    std::vector<int> scalar(columns), batched(columns);
+
+    Clock::time_point start = Clock::now();
+    for (size_t c = 0; c < corners.size(); c++) {
+        for (int i = 0; i < ProcGen::CHUNK_COLUMNS; i++) {
+            scalar[c * ProcGen::CHUNK_COLUMNS + i] =
+                    ProcGen::getHeight(corners[c].x + i % 16, corners[c].y + i / 16, seed);
+        }
+    }
+    double scalarSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (size_t c = 0; c < corners.size(); c++) {
+        ProcGen::getHeights(corners[c].x, corners[c].y, seed, &batched[c * ProcGen::CHUNK_COLUMNS]);
+    }
+    double batchedSeconds = secondsSince(start);
+
+    long long mismatches = 0;
+    for (long long i = 0; i < columns; i++) {
+        mismatches += scalar[i] != batched[i];
+    }
+    std::printf("heights, %lld columns\n", columns);
+    std::printf("  getHeight   %10.0f columns/s\n", columns / scalarSeconds);
+    std::printf("  getHeights  %10.0f columns/s (%.1fx), %lld mismatches\n",
+                columns / batchedSeconds, scalarSeconds / batchedSeconds, mismatches);
+    return mismatches;
+}
+
+// fbm2D() as it was before it became a template: the basis picked by
+// comparing strings, and two pow() calls, on every octave. The ridged,
+// billow and warped bases are written out the straightforward way, to
+// check the policies against.
+static float fbmByName(float x, float z, float persistence, std::string noiseFn, unsigned int seed) {
+    float total = 0;
+    int octaves = 8;
+
+    for (int i = 0; i < octaves; i++) {
+        float frequency = std::pow(2, i);
+        float amplitude = std::pow(persistence, i);
+        float px = x * frequency, pz = z * frequency;
+        ProcGen::Perlin<1> perlin{seed};
+
+        if (noiseFn == "perlin") {
+            total += perlin(px, pz) * amplitude;
+        }
+        if (noiseFn == "regular") {
+            total += ProcGen::Value{seed}(px, pz) * amplitude;
+        }
+        if (noiseFn == "ridged") {
+            total += (1.f - std::abs(perlin(px, pz))) * amplitude;
+        }
+        if (noiseFn == "billow") {
+            total += std::abs(perlin(px, pz)) * amplitude;
+        }
+        if (noiseFn == "warped") {
+            float warpX = perlin(px + 5.2f, pz + 1.3f);
+            float warpZ = perlin(px + 1.7f, pz + 9.2f);
+            total += perlin(px + 4.f * warpX, pz + 4.f * warpZ) * amplitude;
+        }
+    }
+
+    return total;
+}
+
+// The scale the grasslands sample fbm2D() at, for sample i
+static glm::vec2 fbmPoint(const std::vector<glm::ivec2> &corners, long long i) {
+    glm::ivec2 corner = corners[i / ProcGen::CHUNK_COLUMNS];
+    return glm::vec2(corner.x + i % 16, corner.y + i % ProcGen::CHUNK_COLUMNS / 16) / 64.f;
+}
+
+// fbm2D() with the given basis at every sample, into out.
+// Returns how long that took, in seconds.
+template <typename Noise>
+static double timeFbm2D(const std::vector<glm::ivec2> &corners, const Noise &noise, std::vector<float> &out) {
+    Clock::time_point start = Clock::now();
+    for (long long i = 0; i < static_cast<long long>(out.size()); i++) {
+        glm::vec2 p = fbmPoint(corners, i);
+        out[i] = ProcGen::fbm2D(p.x, p.y, 0.5f, noise);
+    }
+    return secondsSince(start);
+}
+
+// fbm2D() against fbmByName(), samples per second, for every basis.
+// Returns the number of samples where they differ.
+static long long benchFbm(const std::vector<glm::ivec2> &corners, unsigned int seed) {
+    long long samples = static_cast<long long>(corners.size()) * ProcGen::CHUNK_COLUMNS;
+    long long mismatches = 0;
+    std::printf("fbm2D, 8 octaves, %lld samples\n", samples);
+
+    ProcGen::Perlin<1> perlin{seed};
+    for (const char *name : {"perlin", "regular", "ridged", "billow", "warped"}) {
+        std::vector<float> byName(samples), templated(samples);
+
+        Clock::time_point start = Clock::now();
+        for (long long i = 0; i < samples; i++) {
+            glm::vec2 p = fbmPoint(corners, i);
+            byName[i] = fbmByName(p.x, p.y, 0.5f, name, seed);
+        }
+        double byNameSeconds = secondsSince(start);
+
+        double templatedSeconds;
+        if (std::strcmp(name, "perlin") == 0) {
+            templatedSeconds = timeFbm2D(corners, perlin, templated);
+        } else if (std::strcmp(name, "regular") == 0) {
+            templatedSeconds = timeFbm2D(corners, ProcGen::Value{seed}, templated);
+        } else if (std::strcmp(name, "ridged") == 0) {
+            templatedSeconds = timeFbm2D(corners, ProcGen::Ridged<ProcGen::Perlin<1>>{perlin}, templated);
+        } else if (std::strcmp(name, "billow") == 0) {
+            templatedSeconds = timeFbm2D(corners, ProcGen::Billow<ProcGen::Perlin<1>>{perlin}, templated);
+        } else {
+            templatedSeconds = timeFbm2D(corners, ProcGen::Warped<ProcGen::Perlin<1>>{perlin}, templated);
+        }
+
+        long long differ = 0;
+        for (long long i = 0; i < samples; i++) {
+            differ += byName[i] != templated[i];
+        }
+        mismatches += differ;
+        std::printf("  %-8s by name %10.0f samples/s, template %10.0f samples/s (%.2fx), %lld mismatches\n",
+                    name, samples / byNameSeconds, samples / templatedSeconds,
+                    byNameSeconds / templatedSeconds, differ);
+    }
+    return mismatches;
+}
+
+// getSolidity() against isSolid(), blocks per second.
+// Returns the number of blocks where they differ.
+static long long benchSolidity(const std::vector<glm::ivec2> &corners, unsigned int seed) {
+    long long blocks = static_cast<long long>(corners.size()) * ProcGen::CHUNK_COLUMNS * ProcGen::CHUNK_HEIGHT;
+    std::vector<int> heights(corners.size() * ProcGen::CHUNK_COLUMNS);
+    for (size_t c = 0; c < corners.size(); c++) {
+        ProcGen::getHeights(corners[c].x, corners[c].y, seed, &heights[c * ProcGen::CHUNK_COLUMNS]);
+    }
+    std::vector<unsigned char> scalar(blocks), batched(blocks);
+
+    Clock::time_point start = Clock::now();
+    for (size_t c = 0; c < corners.size(); c++) {
+        unsigned char *out = &scalar[c * ProcGen::CHUNK_COLUMNS * ProcGen::CHUNK_HEIGHT];
+        for (int y = 0; y < ProcGen::CHUNK_HEIGHT; y++) {
+            for (int i = 0; i < ProcGen::CHUNK_COLUMNS; i++) {
+                out[i + ProcGen::CHUNK_COLUMNS * y] =
+                        ProcGen::isSolid(corners[c].x + i % 16, y, corners[c].y + i / 16,
+                                         heights[c * ProcGen::CHUNK_COLUMNS + i], seed);
+            }
+        }
+    }
+    double scalarSeconds = secondsSince(start);
+
+    start = Clock::now();
+    for (size_t c = 0; c < corners.size(); c++) {
+        ProcGen::getSolidity(corners[c].x, corners[c].y, &heights[c * ProcGen::CHUNK_COLUMNS], seed,
+                             &batched[c * ProcGen::CHUNK_COLUMNS * ProcGen::CHUNK_HEIGHT]);
+    }
+    double batchedSeconds = secondsSince(start);
+
+    long long mismatches = 0;
+    for (long long i = 0; i < blocks; i++) {
+        mismatches += scalar[i] != batched[i];
+    }
+    std::printf("solidity, %lld blocks\n", blocks);
+    std::printf("  isSolid     %10.0f blocks/s\n", blocks / scalarSeconds);
+    std::printf("  getSolidity %10.0f blocks/s (%.1fx), %lld mismatches\n",
+                blocks / batchedSeconds, scalarSeconds / batchedSeconds, mismatches);
+    return mismatches;
+}
+
+// Whole Chunks through WorldGen, chunks per second, in each mode
+static void benchChunks(const std::vector<glm::ivec2> &corners, unsigned int seed) {
+    std::printf("whole chunks, %zu chunks\n", corners.size());
+    std::vector<int> heights(ProcGen::CHUNK_COLUMNS);
+    std::vector<BlockType> blocks(WorldGen::BLOCKS);
+    double heightMapSeconds = 0;
+
+    for (GenerationMode mode : {HEIGHTMAP_TERRAIN, DENSITY_TERRAIN}) {
+        // A fresh WorldGen, so that neither mode finds the
+        // rivers already grown by the other
+        WorldGen gen(seed, mode);
+        Clock::time_point start = Clock::now();
+        for (glm::ivec2 corner : corners) {
+            std::fill(blocks.begin(), blocks.end(), EMPTY);
+            gen.generateChunk(corner, heights.data(), blocks.data());
+        }
+        double seconds = secondsSince(start);
+
+        if (mode == HEIGHTMAP_TERRAIN) {
+            heightMapSeconds = seconds;
+            std::printf("  height map  %10.0f chunks/s\n", corners.size() / seconds);
+        } else {
+            std::printf("  density     %10.0f chunks/s (%.2fx the time)\n",
+                        corners.size() / seconds, seconds / heightMapSeconds);
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int chunks = 2000;
+    unsigned int seed = DEFAULT_SEED;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--chunks") == 0 && i + 1 < argc) {
+            chunks = std::max(1, std::atoi(argv[++i]));
+        } else if (std::strcmp(argv[i], "--seed") == 0 && i + 1 < argc) {
+            seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        } else {
+            std::fprintf(stderr, "usage: procbench [--chunks N] [--seed S]\n");
+            return 2;
+        }
+    }
+
+    std::vector<glm::ivec2> corners = chunkCorners(chunks);
+    long long mismatches = benchHeights(corners, seed);
+    mismatches += benchFbm(corners, seed);
+    // isSolid() samples the cave noise for every block near the surface,
+    // so only check a slice of the Chunks against it
+    std::vector<glm::ivec2> sliced;
+    for (size_t c = 0; c < corners.size(); c += 10) {
+        sliced.push_back(corners[c]);
+    }
+    mismatches += benchSolidity(sliced, seed);
+    benchChunks(corners, seed);
+    if (mismatches > 0) {
+        std::printf("FAIL: a fast path disagrees with the code it replaced\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+# Benchmarks of world generation, and checks that its fast paths give
+# exactly what the straightforward ones do. Also times whole Chunks in
+# each generation mode. Builds the generation sources on their own,
+# without Qt or OpenGL, like pregen.
+#
+#     procbench [--chunks N] [--seed S]
+#
+# Exits with a failure if any fast path disagrees.
+TEMPLATE = app
+TARGET = procbench
+CONFIG -= qt app_bundle
+CONFIG += console
+CONFIG += c++1z
+CONFIG += warn_on
+CONFIG += release
+
+INCLUDEPATH += ../../include ../../src
+
+SOURCES += \
+    main.cpp \
+    ../../src/scene/procgen.cpp \
+    ../../src/scene/worldgen.cpp \
+    ../../src/scene/rivernetwork.cpp \
+    ../../src/scene/river.cpp \
+    ../../src/scene/turtle.cpp
+
+HEADERS += \
+    ../../src/scene/procgen.h \
+    ../../src/scene/float4.h \
+    ../../src/scene/worldgen.h \
+    ../../src/scene/blocktype.h \
+    ../../src/scene/rivernetwork.h \
+    ../../src/scene/river.h \
+    ../../src/scene/turtle.h
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
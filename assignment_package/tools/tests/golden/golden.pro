@@ -0,0 +1,39 @@
+# Golden-value test of world generation. Fails if a seed no longer gives
+# the world it gave when the values were recorded, so that changes to the
+# generated world are made on purpose and recorded with the change.
+# Builds the generation sources on their own, without Qt or OpenGL.
+#
+#     golden [--print]
+#
+# --print lists what the current code gives, in the form the tables in
+# main.cpp take, for when a change to the world is intended.
+TEMPLATE = app
+TARGET = golden
+CONFIG -= qt app_bundle
+CONFIG += console
+CONFIG += c++1z
+CONFIG += warn_on
+
+INCLUDEPATH += ../../../include ../../../src
+
+SOURCES += \
+    main.cpp \
+    ../../../src/scene/procgen.cpp \
+    ../../../src/scene/worldgen.cpp \
+    ../../../src/scene/rivernetwork.cpp \
+    ../../../src/scene/river.cpp \
+    ../../../src/scene/turtle.cpp
+
+HEADERS += \
+    ../../../src/scene/procgen.h \
+    ../../../src/scene/worldgen.h \
+    ../../../src/scene/blocktype.h \
+    ../../../src/scene/rivernetwork.h \
+    ../../../src/scene/river.h \
+    ../../../src/scene/turtle.h
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+}
@@ -0,0 +1,185 @@
+// Checks that world generation still gives the values recorded below:
+// column heights from ProcGen, fbm2D() over the bases the heights don't
+// use, and a hash of every block of a few whole Chunks from WorldGen in
+// each mode. The world has to be the same with any
+// compiler, at any optimization level and on any platform, since
+// ChunkStore keeps Chunks generated by the pregen tool.
+//
+// Any change that moves the world has to update these tables in the same
+// commit, and say so, and bump WorldGen::GENERATOR_VERSION.
+
+#include "scene/procgen.h"
+#include "scene/worldgen.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+struct HeightCase {
+    int x, z;
+    unsigned int seed;
+    int height;
+};
+
+static const HeightCase HEIGHTS[] = {
+    {0, 0, 1337, 128},
+    {48, 48, 1337, 134},
+    {-1000, 2500, 1337, 142},
+    {123456, -654321, 1337, 154},
+    {4000000, 4000000, 1337, 131},
+    {-20000000, 17, 1337, 128},
+    {0, 0, 1, 135},
+    {-1000, 2500, 2, 251},
+};
+
+// The fbm2D() bases that nothing in the world uses yet, which would
+// otherwise be free to drift
+enum Basis {
+    RIDGED, BILLOW, WARPED, PERLIN_4_OCTAVES
+};
+
+// fbm2D() at (x, z) in units of 1/4096, which any compiler rounds the same
+struct FbmCase {
+    Basis basis;
+    float x, z;
+    unsigned int seed;
+    long value;
+};
+
+static const FbmCase FBMS[] = {
+    {RIDGED, 0.750f, 0.250f, 1337, 6563},
+    {RIDGED, -15.625f, 39.063f, 1337, 5331},
+    {RIDGED, 1929.375f, -10224.812f, 7, 7000},
+    {BILLOW, 0.750f, 0.250f, 1337, 1597},
+    {BILLOW, -15.625f, 39.063f, 1337, 2829},
+    {BILLOW, 1929.375f, -10224.812f, 7, 1160},
+    {WARPED, 0.750f, 0.250f, 1337, 480},
+    {WARPED, -15.625f, 39.063f, 1337, -3117},
+    {WARPED, 1929.375f, -10224.812f, 7, 340},
+    {PERLIN_4_OCTAVES, 0.750f, 0.250f, 1337, 922},
+    {PERLIN_4_OCTAVES, -15.625f, 39.063f, 1337, 908},
+    {PERLIN_4_OCTAVES, 1929.375f, -10224.812f, 7, 1955},
+};
+
+struct ChunkCase {
+    int x, z;
+    unsigned int seed;
+    GenerationMode mode;
+    uint64_t hash;
+};
+
+static const ChunkCase CHUNKS[] = {
+    {0, 0, 1337, HEIGHTMAP_TERRAIN, 0xdd7b44d7cc72e167ull},
+    {-1008, 2496, 1337, HEIGHTMAP_TERRAIN, 0xd61a5f67a43d0491ull},
+    {123456, -654320, 1337, HEIGHTMAP_TERRAIN, 0x1805c190a6431debull},
+    {0, 0, 1337, DENSITY_TERRAIN, 0x70cd15674ed4acc3ull},
+    {-1008, 2496, 1337, DENSITY_TERRAIN, 0xe4cc0e41fa2b04efull},
+    {123456, -654320, 1337, DENSITY_TERRAIN, 0xa4aec12014172990ull},
+};
+
+static long sampleFbm(const FbmCase &c) {
+    ProcGen::Perlin<1> perlin{c.seed};
+    float value = 0;
+    switch (c.basis) {
+    case RIDGED:
+        value = ProcGen::fbm2D(c.x, c.z, 0.5f, ProcGen::Ridged<ProcGen::Perlin<1>>{perlin});
+        break;
+    case BILLOW:
+        value = ProcGen::fbm2D(c.x, c.z, 0.5f, ProcGen::Billow<ProcGen::Perlin<1>>{perlin});
+        break;
+    case WARPED:
+        value = ProcGen::fbm2D(c.x, c.z, 0.5f, ProcGen::Warped<ProcGen::Perlin<1>>{perlin});
+        break;
+    case PERLIN_4_OCTAVES:
+        value = ProcGen::fbm2D<ProcGen::Perlin<2>, 4>(c.x, c.z, 0.5f, ProcGen::Perlin<2>{c.seed});
+        break;
+    }
+    return std::lround(value * 4096.);
+}
+
+static const char* basisName(Basis basis) {
+    switch (basis) {
+    case RIDGED: return "RIDGED";
+    case BILLOW: return "BILLOW";
+    case WARPED: return "WARPED";
+    case PERLIN_4_OCTAVES: return "PERLIN_4_OCTAVES";
+    }
+    return "";
+}
+
+// FNV-1a over the height map and then the blocks
+static uint64_t chunkHash(const ChunkCase &c) {
+    WorldGen worldGen(c.seed, c.mode);
+    std::vector<int> heights(256);
+    std::vector<BlockType> blocks(WorldGen::BLOCKS, EMPTY);
+    worldGen.generateChunk(glm::ivec2(c.x, c.z), heights.data(), blocks.data());
+
+    uint64_t hash = 14695981039346656037ull;
+    auto add = [&hash](unsigned char byte) {
+        hash = (hash ^ byte) * 1099511628211ull;
+    };
+    for (int height : heights) {
+        for (int i = 0; i < 4; i++) {
+            add(static_cast<unsigned char>(static_cast<uint32_t>(height) >> (8 * i)));
+        }
+    }
+    for (BlockType block : blocks) {
+        add(block);
+    }
+    return hash;
+}
+
+static const char* modeName(GenerationMode mode) {
+    return mode == HEIGHTMAP_TERRAIN ? "HEIGHTMAP_TERRAIN" : "DENSITY_TERRAIN";
+}
+
+int main(int argc, char *argv[]) {
+    bool print = argc > 1 && std::strcmp(argv[1], "--print") == 0;
+    int failures = 0;
+
+    for (const HeightCase &c : HEIGHTS) {
+        int height = ProcGen::getHeight(c.x, c.z, c.seed);
+        if (print) {
+            std::printf("    {%d, %d, %u, %d},\n", c.x, c.z, c.seed, height);
+        } else if (height != c.height) {
+            std::printf("FAIL: getHeight(%d, %d, %u) is %d, recorded %d\n", c.x, c.z, c.seed, height, c.height);
+            failures++;
+        }
+    }
+    for (const FbmCase &c : FBMS) {
+        long value = sampleFbm(c);
+        if (print) {
+            std::printf("    {%s, %.3ff, %.3ff, %u, %ld},\n", basisName(c.basis), c.x, c.z, c.seed, value);
+        } else if (value != c.value) {
+            std::printf("FAIL: fbm2D %s at (%g, %g), seed %u is %ld / 4096, recorded %ld\n",
+                        basisName(c.basis), c.x, c.z, c.seed, value, c.value);
+            failures++;
+        }
+    }
+    for (const ChunkCase &c : CHUNKS) {
+        uint64_t hash = chunkHash(c);
+        if (print) {
+            std::printf("    {%d, %d, %u, %s, 0x%016llxull},\n", c.x, c.z, c.seed, modeName(c.mode),
+                        static_cast<unsigned long long>(hash));
+        } else if (hash != c.hash) {
+            std::printf("FAIL: Chunk (%d, %d), seed %u, %s hashes to 0x%016llx, recorded 0x%016llx\n",
+                        c.x, c.z, c.seed, modeName(c.mode), static_cast<unsigned long long>(hash),
+                        static_cast<unsigned long long>(c.hash));
+            failures++;
+        }
+    }
+
+    if (print) {
+        return 0;
+    }
+    if (failures > 0) {
+        std::printf("%d of %zu golden values changed\n", failures,
+                    sizeof(HEIGHTS) / sizeof(HEIGHTS[0]) + sizeof(FBMS) / sizeof(FBMS[0])
+                    + sizeof(CHUNKS) / sizeof(CHUNKS[0]));
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
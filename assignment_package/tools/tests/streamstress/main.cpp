@@ -0,0 +1,302 @@
+// Runs the threads of Chunk streaming against each other the way Terrain
+// does, with a stand-in Chunk that has no blocks or meshes to speak of:
+//
+//   streaming  moves the loaded window along, instantiating the Chunks that
+//              come into it and evicting those left outside (tryExpansion)
+//   main       queues meshes for Chunks whose neighbors have blocks,
+//              uploads finished ones and frees what was evicted
+//              (checkThreadResults), then looks up and reads every Chunk
+//              in the window (draw)
+//   workers    run queued mesh jobs, which read their neighbor snapshot
+//
+// Evicted Chunks are never really deleted, only marked, so that a job
+// that reads one can be counted instead of crashing.
+
+#include "scene/chunkmap.h"
+#include "scene/chunkstate.h"
+#include "scene/epochmanager.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Chunk {
+public:
+    Chunk(int x, int z) : m_x(x), m_z(z), m_state(NEW), m_freed(false), m_needsRemesh(false),
+        m_neighbors(), m_meshNeighbors()
+    {
+        m_blocks.fill(x ^ z);
+    }
+
+    ChunkState getState() const { return m_state.load(); }
+    void setState(ChunkState state) { m_state.store(state); }
+    Chunk* getNeighbor(Direction dir) const { return m_neighbors[dir]; }
+
+    int m_x, m_z;
+    std::array<int, 256> m_blocks;
+    std::atomic<ChunkState> m_state;
+    // Set in place of freeing
+    std::atomic<bool> m_freed;
+    bool m_needsRemesh;
+    // Indexed by Direction. Only touched under streamingMutex.
+    std::array<Chunk*, 6> m_neighbors;
+    // Taken when a mesh is queued, read by the worker that runs it
+    std::array<Chunk*, 6> m_meshNeighbors;
+};
+
+static int64_t toKey(int x, int z) {
+    return static_cast<int64_t>(x) << 32 | static_cast<uint32_t>(z);
+}
+
+static Direction opposite(Direction dir) {
+    return static_cast<Direction>(dir ^ 1);
+}
+
+// Chunks are on a grid of unit steps here, not 16 blocks
+static const int OFFSETS[6][2] = {{1, 0}, {-1, 0}, {0, 0}, {0, 0}, {0, 1}, {0, -1}};
+static const Direction SIDES[4] = {XPOS, XNEG, ZPOS, ZNEG};
+
+struct World {
+    EpochManager epochs;
+    std::mutex graveyardMutex;
+    std::vector<Chunk*> graveyard;
+    ChunkMap chunks;
+
+    std::mutex streamingMutex;
+    // Window of loaded Chunks, RADIUS around (centerX, 0). Moved by the
+    // streaming thread and read by the main thread.
+    std::atomic<int> centerX;
+
+    std::mutex queueMutex;
+    std::condition_variable queueReady;
+    std::deque<Chunk*> meshQueue;
+    std::vector<Chunk*> meshed;
+
+    std::atomic<bool> running;
+    std::atomic<long long> jobs, freedReads, evictions, draws;
+    bool unsafeEviction;
+
+    World()
+        : epochs(), graveyard(), chunks(epochs, [this](Chunk *chunk) {
+              chunk->m_freed.store(true);
+              std::lock_guard<std::mutex> lock(graveyardMutex);
+              graveyard.push_back(chunk);
+          }),
+          centerX(0), running(true), jobs(0), freedReads(0), evictions(0), draws(0), unsafeEviction(false)
+    {}
+
+    ~World() {
+        for (Chunk *chunk : graveyard) {
+            delete chunk;
+        }
+    }
+};
+
+static const int RADIUS = 6;
+
+static Chunk* find(World &world, int x, int z) {
+    return world.chunks.find(toKey(x, z));
+}
+
+// The rule Terrain used before canEvict() looked at neighbors
+static bool canEvictUnsafe(const Chunk &chunk) {
+    return chunk.getState() == UPLOADED && !chunk.m_needsRemesh;
+}
+
+// tryExpansion(): loads the window around the center and evicts the rest
+static void stream(World &world) {
+    while (world.running) {
+        int center = world.centerX.load();
+        {
+            std::lock_guard<std::mutex> lock(world.streamingMutex);
+            EpochManager::Guard guard(world.epochs);
+
+            std::vector<int64_t> evicted;
+            for (auto & [ key, chunk ] : world.chunks.snapshot()) {
+                if (std::abs(chunk->m_x - center) <= RADIUS + 1) {
+                    continue;
+                }
+                bool idle = world.unsafeEviction ? canEvictUnsafe(*chunk) : canEvict(*chunk);
+                if (!idle) {
+                    continue;
+                }
+                for (Direction dir : SIDES) {
+                    Chunk *neighbor = chunk->m_neighbors[dir];
+                    if (neighbor != nullptr) {
+                        neighbor->m_neighbors[opposite(dir)] = nullptr;
+                        chunk->m_neighbors[dir] = nullptr;
+                    }
+                }
+                evicted.push_back(key);
+            }
+            world.chunks.erase(evicted);
+            world.evictions += evicted.size();
+
+            std::vector<std::pair<int64_t, uPtr<Chunk>>> instantiated;
+            std::vector<Chunk*> created;
+            for (int x = center - RADIUS; x <= center + RADIUS; x++) {
+                for (int z = -RADIUS; z <= RADIUS; z++) {
+                    if (find(world, x, z) == nullptr) {
+                        uPtr<Chunk> chunk = mkU<Chunk>(x, z);
+                        // Generation isn't what is being tested
+                        chunk->setState(BLOCKS_READY);
+                        created.push_back(chunk.get());
+                        instantiated.push_back({toKey(x, z), std::move(chunk)});
+                    }
+                }
+            }
+            world.chunks.insert(instantiated);
+            for (Chunk *chunk : created) {
+                for (Direction dir : SIDES) {
+                    Chunk *neighbor = find(world, chunk->m_x + OFFSETS[dir][0], chunk->m_z + OFFSETS[dir][1]);
+                    if (neighbor != nullptr) {
+                        chunk->m_neighbors[dir] = neighbor;
+                        neighbor->m_neighbors[opposite(dir)] = chunk;
+                        // Its border faces changed
+                        neighbor->m_needsRemesh = true;
+                    }
+                }
+            }
+        }
+        // Flying: the window moves on faster than meshing keeps up
+        world.centerX++;
+        std::this_thread::sleep_for(std::chrono::microseconds(300));
+    }
+}
+
+// tryScheduleMesh(). Caller holds streamingMutex.
+static void scheduleMesh(World &world, Chunk *chunk) {
+    ChunkState state = chunk->getState();
+    if (state != BLOCKS_READY && !(state == UPLOADED && chunk->m_needsRemesh)) {
+        return;
+    }
+    chunk->m_meshNeighbors = chunk->m_neighbors;
+    chunk->m_needsRemesh = false;
+    chunk->setState(MESH_QUEUED);
+    std::lock_guard<std::mutex> lock(world.queueMutex);
+    world.meshQueue.push_back(chunk);
+    world.queueReady.notify_one();
+}
+
+// generateMesh(): reads the neighbor snapshot
+static void mesh(World &world) {
+    while (true) {
+        Chunk *chunk;
+        {
+            std::unique_lock<std::mutex> lock(world.queueMutex);
+            world.queueReady.wait(lock, [&] { return !world.meshQueue.empty() || !world.running; });
+            if (world.meshQueue.empty()) {
+                return;
+            }
+            chunk = world.meshQueue.front();
+            world.meshQueue.pop_front();
+        }
+        // Jobs wait in the queue long enough for the window to move on
+        std::this_thread::sleep_for(std::chrono::microseconds(50));
+        long long sum = 0;
+        for (Direction dir : SIDES) {
+            Chunk *neighbor = chunk->m_meshNeighbors[dir];
+            if (neighbor == nullptr) {
+                continue;
+            }
+            if (neighbor->m_freed.load()) {
+                world.freedReads++;
+                continue;
+            }
+            for (int block : neighbor->m_blocks) {
+                sum += block;
+            }
+        }
+        (void)sum;
+        chunk->setState(MESHED);
+        world.jobs++;
+        std::lock_guard<std::mutex> lock(world.queueMutex);
+        world.meshed.push_back(chunk);
+    }
+}
+
+// checkThreadResults() and draw()
+static void mainLoop(World &world, std::chrono::steady_clock::time_point end) {
+    while (std::chrono::steady_clock::now() < end) {
+        {
+            std::lock_guard<std::mutex> lock(world.streamingMutex);
+            EpochManager::Guard guard(world.epochs);
+            for (auto & [ key, chunk ] : world.chunks.snapshot()) {
+                scheduleMesh(world, chunk);
+            }
+            std::vector<Chunk*> meshed;
+            {
+                std::lock_guard<std::mutex> queueLock(world.queueMutex);
+                meshed.swap(world.meshed);
+            }
+            for (Chunk *chunk : meshed) {
+                chunk->setState(UPLOADED);
+                scheduleMesh(world, chunk);
+            }
+        }
+        world.epochs.collect();
+
+        EpochManager::Guard guard(world.epochs);
+        int center = world.centerX.load();
+        for (int x = center - RADIUS; x <= center + RADIUS; x++) {
+            for (int z = -RADIUS; z <= RADIUS; z++) {
+                Chunk *chunk = find(world, x, z);
+                if (chunk != nullptr && chunk->getState() == UPLOADED) {
+                    world.draws += chunk->m_blocks[0] == (x ^ z);
+                }
+            }
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = 3;
+    World world;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--seconds") == 0 && i + 1 < argc) {
+            seconds = std::atof(argv[++i]);
+        } else if (std::strcmp(argv[i], "--unsafe-eviction") == 0) {
+            world.unsafeEviction = true;
+        } else {
+            std::fprintf(stderr, "usage: streamstress [--seconds N] [--unsafe-eviction]\n");
+            return 2;
+        }
+    }
+
+    auto end = std::chrono::steady_clock::now()
+            + std::chrono::milliseconds(static_cast<long long>(seconds * 1000));
+    std::thread streaming(stream, std::ref(world));
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; i++) {
+        workers.emplace_back(mesh, std::ref(world));
+    }
+    mainLoop(world, end);
+
+    world.running = false;
+    streaming.join();
+    {
+        std::lock_guard<std::mutex> lock(world.queueMutex);
+        world.queueReady.notify_all();
+    }
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+    world.epochs.collect();
+
+    std::printf("%lld mesh jobs, %lld evictions, %lld draws, %lld reads of freed Chunks\n",
+                world.jobs.load(), world.evictions.load(), world.draws.load(), world.freedReads.load());
+    if (world.freedReads > 0) {
+        std::printf("FAIL: a queued mesh job read a Chunk that had been freed\n");
+        return 1;
+    }
+    std::printf("OK\n");
+    return 0;
+}
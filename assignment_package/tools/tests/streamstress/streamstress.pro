@@ -0,0 +1,36 @@
+# Stress test of Chunk streaming: loading, evicting, meshing and drawing on
+# separate threads over the lock-free ChunkMap and EpochManager. Builds
+# those sources on their own, without Qt or OpenGL, and with
+# ThreadSanitizer, which is most of the point.
+#
+#     streamstress [--seconds N] [--unsafe-eviction]
+#
+# Exits with a failure if a mesh job read a Chunk after it was freed.
+# --unsafe-eviction evicts the way Terrain did before canEvict() looked
+# at neighbors, to show the test catches it.
+TEMPLATE = app
+TARGET = streamstress
+CONFIG -= qt app_bundle
+CONFIG += console
+CONFIG += c++1z
+CONFIG += warn_on
+
+INCLUDEPATH += ../../../include ../../../src
+
+SOURCES += \
+    main.cpp \
+    ../../../src/scene/chunkmap.cpp \
+    ../../../src/scene/epochmanager.cpp
+
+HEADERS += \
+    ../../../src/scene/chunkmap.h \
+    ../../../src/scene/chunkstate.h \
+    ../../../src/scene/epochmanager.h
+
+*-clang*|*-g++* {
+    CONFIG -= warn_on
+    QMAKE_CXXFLAGS += -Wall -Wextra -pedantic -Winit-self
+    QMAKE_CXXFLAGS += -Wno-strict-aliasing
+    QMAKE_CXXFLAGS += -fsanitize=thread -g -O1
+    QMAKE_LFLAGS += -fsanitize=thread
+}